@@ -0,0 +1,493 @@
+#include "B3DBenchmark.h"
+
+//GLM
+#include <glm/gtc/constants.hpp>
+
+//STD
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	constexpr float OBJECT_SPACING = 1.5f;
+	constexpr float OBJECT_SCALE = 0.5f;
+	constexpr float BOB_HEIGHT = 0.25f;
+
+	//Metrics under these sections are timings where bigger is worse, everything else is informational
+	const char* const TIMED_SECTIONS[] = { "frameTime.", "cpuStages.", "gpu." };
+	const char* const TIMED_METRICS[] = { ".average", ".p50", ".p95", ".p99" };
+
+	//Reads the subset of JSON the report uses into dotted paths, e.g. {"frameTime":{"p50":1}} becomes frameTime.p50 = 1
+	class FlatJsonReader
+	{
+		public:
+
+			explicit FlatJsonReader(const std::string& text) : text{ text } {}
+
+			std::map<std::string, double> read()
+			{
+				std::map<std::string, double> values;
+				skipSpace();
+				readValue("", values);
+				return values;
+			}
+
+		private:
+
+			const std::string& text;
+			size_t position = 0;
+
+			void skipSpace()
+			{
+				while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) position++;
+			}
+
+			void expect(char c)
+			{
+				skipSpace();
+
+				if (position >= text.size() || text[position] != c)
+				{
+					throw std::runtime_error(std::string("Malformed benchmark report, expected '") + c + "'");
+				}
+
+				position++;
+			}
+
+			std::string readString()
+			{
+				expect('"');
+
+				std::string result;
+				while (position < text.size() && text[position] != '"')
+				{
+					if (text[position] == '\\' && position + 1 < text.size()) position++;
+					result += text[position++];
+				}
+
+				expect('"');
+				return result;
+			}
+
+			void readValue(const std::string& path, std::map<std::string, double>& values)
+			{
+				skipSpace();
+
+				if (position >= text.size()) throw std::runtime_error("Malformed benchmark report, unexpected end");
+
+				const char c = text[position];
+
+				if (c == '{')
+				{
+					position++;
+					skipSpace();
+
+					while (position < text.size() && text[position] != '}')
+					{
+						std::string key = readString();
+						expect(':');
+						readValue(path.empty() ? key : path + "." + key, values);
+
+						skipSpace();
+						if (position < text.size() && text[position] == ',') position++;
+						skipSpace();
+					}
+
+					expect('}');
+				}
+				else if (c == '[')
+				{
+					position++;
+					skipSpace();
+
+					for (size_t index = 0; position < text.size() && text[position] != ']'; index++)
+					{
+						readValue(path + "." + std::to_string(index), values);
+
+						skipSpace();
+						if (position < text.size() && text[position] == ',') position++;
+						skipSpace();
+					}
+
+					expect(']');
+				}
+				else if (c == '"')
+				{
+					readString();
+				}
+				else if (text.compare(position, 4, "true") == 0 || text.compare(position, 4, "null") == 0)
+				{
+					position += 4;
+				}
+				else if (text.compare(position, 5, "false") == 0)
+				{
+					position += 5;
+				}
+				else
+				{
+					char* end = nullptr;
+					double value = std::strtod(text.c_str() + position, &end);
+
+					if (end == text.c_str() + position) throw std::runtime_error("Malformed benchmark report, bad number");
+
+					position = static_cast<size_t>(end - text.c_str());
+					values[path] = value;
+				}
+			}
+	};
+
+	bool isTimedMetric(const std::string& path)
+	{
+		auto endsWith = [&](const char* suffix)
+		{
+			const size_t length = std::char_traits<char>::length(suffix);
+			return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+		};
+
+		return std::any_of(std::begin(TIMED_SECTIONS), std::end(TIMED_SECTIONS), [&](const char* section) { return path.rfind(section, 0) == 0; }) &&
+			std::any_of(std::begin(TIMED_METRICS), std::end(TIMED_METRICS), endsWith);
+	}
+
+	void writeEscaped(std::ostream& out, const std::string& text)
+	{
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\') out << '\\';
+			out << c;
+		}
+	}
+}
+
+B3DBenchmark::B3DBenchmark(const BenchmarkSettings& settings) : settings{ settings }
+{
+	if (settings.cubeWeight < 0.f || settings.sphereWeight < 0.f || settings.deskWeight < 0.f || settings.cubeWeight + settings.sphereWeight + settings.deskWeight <= 0.f)
+	{
+		throw std::runtime_error("Benchmark model mix needs at least one positive weight!");
+	}
+
+	this->settings.movingRatio = std::clamp(settings.movingRatio, 0.f, 1.f);
+
+	for (auto& samples : stageSamples)
+	{
+		samples.reserve(settings.frameCount);
+	}
+	frameTimes.reserve(settings.frameCount);
+	drawCallSamples.reserve(settings.frameCount);
+}
+
+void B3DBenchmark::generateScene(B3DDevice& device, B3DSceneGraph& sceneGraph, std::vector<B3DGameObj>& gameObjects)
+{
+	PLOGI << "Generating benchmark scene: " << settings.objectCount << " objects, " << settings.movingRatio * 100.f << "% moving, seed " << settings.seed;
+
+	struct ModelChoice
+	{
+		const char* path;
+		float weight;
+		std::shared_ptr<B3DModel> model;
+	};
+
+	std::vector<ModelChoice> choices;
+
+	for (const ModelChoice& choice : { ModelChoice{ "cube.wobj", settings.cubeWeight }, ModelChoice{ "sphere.wobj", settings.sphereWeight }, ModelChoice{ "desk.wobj", settings.deskWeight } })
+	{
+		if (choice.weight <= 0.f) continue;
+
+		choices.push_back(choice);
+		choices.back().model = B3DModel::createModelFromFile(device, choice.path);
+	}
+
+	std::vector<float> weights;
+	for (const auto& choice : choices)
+	{
+		weights.push_back(choice.weight);
+	}
+
+	std::mt19937 random{ settings.seed };
+	std::discrete_distribution<size_t> pickModel{ weights.begin(), weights.end() };
+	std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+	//Objects fill a cube centred on the origin, which the camera orbits
+	const uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(settings.objectCount)))));
+	const float halfExtent = (static_cast<float>(side) - 1.f) * OBJECT_SPACING * 0.5f;
+	sceneRadius = std::max(1.f, halfExtent * std::sqrt(3.f));
+
+	gameObjects.reserve(gameObjects.size() + settings.objectCount);
+	movingObjects.reserve(static_cast<size_t>(settings.objectCount * settings.movingRatio) + 1);
+
+	for (uint32_t i = 0; i < settings.objectCount; i++)
+	{
+		const uint32_t x = i % side;
+		const uint32_t y = (i / side) % side;
+		const uint32_t z = i / (side * side);
+
+		auto object = B3DGameObj::createGameObject();
+		object.model = choices[pickModel(random)].model;
+		object.sceneNode = sceneGraph.createNode();
+
+		auto& transform = sceneGraph.editLocalTransform(object.sceneNode);
+		transform.translation = glm::vec3{ x, y, z } * OBJECT_SPACING - glm::vec3{ halfExtent };
+		transform.rotation = { 0.f, unit(random) * glm::two_pi<float>(), 0.f };
+		transform.scale = glm::vec3{ OBJECT_SCALE };
+
+		if (unit(random) < settings.movingRatio)
+		{
+			movingObjects.push_back(MovingObject{ object.sceneNode, transform.translation, unit(random) * glm::two_pi<float>(), 0.5f + unit(random) * 2.f });
+		}
+		else
+		{
+			object.isStatic = true;
+		}
+
+		gameObjects.push_back(std::move(object));
+	}
+
+	PLOGI << "Benchmark scene generated, " << movingObjects.size() << " moving objects";
+}
+
+void B3DBenchmark::animate(B3DSceneGraph& sceneGraph, uint32_t frame, float timestep)
+{
+	const float time = static_cast<float>(frame) * timestep;
+
+	for (const auto& moving : movingObjects)
+	{
+		auto& transform = sceneGraph.editLocalTransform(moving.node);
+		transform.translation.y = moving.basePosition.y + std::sin(time * moving.spinSpeed + moving.phase) * BOB_HEIGHT;
+		transform.rotation.y = moving.phase + time * moving.spinSpeed;
+	}
+}
+
+void B3DBenchmark::updateCamera(B3DCamera& camera, float aspect, uint32_t frame) const
+{
+	//One full orbit over the measured frames, starting from where the warmup left off
+	const float progress = static_cast<float>(frame) / static_cast<float>(std::max(1u, settings.frameCount));
+	const float angle = progress * glm::two_pi<float>();
+	const float distance = sceneRadius * 1.5f + 2.f;
+
+	//-Y is up
+	glm::vec3 position{ std::sin(angle) * distance, -sceneRadius * 0.5f + std::sin(angle * 2.f) * sceneRadius * 0.25f, -std::cos(angle) * distance };
+
+	camera.setViewTarget(position, glm::vec3{ 0.f });
+	camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, distance + sceneRadius * 2.f);
+}
+
+void B3DBenchmark::endFrame(uint32_t drawCalls)
+{
+	const auto now = clock::now();
+	const bool measured = framesSeen >= settings.warmupFrames;
+
+	if (measured)
+	{
+		for (uint32_t stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			stageSamples[stage].push_back(currentStages[stage]);
+		}
+
+		//Frame time runs end to end, so the first frame of a run without warmup has nothing to measure from
+		if (framesSeen > 0)
+		{
+			frameTimes.push_back(std::chrono::duration<float, std::milli>(now - lastFrameEnd).count());
+		}
+
+		drawCallSamples.push_back(drawCalls);
+	}
+	else if (framesSeen + 1 == settings.warmupFrames)
+	{
+		PLOGI << "Benchmark warmup finished, measuring " << settings.frameCount << " frames";
+	}
+
+	currentStages.fill(0.f);
+	lastFrameEnd = now;
+	framesSeen++;
+}
+
+bool B3DBenchmark::finish(const std::vector<B3DGpuProfiler::ZoneStats>& gpuStats, VkExtent2D extent, bool headless)
+{
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(4);
+
+	auto writePercentiles = [&](const Percentiles& percentiles)
+	{
+		report << "{\"average\":" << percentiles.average << ",\"p50\":" << percentiles.p50 << ",\"p95\":" << percentiles.p95 << ",\"p99\":" << percentiles.p99 << ",\"max\":" << percentiles.max << "}";
+	};
+
+	report << "{\n";
+	report << "\"benchmark\":{\"objects\":" << settings.objectCount << ",\"movingObjects\":" << movingObjects.size() << ",\"movingRatio\":" << settings.movingRatio
+		<< ",\"mix\":{\"cube\":" << settings.cubeWeight << ",\"sphere\":" << settings.sphereWeight << ",\"desk\":" << settings.deskWeight << "}"
+		<< ",\"frames\":" << frameTimes.size() << ",\"warmupFrames\":" << settings.warmupFrames << ",\"seed\":" << settings.seed
+		<< ",\"width\":" << extent.width << ",\"height\":" << extent.height << ",\"headless\":" << (headless ? "true" : "false") << "},\n";
+
+	report << "\"frameTime\":";
+	writePercentiles(computePercentiles(frameTimes));
+	report << ",\n";
+
+	report << "\"cpuStages\":{";
+	for (uint32_t stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		if (stage > 0) report << ",";
+		report << "\n\"" << stageName(static_cast<Stage>(stage)) << "\":";
+		writePercentiles(computePercentiles(stageSamples[stage]));
+	}
+	report << "},\n";
+
+	//The GPU profiler only keeps a recent window, so its sample count is reported alongside the timings
+	report << "\"gpu\":{";
+	for (size_t i = 0; i < gpuStats.size(); i++)
+	{
+		const auto& stats = gpuStats[i];
+
+		if (i > 0) report << ",";
+		report << "\n\"";
+		writeEscaped(report, stats.name);
+		report << "\":{\"average\":" << stats.average << ",\"p50\":" << stats.p50 << ",\"p95\":" << stats.p95 << ",\"max\":" << stats.max << ",\"samples\":" << stats.sampleCount << "}";
+	}
+	report << "},\n";
+
+	std::vector<float> drawCalls(drawCallSamples.begin(), drawCallSamples.end());
+	Percentiles drawCallPercentiles = computePercentiles(drawCalls);
+	report << "\"drawCalls\":{\"average\":" << drawCallPercentiles.average << ",\"max\":" << drawCallPercentiles.max << "}";
+
+	std::vector<std::string> regressions;
+
+	if (!settings.baselinePath.empty())
+	{
+		regressions = compareWithBaseline(report.str() + "}");
+
+		report << ",\n\"baseline\":\"";
+		writeEscaped(report, settings.baselinePath);
+		report << "\",\n\"regressions\":[";
+
+		for (size_t i = 0; i < regressions.size(); i++)
+		{
+			if (i > 0) report << ",";
+			report << "\n\"";
+			writeEscaped(report, regressions[i]);
+			report << "\"";
+		}
+
+		report << "]";
+	}
+
+	report << "\n}\n";
+
+	std::ofstream file{ settings.outputPath, std::ios::trunc };
+
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open benchmark output: " + settings.outputPath);
+	}
+
+	file << report.str();
+
+	Percentiles frameTime = computePercentiles(frameTimes);
+	PLOGI << "Benchmark finished: " << frameTimes.size() << " frames, frame time avg " << frameTime.average << " ms, p50 " << frameTime.p50 << " ms, p95 " << frameTime.p95
+		<< " ms, p99 " << frameTime.p99 << " ms. Report written to " << settings.outputPath;
+
+	for (const auto& regression : regressions)
+	{
+		PLOGW << "Benchmark regression: " << regression;
+	}
+
+	return regressions.empty();
+}
+
+const char* B3DBenchmark::stageName(Stage stage)
+{
+	switch (stage)
+	{
+		case Stage::ACQUIRE: return "Acquire";
+		case Stage::ANIMATE: return "Animate";
+		case Stage::SCENE_UPDATE: return "Scene graph update";
+		case Stage::RECORD: return "Record";
+		case Stage::SUBMIT: return "Submit and present";
+		default: return "Unknown";
+	}
+}
+
+B3DBenchmark::Percentiles B3DBenchmark::computePercentiles(std::vector<float> samples)
+{
+	Percentiles percentiles{};
+
+	if (samples.empty()) return percentiles;
+
+	std::sort(samples.begin(), samples.end());
+
+	auto at = [&](size_t percent) { return static_cast<double>(samples[std::min(samples.size() - 1, samples.size() * percent / 100)]); };
+
+	for (float sample : samples)
+	{
+		percentiles.average += sample;
+	}
+
+	percentiles.average /= static_cast<double>(samples.size());
+	percentiles.p50 = at(50);
+	percentiles.p95 = at(95);
+	percentiles.p99 = at(99);
+	percentiles.max = samples.back();
+
+	return percentiles;
+}
+
+std::vector<std::string> B3DBenchmark::compareWithBaseline(const std::string& report) const
+{
+	std::vector<std::string> regressions;
+
+	std::ifstream file{ settings.baselinePath };
+
+	if (!file.is_open())
+	{
+		PLOGW << "Benchmark baseline " << settings.baselinePath << " not found, skipping comparison";
+		return regressions;
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	const std::string baselineText = buffer.str();
+
+	std::map<std::string, double> baseline;
+	std::map<std::string, double> current = FlatJsonReader{ report }.read();
+
+	try
+	{
+		baseline = FlatJsonReader{ baselineText }.read();
+	}
+	catch (const std::exception& e)
+	{
+		PLOGW << "Failed to read benchmark baseline " << settings.baselinePath << ": " << e.what();
+		return regressions;
+	}
+
+	if (baseline["benchmark.objects"] != current["benchmark.objects"] || baseline["benchmark.seed"] != current["benchmark.seed"])
+	{
+		PLOGW << "Benchmark baseline was recorded with a different scene, results may not be comparable";
+	}
+
+	for (const auto& [path, value] : current)
+	{
+		if (!isTimedMetric(path)) continue;
+
+		auto previous = baseline.find(path);
+		if (previous == baseline.end() || previous->second <= 0.0) continue;
+
+		const double limit = previous->second * (1.0 + settings.regressionThreshold);
+
+		if (value > limit && value - previous->second > NOISE_FLOOR_MS)
+		{
+			std::ostringstream message;
+			message << std::fixed << std::setprecision(3) << path << " " << previous->second << " ms -> " << value << " ms (+" << (value / previous->second - 1.0) * 100.0 << "%)";
+			regressions.push_back(message.str());
+		}
+	}
+
+	return regressions;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DGameObj.h"
+#include "B3DSceneGraph.h"
+#include "B3DCamera.h"
+#include "B3DGpuProfiler.h"
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//STD
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//What the benchmark spawns and how long it runs, filled in from the command line
+struct BenchmarkSettings
+{
+	uint32_t objectCount = 1000;
+
+	//Relative weights of each model in the scene, a weight of 0 leaves the model out
+	float cubeWeight = 1.f;
+	float sphereWeight = 1.f;
+	float deskWeight = 1.f;
+
+	//Fraction of objects animated every frame, the rest never dirty the scene graph
+	float movingRatio = 0.25f;
+
+	uint32_t frameCount = 1000;
+	uint32_t warmupFrames = 120;
+	uint32_t seed = 1;
+
+	std::string outputPath = "benchmark_results.json";
+
+	//Empty skips the comparison. Metrics slower than the baseline by more than the threshold are flagged
+	std::string baselinePath;
+	float regressionThreshold = 0.1f;
+};
+
+//Scalability benchmark for Based 3D.
+//Generates a seeded synthetic scene, flies the camera along a fixed orbit and records CPU stage, GPU and frame timings.
+//The report is written as JSON and can be compared against a previous report to catch regressions.
+class B3DBenchmark
+{
+	public:
+
+		using clock = std::chrono::steady_clock;
+
+		//Regressions smaller than this are treated as timer noise
+		static constexpr double NOISE_FLOOR_MS = 0.05;
+
+		enum class Stage : uint32_t
+		{
+			ACQUIRE,
+			ANIMATE,
+			SCENE_UPDATE,
+			RECORD,
+			SUBMIT,
+			COUNT,
+		};
+
+		//Adds its lifetime to a stage of the current frame, does nothing without a benchmark
+		class StageTimer
+		{
+			public:
+
+				StageTimer(B3DBenchmark* benchmark, Stage stage) : benchmark{ benchmark }, stage{ stage }, start{ benchmark ? clock::now() : clock::time_point{} } {}
+
+				~StageTimer()
+				{
+					if (benchmark) benchmark->addStageTime(stage, std::chrono::duration<float, std::milli>(clock::now() - start).count());
+				}
+
+				StageTimer(const StageTimer&) = delete;
+				StageTimer& operator=(const StageTimer&) = delete;
+
+			private:
+
+				B3DBenchmark* benchmark;
+				Stage stage;
+				clock::time_point start;
+		};
+
+		explicit B3DBenchmark(const BenchmarkSettings& settings);
+		~B3DBenchmark() = default;
+
+		B3DBenchmark(const B3DBenchmark&) = delete;
+		B3DBenchmark& operator=(const B3DBenchmark&) = delete;
+
+		const BenchmarkSettings& getSettings() const { return settings; }
+		uint32_t totalFrames() const { return settings.warmupFrames + settings.frameCount; }
+
+		void generateScene(B3DDevice& device, B3DSceneGraph& sceneGraph, std::vector<B3DGameObj>& gameObjects);
+
+		//Both are driven by the frame number rather than wall time, so every run sees the same scene from the same place
+		void animate(B3DSceneGraph& sceneGraph, uint32_t frame, float timestep);
+		void updateCamera(B3DCamera& camera, float aspect, uint32_t frame) const;
+
+		void addStageTime(Stage stage, float milliseconds) { currentStages[static_cast<uint32_t>(stage)] += milliseconds; }
+
+		//Call once per rendered frame, frames before the warmup is over are thrown away
+		void endFrame(uint32_t drawCalls);
+
+		//Writes the report and returns false if any metric regressed against the baseline
+		bool finish(const std::vector<B3DGpuProfiler::ZoneStats>& gpuStats, VkExtent2D extent, bool headless);
+
+		static const char* stageName(Stage stage);
+
+	private:
+
+		struct MovingObject
+		{
+			B3DSceneGraph::node_t node;
+			glm::vec3 basePosition;
+			float phase;
+			float spinSpeed;
+		};
+
+		struct Percentiles
+		{
+			double average = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		static constexpr uint32_t STAGE_COUNT = static_cast<uint32_t>(Stage::COUNT);
+
+		BenchmarkSettings settings;
+
+		std::vector<MovingObject> movingObjects;
+		float sceneRadius = 1.f;
+
+		std::array<float, STAGE_COUNT> currentStages{};
+		std::array<std::vector<float>, STAGE_COUNT> stageSamples;
+		std::vector<float> frameTimes;
+		std::vector<uint32_t> drawCallSamples;
+
+		clock::time_point lastFrameEnd{};
+		uint32_t framesSeen = 0;
+
+		static Percentiles computePercentiles(std::vector<float> samples);
+		std::vector<std::string> compareWithBaseline(const std::string& report) const;
+};
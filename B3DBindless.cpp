@@ -0,0 +1,190 @@
+#include "B3DBindless.h"
+
+//STD
+#include <algorithm>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+uint32_t B3DBindlessHeap::SlotAllocator::allocate()
+{
+	if (!freeSlots.empty())
+	{
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	if (nextSlot >= slotCapacity)
+	{
+		return INVALID_INDEX;
+	}
+
+	return nextSlot++;
+}
+
+void B3DBindlessHeap::SlotAllocator::free(uint32_t slot)
+{
+	assert(slot < nextSlot && "Freeing a slot that was never allocated!");
+	freeSlots.push_back(slot);
+}
+
+B3DBindlessHeap::B3DBindlessHeap(B3DDevice& device) : heapDevice{ device }, textureSlots{ MAX_TEXTURES }, bufferSlots{ MAX_BUFFERS }
+{
+	if (!heapDevice.supportsBindless())
+	{
+		throw std::runtime_error("Bindless heap needs descriptor indexing support!");
+	}
+
+	//Stay inside what the device lets a single update-after-bind set hold
+	const auto& limits = heapDevice.getDescriptorIndexingProperties();
+	uint32_t textureCapacity = std::min({ MAX_TEXTURES, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+	uint32_t bufferCapacity = std::min({ MAX_BUFFERS, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+	textureSlots = SlotAllocator{ textureCapacity };
+	bufferSlots = SlotAllocator{ bufferCapacity };
+
+	PLOGI << "Bindless heap holds " << textureCapacity << " textures and " << bufferCapacity << " buffers";
+
+	const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	setLayout = B3DDescriptorSetLayout::Builder(heapDevice)
+		.addBinding(TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS, textureCapacity, bindingFlags)
+		.addBinding(BUFFER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, bufferCapacity, bindingFlags)
+		.build();
+
+	descriptorPool = B3DDescriptorPool::Builder(heapDevice)
+		.setMaxSets(1)
+		.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity)
+		.build();
+
+	if (!descriptorPool->allocateDescriptor(setLayout->getDescriptorSetLayout(), descriptorSet))
+	{
+		throw std::runtime_error("Failed to allocate the bindless descriptor set!");
+	}
+}
+
+uint32_t B3DBindlessHeap::addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+
+	uint32_t index = textureSlots.allocate();
+	if (index == INVALID_INDEX)
+	{
+		PLOGW << "Bindless heap is out of texture slots";
+		return INVALID_INDEX;
+	}
+
+	writeTexture(index, imageView, sampler, layout);
+	return index;
+}
+
+void B3DBindlessHeap::updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+	writeTexture(index, imageView, sampler, layout);
+}
+
+uint32_t B3DBindlessHeap::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+
+	uint32_t index = bufferSlots.allocate();
+	if (index == INVALID_INDEX)
+	{
+		PLOGW << "Bindless heap is out of buffer slots";
+		return INVALID_INDEX;
+	}
+
+	writeBuffer(index, buffer, offset, range);
+	return index;
+}
+
+void B3DBindlessHeap::updateBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+	writeBuffer(index, buffer, offset, range);
+}
+
+void B3DBindlessHeap::removeTexture(uint32_t index)
+{
+	if (index == INVALID_INDEX) return;
+
+	std::lock_guard<std::mutex> lock(heapMutex);
+	pendingReleases.push_back({ index, true, heapDevice.getGraphicsTimeline().getFrameValue() });
+}
+
+void B3DBindlessHeap::removeBuffer(uint32_t index)
+{
+	if (index == INVALID_INDEX) return;
+
+	std::lock_guard<std::mutex> lock(heapMutex);
+	pendingReleases.push_back({ index, false, heapDevice.getGraphicsTimeline().getFrameValue() });
+}
+
+void B3DBindlessHeap::beginFrame()
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+
+	B3DTimeline& timeline = heapDevice.getGraphicsTimeline();
+
+	//Releases are queued in frame order, so the oldest are always at the front
+	while (!pendingReleases.empty() && timeline.isComplete(pendingReleases.front().releaseValue))
+	{
+		const PendingRelease& release = pendingReleases.front();
+
+		if (release.texture)
+		{
+			textureSlots.free(release.index);
+		}
+		else
+		{
+			bufferSlots.free(release.index);
+		}
+
+		pendingReleases.pop_front();
+	}
+}
+
+uint32_t B3DBindlessHeap::textureCount() const
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+	return textureSlots.inUse();
+}
+
+uint32_t B3DBindlessHeap::bufferCount() const
+{
+	std::lock_guard<std::mutex> lock(heapMutex);
+	return bufferSlots.inUse();
+}
+
+void B3DBindlessHeap::writeTexture(uint32_t index, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+{
+	assert(index < textureSlots.capacity() && "Texture index is outside the bindless heap!");
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+	imageInfo.imageLayout = layout;
+
+	B3DDescriptorWriter(*setLayout, *descriptorPool)
+		.writeImage(TEXTURE_BINDING, &imageInfo, index)
+		.overwrite(descriptorSet);
+}
+
+void B3DBindlessHeap::writeBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	assert(index < bufferSlots.capacity() && "Buffer index is outside the bindless heap!");
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	B3DDescriptorWriter(*setLayout, *descriptorPool)
+		.writeBuffer(BUFFER_BINDING, &bufferInfo, index)
+		.overwrite(descriptorSet);
+}
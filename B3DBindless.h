@@ -0,0 +1,100 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DDescriptors.h"
+#include "B3DSwapChain.h"
+
+//STD
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Bindless resource heap for Based 3D.
+//A single update-after-bind descriptor set holds large, partially bound arrays of sampled images and storage buffers.
+//Resources are registered once and referenced from shaders by their integer index, so switching material never rebinds a set.
+//Requires B3DDevice::supportsBindless.
+class B3DBindlessHeap
+{
+	public:
+
+		static constexpr uint32_t TEXTURE_BINDING = 0;
+		static constexpr uint32_t BUFFER_BINDING = 1;
+		static constexpr uint32_t MAX_TEXTURES = 16384;
+		static constexpr uint32_t MAX_BUFFERS = 4096;
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		//Hands out array indices, recently freed ones first
+		class SlotAllocator
+		{
+			public:
+
+				explicit SlotAllocator(uint32_t capacity) : slotCapacity{ capacity } {}
+
+				//Returns INVALID_INDEX once every slot is taken
+				uint32_t allocate();
+				void free(uint32_t slot);
+
+				uint32_t capacity() const { return slotCapacity; }
+				uint32_t inUse() const { return nextSlot - static_cast<uint32_t>(freeSlots.size()); }
+
+			private:
+
+				uint32_t slotCapacity;
+				uint32_t nextSlot = 0;
+				std::vector<uint32_t> freeSlots;
+		};
+
+		B3DBindlessHeap(B3DDevice& device);
+		~B3DBindlessHeap() = default;
+
+		B3DBindlessHeap(const B3DBindlessHeap&) = delete;
+		B3DBindlessHeap& operator=(const B3DBindlessHeap&) = delete;
+
+		//Safe to call from any thread. Slots may be written while frames using other slots are in flight
+		uint32_t addTexture(VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void updateTexture(uint32_t index, VkImageView imageView, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void updateBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+		//The slot is only reused once every frame that could still reference it has finished
+		void removeTexture(uint32_t index);
+		void removeBuffer(uint32_t index);
+
+		//Call once per frame after B3DRenderer::beginFrame
+		void beginFrame();
+
+		VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+
+		uint32_t textureCount() const;
+		uint32_t bufferCount() const;
+
+	private:
+
+		//Freed once the graphics timeline passes the last frame that could read the slot
+		struct PendingRelease
+		{
+			uint32_t index;
+			bool texture;
+			uint64_t releaseValue;
+		};
+
+		B3DDevice& heapDevice;
+
+		std::unique_ptr<B3DDescriptorSetLayout> setLayout;
+		std::unique_ptr<B3DDescriptorPool> descriptorPool;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		mutable std::mutex heapMutex;
+		SlotAllocator textureSlots;
+		SlotAllocator bufferSlots;
+
+		std::deque<PendingRelease> pendingReleases;
+
+		void writeTexture(uint32_t index, VkImageView imageView, VkSampler sampler, VkImageLayout layout);
+		void writeBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+};
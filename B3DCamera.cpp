@@ -9,6 +9,9 @@ void B3DCamera::setOrthoGraphicProjection(float left, float right, float top, fl
 	projectionMatrix[3][0] = -(right + left) / (right - left);
 	projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 	projectionMatrix[3][2] = -near / (far - near);
+
+	nearPlane = near;
+	farPlane = far;
 }
 
 void B3DCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far)
@@ -22,6 +25,9 @@ void B3DCamera::setPerspectiveProjection(float fovy, float aspect, float near, f
 	projectionMatrix[2][2] = far / (far - near);
 	projectionMatrix[2][3] = 1.f;
 	projectionMatrix[3][2] = -(far * near) / (far - near);
+
+	nearPlane = near;
+	farPlane = far;
 }
 
 void B3DCamera::setViewDirection(glm::vec3 position, glm::vec3 direction, glm::vec3 up)
@@ -23,8 +23,14 @@ class B3DCamera
 		const glm::mat4& getProjection() const { return projectionMatrix; }
 		const glm::mat4& getView() const { return viewMatrix; }
 
+		//Clip planes of the last projection set, as view space depths
+		float getNear() const { return nearPlane; }
+		float getFar() const { return farPlane; }
+
 	private:
 
 		glm::mat4 projectionMatrix{1.f};
 		glm::mat4 viewMatrix{ 1.f };
+		float nearPlane = 0.f;
+		float farPlane = 1.f;
 };
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "B3DClusteredLighting.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+B3DClusteredLighting::B3DClusteredLighting(B3DDevice& device, B3DJobSystem& jobSystem) : lightingDevice{ device }, lightingJobSystem{ jobSystem }
+{
+	//Clusters hold a count each and a fixed run of MAX_LIGHTS_PER_CLUSTER indices, so neither buffer depends on the scene
+	for (auto& frame : frameBuffers)
+	{
+		frame.lightBuffer = std::make_unique<B3DBuffer>(lightingDevice, sizeof(LightData), INITIAL_LIGHT_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.lightBuffer->map();
+
+		frame.clusterBuffer = std::make_unique<B3DBuffer>(lightingDevice, sizeof(uint32_t), CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.clusterBuffer->map();
+
+		frame.lightIndexBuffer = std::make_unique<B3DBuffer>(lightingDevice, sizeof(uint32_t), CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.lightIndexBuffer->map();
+
+		std::memset(frame.clusterBuffer->getMappedMemory(), 0, sizeof(uint32_t) * CLUSTER_COUNT);
+	}
+}
+
+B3DClusteredLighting::~B3DClusteredLighting()
+{
+}
+
+void B3DClusteredLighting::addLayoutBindings(B3DDescriptorSetLayout::Builder& builder)
+{
+	builder.addBinding(LIGHT_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	builder.addBinding(CLUSTER_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	builder.addBinding(LIGHT_INDEX_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+}
+
+uint32_t B3DClusteredLighting::addLight(const Light& light)
+{
+	lights.push_back(light);
+	return static_cast<uint32_t>(lights.size() - 1);
+}
+
+B3DClusteredLighting::ClusterUniforms B3DClusteredLighting::update(int frameIndex, const B3DCamera& camera, VkExtent2D extent, B3DDescriptorCache& descriptorCache)
+{
+	B3D_PROFILE_FUNCTION();
+	B3D_PROFILE_COUNTER("Lights", lights.size());
+
+	ensureLightCapacity(frameIndex, descriptorCache);
+
+	FrameBuffers& frame = frameBuffers[frameIndex];
+
+	const float nearPlane = std::max(camera.getNear(), MIN_CLUSTER_NEAR);
+	const float farPlane = std::max(camera.getFar(), nearPlane * 2.f);
+
+	//slice = log(depth) * scale + bias puts the near plane at slice 0 and the far plane at the last
+	const float sliceScale = static_cast<float>(CLUSTER_GRID_Z) / std::log(farPlane / nearPlane);
+	const float sliceBias = -static_cast<float>(CLUSTER_GRID_Z) * std::log(nearPlane) / std::log(farPlane / nearPlane);
+
+	ClusterUniforms uniforms{};
+	uniforms.gridSize = { CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, MAX_LIGHTS_PER_CLUSTER };
+	uniforms.tileSizeAndSlicing = { std::ceil(static_cast<float>(extent.width) / CLUSTER_GRID_X), std::ceil(static_cast<float>(extent.height) / CLUSTER_GRID_Y), sliceScale, sliceBias };
+
+	writeLights(static_cast<LightData*>(frame.lightBuffer->getMappedMemory()));
+
+	const glm::mat4& view = camera.getView();
+	const glm::mat4& projection = camera.getProjection();
+
+	lightBounds.resize(lights.size());
+
+	lightingJobSystem.parallelFor(0, lights.size(), MIN_LIGHTS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			lightBounds[i] = computeBounds(lights[i], view, projection, sliceScale, sliceBias, nearPlane, farPlane);
+		}
+	}, "Bound lights");
+
+	//Bucketed by slice so each binning job owns its slice's clusters outright and needs no atomics
+	for (auto& slice : sliceLights)
+	{
+		slice.clear();
+	}
+
+	for (uint32_t i = 0; i < lightBounds.size(); i++)
+	{
+		if (!lightBounds[i].visible) continue;
+
+		for (uint32_t z = lightBounds[i].min.z; z <= lightBounds[i].max.z; z++)
+		{
+			sliceLights[z].push_back(i);
+		}
+	}
+
+	uint32_t* clusterCounts = static_cast<uint32_t*>(frame.clusterBuffer->getMappedMemory());
+	uint32_t* lightIndices = static_cast<uint32_t*>(frame.lightIndexBuffer->getMappedMemory());
+	std::array<uint32_t, CLUSTER_GRID_Z> sliceOverflows{};
+
+	lightingJobSystem.parallelFor(0, CLUSTER_GRID_Z, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t z = begin; z < end; z++)
+		{
+			const uint32_t sliceFirst = static_cast<uint32_t>(z) * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+
+			std::array<uint32_t, CLUSTER_GRID_X * CLUSTER_GRID_Y> counts{};
+
+			//Lights are added in scene order, once a cluster is full the rest of its lights are dropped
+			for (uint32_t light : sliceLights[z])
+			{
+				const LightBounds& bounds = lightBounds[light];
+
+				for (uint32_t y = bounds.min.y; y <= bounds.max.y; y++)
+				{
+					for (uint32_t x = bounds.min.x; x <= bounds.max.x; x++)
+					{
+						const uint32_t tile = y * CLUSTER_GRID_X + x;
+						uint32_t& count = counts[tile];
+
+						if (count == MAX_LIGHTS_PER_CLUSTER)
+						{
+							sliceOverflows[z]++;
+							continue;
+						}
+
+						lightIndices[(sliceFirst + tile) * MAX_LIGHTS_PER_CLUSTER + count] = light;
+						count++;
+					}
+				}
+			}
+
+			std::memcpy(clusterCounts + sliceFirst, counts.data(), sizeof(counts));
+		}
+	}, "Bin lights");
+
+	overflowCount = 0;
+	for (uint32_t overflows : sliceOverflows)
+	{
+		overflowCount += overflows;
+	}
+
+	B3D_PROFILE_COUNTER("Dropped cluster lights", overflowCount);
+
+	return uniforms;
+}
+
+void B3DClusteredLighting::writeDescriptors(B3DDescriptorWriter& writer, int frameIndex)
+{
+	FrameBuffers& frame = frameBuffers[frameIndex];
+
+	frame.lightInfo = frame.lightBuffer->descriptorInfo();
+	frame.clusterInfo = frame.clusterBuffer->descriptorInfo();
+	frame.lightIndexInfo = frame.lightIndexBuffer->descriptorInfo();
+
+	writer.writeBuffer(LIGHT_BINDING, &frame.lightInfo);
+	writer.writeBuffer(CLUSTER_BINDING, &frame.clusterInfo);
+	writer.writeBuffer(LIGHT_INDEX_BINDING, &frame.lightIndexInfo);
+}
+
+void B3DClusteredLighting::ensureLightCapacity(int frameIndex, B3DDescriptorCache& descriptorCache)
+{
+	auto& buffer = frameBuffers[frameIndex].lightBuffer;
+
+	if (buffer->getInstanceCount() >= lights.size()) return;
+
+	uint32_t capacity = buffer->getInstanceCount();
+	while (capacity < lights.size())
+	{
+		capacity *= 2;
+	}
+
+	//Nothing in flight reads this frame's buffer, but its cached set has to go before the handle can be reused
+	descriptorCache.releaseResource(buffer->getBuffer());
+
+	buffer = std::make_unique<B3DBuffer>(lightingDevice, sizeof(LightData), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	buffer->map();
+}
+
+void B3DClusteredLighting::writeLights(LightData* lightData)
+{
+	lightingJobSystem.parallelFor(0, lights.size(), MIN_LIGHTS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Light& light = lights[i];
+
+			LightData data{};
+			data.positionRadius = glm::vec4{ light.position, light.radius };
+			data.colorIntensity = glm::vec4{ light.color, light.intensity };
+
+			if (glm::dot(light.direction, light.direction) > 0.f)
+			{
+				data.spotDirection = glm::vec4{ glm::normalize(light.direction), std::cos(light.outerConeAngle) };
+				data.spotParams = glm::vec4{ std::cos(light.innerConeAngle), 0.f, 0.f, 0.f };
+			}
+
+			lightData[i] = data;
+		}
+	}, "Write lights");
+}
+
+B3DClusteredLighting::LightBounds B3DClusteredLighting::computeBounds(const Light& light, const glm::mat4& view, const glm::mat4& projection, float sliceScale, float sliceBias, float nearPlane, float farPlane) const
+{
+	LightBounds bounds{};
+
+	const glm::vec3 center = glm::vec3{ view * glm::vec4{ light.position, 1.f } };
+	const float radius = light.radius;
+
+	if (center.z + radius < nearPlane || center.z - radius > farPlane) return bounds;
+
+	//The sphere's view space box, projected corner by corner. A corner in front of the near plane is pulled onto it, which
+	//only widens the rectangle because the projection grows as depth shrinks
+	glm::vec2 screenMin{ 1.f };
+	glm::vec2 screenMax{ -1.f };
+
+	const float minDepth = std::max(center.z - radius, nearPlane);
+	const float maxDepth = std::max(center.z + radius, nearPlane);
+
+	for (float depth : { minDepth, maxDepth })
+	{
+		for (float x : { center.x - radius, center.x + radius })
+		{
+			for (float y : { center.y - radius, center.y + radius })
+			{
+				glm::vec4 clip = projection * glm::vec4{ x, y, depth, 1.f };
+				glm::vec2 ndc = glm::vec2{ clip } / clip.w;
+
+				screenMin = glm::min(screenMin, ndc);
+				screenMax = glm::max(screenMax, ndc);
+			}
+		}
+	}
+
+	if (screenMax.x < -1.f || screenMin.x > 1.f || screenMax.y < -1.f || screenMin.y > 1.f) return bounds;
+
+	auto tileOf = [](float ndc, uint32_t tiles)
+	{
+		const float tile = (glm::clamp(ndc, -1.f, 1.f) * 0.5f + 0.5f) * static_cast<float>(tiles);
+		return std::min(static_cast<uint32_t>(tile), tiles - 1);
+	};
+
+	bounds.min = { tileOf(screenMin.x, CLUSTER_GRID_X), tileOf(screenMin.y, CLUSTER_GRID_Y), sliceOf(minDepth, sliceScale, sliceBias) };
+	bounds.max = { tileOf(screenMax.x, CLUSTER_GRID_X), tileOf(screenMax.y, CLUSTER_GRID_Y), sliceOf(std::min(center.z + radius, farPlane), sliceScale, sliceBias) };
+	bounds.visible = true;
+
+	return bounds;
+}
+
+uint32_t B3DClusteredLighting::sliceOf(float viewDepth, float sliceScale, float sliceBias) const
+{
+	const float slice = std::log(viewDepth) * sliceScale + sliceBias;
+
+	return std::min(static_cast<uint32_t>(std::max(slice, 0.f)), CLUSTER_GRID_Z - 1);
+}
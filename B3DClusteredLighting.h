@@ -0,0 +1,142 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DBuffer.h"
+#include "B3DCamera.h"
+#include "B3DDescriptors.h"
+#include "B3DJobSystem.h"
+#include "B3DSwapChain.h"
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//STD
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//Clustered forward lighting for Based 3D.
+//The view frustum is cut into a grid of froxels, screen tiles split into depth slices that grow exponentially with distance.
+//Every frame the lights are binned into the froxels they touch on the job system, and the fragment shader only loops over the
+//lights of its own froxel. Each froxel keeps at most MAX_LIGHTS_PER_CLUSTER lights, so the cost per pixel stays bounded
+//however many lights the scene has.
+class B3DClusteredLighting
+{
+	public:
+
+		static constexpr uint32_t CLUSTER_GRID_X = 16;
+		static constexpr uint32_t CLUSTER_GRID_Y = 9;
+		static constexpr uint32_t CLUSTER_GRID_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+		static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 64;
+
+		static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 256;
+		static constexpr uint32_t MIN_LIGHTS_PER_JOB = 1024;
+
+		//Depth slicing is logarithmic, so the near plane can't be 0
+		static constexpr float MIN_CLUSTER_NEAR = 0.01f;
+
+		//Bindings the light buffers take in the global set
+		static constexpr uint32_t LIGHT_BINDING = 1;
+		static constexpr uint32_t CLUSTER_BINDING = 2;
+		static constexpr uint32_t LIGHT_INDEX_BINDING = 3;
+
+		//A spot light if the direction is non-zero, otherwise a point light. Either way nothing is lit past the radius
+		struct Light
+		{
+			glm::vec3 position{ 0.f };
+			float radius = 1.f;
+			glm::vec3 color{ 1.f };
+			float intensity = 1.f;
+			glm::vec3 direction{ 0.f };
+			float innerConeAngle = 0.f;
+			float outerConeAngle = 0.f;
+		};
+
+		//Matches the cluster fields closing the global UBO of simple_shader.vert and simple_shader.frag under std140
+		struct ClusterUniforms
+		{
+			//Cluster counts in x, y and z, then the cap on lights per cluster
+			glm::uvec4 gridSize{ 0 };
+
+			//Pixels per tile in x and y, then the scale and bias turning log view depth into a slice
+			glm::vec4 tileSizeAndSlicing{ 0.f };
+		};
+
+		B3DClusteredLighting(B3DDevice& device, B3DJobSystem& jobSystem);
+		~B3DClusteredLighting();
+
+		B3DClusteredLighting(const B3DClusteredLighting&) = delete;
+		B3DClusteredLighting& operator=(const B3DClusteredLighting&) = delete;
+
+		static void addLayoutBindings(B3DDescriptorSetLayout::Builder& builder);
+
+		uint32_t addLight(const Light& light);
+		Light& getLight(uint32_t light) { return lights[light]; }
+		size_t getLightCount() const { return lights.size(); }
+		void clearLights() { lights.clear(); }
+
+		//Bins the lights for this frame's slot, call once the slot's last submit has been waited on
+		ClusterUniforms update(int frameIndex, const B3DCamera& camera, VkExtent2D extent, B3DDescriptorCache& descriptorCache);
+
+		//Adds this frame's light buffers to a writer for the global set, the infos live until the next update of the slot
+		void writeDescriptors(B3DDescriptorWriter& writer, int frameIndex);
+
+		//Light insertions dropped across all clusters in the last update, because the cluster was already full
+		uint32_t getOverflowCount() const { return overflowCount; }
+
+	private:
+
+		//Matches LightData in simple_shader.frag under std430
+		struct LightData
+		{
+			glm::vec4 positionRadius{ 0.f };
+			glm::vec4 colorIntensity{ 0.f };
+
+			//Cosine of the outer cone in w, a zero direction for point lights
+			glm::vec4 spotDirection{ 0.f };
+
+			//Cosine of the inner cone in x
+			glm::vec4 spotParams{ 0.f };
+		};
+
+		//The froxels a light touches, empty if it is outside the frustum
+		struct LightBounds
+		{
+			glm::uvec3 min;
+			glm::uvec3 max;
+			bool visible;
+		};
+
+		struct FrameBuffers
+		{
+			std::unique_ptr<B3DBuffer> lightBuffer;
+			std::unique_ptr<B3DBuffer> clusterBuffer;
+			std::unique_ptr<B3DBuffer> lightIndexBuffer;
+
+			VkDescriptorBufferInfo lightInfo;
+			VkDescriptorBufferInfo clusterInfo;
+			VkDescriptorBufferInfo lightIndexInfo;
+		};
+
+		B3DDevice& lightingDevice;
+		B3DJobSystem& lightingJobSystem;
+
+		std::vector<Light> lights;
+		std::array<FrameBuffers, B3DSwapChain::MAX_FRAMES_IN_FLIGHT> frameBuffers;
+
+		//Scratch kept between frames so binning doesn't allocate
+		std::vector<LightBounds> lightBounds;
+		std::array<std::vector<uint32_t>, CLUSTER_GRID_Z> sliceLights;
+
+		uint32_t overflowCount = 0;
+
+		void ensureLightCapacity(int frameIndex, B3DDescriptorCache& descriptorCache);
+		void writeLights(LightData* lightData);
+		LightBounds computeBounds(const Light& light, const glm::mat4& view, const glm::mat4& projection, float sliceScale, float sliceBias, float nearPlane, float farPlane) const;
+		uint32_t sliceOf(float viewDepth, float sliceScale, float sliceBias) const;
+};
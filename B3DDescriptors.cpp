@@ -1,6 +1,26 @@
 #include "B3DDescriptors.h"
 
-B3DDescriptorSetLayout::Builder& B3DDescriptorSetLayout::Builder::addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t count)
+//Local
+#include "B3DUtils.h"
+
+//STD
+#include <algorithm>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+    //Non-dispatchable handles are pointers on 64-bit builds and integers elsewhere
+    template<typename Handle>
+    uint64_t handleValue(Handle handle)
+    {
+        return (uint64_t)(handle);
+    }
+}
+
+B3DDescriptorSetLayout::Builder& B3DDescriptorSetLayout::Builder::addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t count, VkDescriptorBindingFlags flags)
 {
     assert(bindings.count(binding) == 0 && "Binding already in use!");
 
@@ -11,6 +31,12 @@ B3DDescriptorSetLayout::Builder& B3DDescriptorSetLayout::Builder::addBinding(uin
     layoutBinding.stageFlags = stageFlags;
     bindings[binding] = layoutBinding;
 
+    if (flags != 0)
+    {
+        assert(builderDevice.supportsBindless() && "Descriptor binding flags need descriptor indexing!");
+        bindingFlags[binding] = flags;
+    }
+
     return *this;
 }
 
@@ -39,16 +65,22 @@ std::unique_ptr<B3DDescriptorPool> B3DDescriptorPool::Builder::build() const
 
 std::unique_ptr<B3DDescriptorSetLayout> B3DDescriptorSetLayout::Builder::build() const
 {
-    return std::make_unique<B3DDescriptorSetLayout>(builderDevice, bindings);
+    return std::make_unique<B3DDescriptorSetLayout>(builderDevice, bindings, bindingFlags);
 }
 
-B3DDescriptorSetLayout::B3DDescriptorSetLayout(B3DDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings) : desSetDevice{device}, bindings{bindings}
+B3DDescriptorSetLayout::B3DDescriptorSetLayout(B3DDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings, const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags) : desSetDevice{device}, bindings{bindings}
 {
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+    std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+    bool updateAfterBind = false;
 
     for (auto kv : bindings)
     {
         setLayoutBindings.push_back(kv.second);
+
+        auto flags = bindingFlags.find(kv.first);
+        setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
+        updateAfterBind |= (setLayoutBindingFlags.back() & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
     }
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -56,6 +88,21 @@ B3DDescriptorSetLayout::B3DDescriptorSetLayout(B3DDevice& device, std::unordered
     descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
     descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+
+    if (!bindingFlags.empty())
+    {
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+        descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+    }
+
+    if (updateAfterBind)
+    {
+        descriptorSetLayoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+
     if (vkCreateDescriptorSetLayout(desSetDevice.device(), &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create descriptor set layout!");
@@ -114,23 +161,219 @@ void B3DDescriptorPool::resetPool()
     vkResetDescriptorPool(desPoolDevice.device(), descriptorPool, 0);
 }
 
-B3DDescriptorWriter::B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout, B3DDescriptorPool& pool) : setLayout{setLayout}, pool{pool}
+B3DDescriptorAllocator::B3DDescriptorAllocator(B3DDevice& device, VkDescriptorPoolCreateFlags poolFlags, const std::vector<PoolSizeRatio>& poolRatios) : allocatorDevice{ device }, allocatorPoolFlags{ poolFlags }, allocatorPoolRatios{ poolRatios }
+{
+
+}
+
+B3DDescriptorAllocator::~B3DDescriptorAllocator()
+{
+    for (auto pool : usedPools)
+    {
+        vkDestroyDescriptorPool(allocatorDevice.device(), pool, nullptr);
+    }
+
+    for (auto pool : freePools)
+    {
+        vkDestroyDescriptorPool(allocatorDevice.device(), pool, nullptr);
+    }
+}
+
+std::vector<B3DDescriptorAllocator::PoolSizeRatio> B3DDescriptorAllocator::defaultPoolRatios()
+{
+    return {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+    };
+}
+
+VkDescriptorSet B3DDescriptorAllocator::allocate(VkDescriptorSetLayout descriptorSetLayout)
+{
+    if (currentPool == VK_NULL_HANDLE)
+    {
+        currentPool = grabPool();
+    }
+
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkResult result = tryAllocate(currentPool, descriptorSetLayout, descriptorSet);
+
+    const bool canFreeSets = allocatorPoolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+    //Older pools that had sets freed back since they ran out get another try before the allocator grows
+    if (canFreeSets && (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL))
+    {
+        poolUsage[currentPool].hasFreedSets = false;
+
+        for (auto pool : usedPools)
+        {
+            PoolUsage& usage = poolUsage[pool];
+            if (pool == currentPool || !usage.hasFreedSets) continue;
+
+            result = tryAllocate(pool, descriptorSetLayout, descriptorSet);
+            if (result == VK_SUCCESS)
+            {
+                currentPool = pool;
+                break;
+            }
+
+            usage.hasFreedSets = false;
+        }
+    }
+
+    //Every pool is full or too fragmented, move on to a fresh one and try once more
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        currentPool = grabPool();
+        result = tryAllocate(currentPool, descriptorSetLayout, descriptorSet);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate descriptor set!");
+    }
+
+    if (canFreeSets)
+    {
+        setOwners[descriptorSet] = currentPool;
+        poolUsage[currentPool].liveSets++;
+    }
+
+    return descriptorSet;
+}
+
+VkResult B3DDescriptorAllocator::tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet)
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    allocInfo.descriptorSetCount = 1;
+
+    return vkAllocateDescriptorSets(allocatorDevice.device(), &allocInfo, &descriptorSet);
+}
+
+void B3DDescriptorAllocator::free(VkDescriptorSet descriptorSet)
+{
+    assert((allocatorPoolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) && "Allocator pools were not created to free single sets!");
+
+    auto owner = setOwners.find(descriptorSet);
+    if (owner == setOwners.end())
+    {
+        PLOGW << "Tried to free a descriptor set this allocator does not own";
+        return;
+    }
+
+    VkDescriptorPool pool = owner->second;
+    vkFreeDescriptorSets(allocatorDevice.device(), pool, 1, &descriptorSet);
+    setOwners.erase(owner);
+
+    PoolUsage& usage = poolUsage[pool];
+    usage.liveSets--;
+    usage.hasFreedSets = true;
+
+    //An emptied pool is reset whole and parked, which also undoes any fragmentation, so churn can't keep adding pools
+    if (usage.liveSets == 0 && pool != currentPool)
+    {
+        vkResetDescriptorPool(allocatorDevice.device(), pool, 0);
+        usedPools.erase(std::find(usedPools.begin(), usedPools.end(), pool));
+        freePools.push_back(pool);
+        poolUsage.erase(pool);
+    }
+}
+
+void B3DDescriptorAllocator::resetPools()
 {
+    for (auto pool : usedPools)
+    {
+        vkResetDescriptorPool(allocatorDevice.device(), pool, 0);
+        freePools.push_back(pool);
+    }
 
+    usedPools.clear();
+    setOwners.clear();
+    poolUsage.clear();
+    currentPool = VK_NULL_HANDLE;
 }
 
-B3DDescriptorWriter& B3DDescriptorWriter::writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo)
+VkDescriptorPool B3DDescriptorAllocator::grabPool()
+{
+    VkDescriptorPool pool;
+
+    if (!freePools.empty())
+    {
+        pool = freePools.back();
+        freePools.pop_back();
+    }
+    else
+    {
+        pool = createPool(setsPerPool);
+
+        //Each new pool is bigger than the last, so a busy allocator settles on a handful of pools
+        setsPerPool = std::min(MAX_SETS_PER_POOL, setsPerPool + setsPerPool / 2);
+    }
+
+    usedPools.push_back(pool);
+    return pool;
+}
+
+VkDescriptorPool B3DDescriptorAllocator::createPool(uint32_t setCount)
+{
+    std::vector<VkDescriptorPoolSize> poolSizes{};
+    for (const auto& ratio : allocatorPoolRatios)
+    {
+        poolSizes.push_back({ ratio.descriptorType, std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount)) });
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes.data();
+    descriptorPoolInfo.maxSets = setCount;
+    descriptorPoolInfo.flags = allocatorPoolFlags;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(allocatorDevice.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create descriptor pool!");
+    }
+
+    return pool;
+}
+
+B3DDescriptorWriter::B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout, B3DDescriptorPool& pool) : setLayout{setLayout}, pool{&pool}
+{
+
+}
+
+B3DDescriptorWriter::B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout, B3DDescriptorAllocator& allocator) : setLayout{ setLayout }, allocator{ &allocator }
+{
+
+}
+
+B3DDescriptorWriter::B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout) : setLayout{ setLayout }
+{
+
+}
+
+B3DDescriptorWriter& B3DDescriptorWriter::writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo, uint32_t arrayElement)
 {
     assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding!");
 
     auto& bindingDescription = setLayout.bindings[binding];
 
-    assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info when binding expect multiple!");
+    assert(arrayElement < bindingDescription.descriptorCount && "Array element is outside the binding!");
 
     VkWriteDescriptorSet write{};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write.descriptorType = bindingDescription.descriptorType;
     write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
     write.pBufferInfo = bufferInfo;
     write.descriptorCount = 1;
 
@@ -138,18 +381,19 @@ B3DDescriptorWriter& B3DDescriptorWriter::writeBuffer(uint32_t binding, VkDescri
     return *this;
 }
 
-B3DDescriptorWriter& B3DDescriptorWriter::writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo)
+B3DDescriptorWriter& B3DDescriptorWriter::writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement)
 {
     assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding!");
 
     auto& bindingDescription = setLayout.bindings[binding];
 
-    assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info when binding expect multiple!");
+    assert(arrayElement < bindingDescription.descriptorCount && "Array element is outside the binding!");
 
     VkWriteDescriptorSet write{};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write.descriptorType = bindingDescription.descriptorType;
     write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
     write.pImageInfo = imageInfo;
     write.descriptorCount = 1;
 
@@ -159,11 +403,17 @@ B3DDescriptorWriter& B3DDescriptorWriter::writeImage(uint32_t binding, VkDescrip
 
 bool B3DDescriptorWriter::build(VkDescriptorSet& set)
 {
-    bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-    if (!success)
+    assert((pool || allocator) && "Writer has nothing to allocate from!");
+
+    if (allocator)
+    {
+        set = allocator->allocate(setLayout.getDescriptorSetLayout());
+    }
+    else if (!pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set))
     {
         return false;
     }
+
     overwrite(set);
     return true;
 }
@@ -175,5 +425,136 @@ void B3DDescriptorWriter::overwrite(VkDescriptorSet& set)
         write.dstSet = set;
     }
 
-    vkUpdateDescriptorSets(pool.desPoolDevice.device(), writes.size(), writes.data(), 0, nullptr);
+    vkUpdateDescriptorSets(setLayout.desSetDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+B3DDescriptorCache::B3DDescriptorCache(B3DDevice& device) : cacheDevice{ device }, persistentAllocator{ device, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT }
+{
+    for (auto& frameAllocator : frameAllocators)
+    {
+        frameAllocator = std::make_unique<B3DDescriptorAllocator>(cacheDevice);
+    }
+}
+
+void B3DDescriptorCache::beginFrame(int frameIndex)
+{
+    currentFrame = frameIndex;
+    frameNumber++;
+
+    frameAllocators[frameIndex]->resetPools();
+
+    //Frees are queued in frame order, so the oldest are always at the front
+    while (!pendingFrees.empty() && cacheDevice.getGraphicsTimeline().isComplete(pendingFrees.front().releaseValue))
+    {
+        persistentAllocator.free(pendingFrees.front().descriptorSet);
+        pendingFrees.pop_front();
+    }
+
+    for (auto it = cachedSets.begin(); it != cachedSets.end();)
+    {
+        if (frameNumber - it->second.lastUsedFrame > EVICT_AFTER_FRAMES)
+        {
+            retire(it->second.descriptorSet);
+            it = cachedSets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+VkDescriptorSet B3DDescriptorCache::getSet(B3DDescriptorWriter& writer)
+{
+    CacheKey key{};
+    key.layout = writer.setLayout.getDescriptorSetLayout();
+
+    std::vector<uint64_t> resources{};
+
+    for (const auto& write : writer.writes)
+    {
+        key.bindings.push_back(write.dstBinding);
+        key.bindings.push_back(write.dstArrayElement);
+        key.bindings.push_back(write.descriptorType);
+
+        if (write.pBufferInfo)
+        {
+            key.bindings.push_back(handleValue(write.pBufferInfo->buffer));
+            key.bindings.push_back(write.pBufferInfo->offset);
+            key.bindings.push_back(write.pBufferInfo->range);
+            resources.push_back(handleValue(write.pBufferInfo->buffer));
+        }
+        else if (write.pImageInfo)
+        {
+            key.bindings.push_back(handleValue(write.pImageInfo->sampler));
+            key.bindings.push_back(handleValue(write.pImageInfo->imageView));
+            key.bindings.push_back(write.pImageInfo->imageLayout);
+            resources.push_back(handleValue(write.pImageInfo->imageView));
+        }
+    }
+
+    auto cached = cachedSets.find(key);
+    if (cached != cachedSets.end())
+    {
+        cached->second.lastUsedFrame = frameNumber;
+        return cached->second.descriptorSet;
+    }
+
+    VkDescriptorSet descriptorSet = persistentAllocator.allocate(key.layout);
+    writer.overwrite(descriptorSet);
+
+    cachedSets.emplace(std::move(key), CachedSet{ descriptorSet, frameNumber, std::move(resources) });
+    return descriptorSet;
+}
+
+VkDescriptorSet B3DDescriptorCache::allocateTransient(VkDescriptorSetLayout descriptorSetLayout)
+{
+    return frameAllocators[currentFrame]->allocate(descriptorSetLayout);
+}
+
+void B3DDescriptorCache::releaseResource(VkBuffer buffer)
+{
+    releaseHandle(handleValue(buffer));
+}
+
+void B3DDescriptorCache::releaseResource(VkImageView imageView)
+{
+    releaseHandle(handleValue(imageView));
+}
+
+void B3DDescriptorCache::releaseHandle(uint64_t handle)
+{
+    for (auto it = cachedSets.begin(); it != cachedSets.end();)
+    {
+        const auto& resources = it->second.resources;
+
+        if (std::find(resources.begin(), resources.end(), handle) != resources.end())
+        {
+            retire(it->second.descriptorSet);
+            it = cachedSets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void B3DDescriptorCache::retire(VkDescriptorSet descriptorSet)
+{
+    //Frames still in flight may have the set bound
+    pendingFrees.push_back({ descriptorSet, cacheDevice.getGraphicsTimeline().getFrameValue() });
+}
+
+size_t B3DDescriptorCache::CacheKeyHash::operator()(const CacheKey& key) const
+{
+    size_t seed = 0;
+    B3DUtills::hashCombine(seed, handleValue(key.layout));
+
+    for (uint64_t value : key.bindings)
+    {
+        B3DUtills::hashCombine(seed, value);
+    }
+
+    return seed;
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 //STD
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -8,6 +11,7 @@
 
 //Local
 #include "B3DDevice.h"
+#include "B3DSwapChain.h"
 
 class B3DDescriptorSetLayout
 {
@@ -19,16 +23,18 @@ class B3DDescriptorSetLayout
 
 				Builder(B3DDevice& device) : builderDevice{ device } {}
 
-				Builder& addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t count = 1);
+				//Binding flags need descriptor indexing, an update-after-bind binding makes the whole layout update-after-bind
+				Builder& addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags, uint32_t count = 1, VkDescriptorBindingFlags bindingFlags = 0);
 
 				std::unique_ptr<B3DDescriptorSetLayout> build() const;
 
 			private:
 				B3DDevice& builderDevice;
 				std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+				std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
 		};
 
-		B3DDescriptorSetLayout(B3DDevice &device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+		B3DDescriptorSetLayout(B3DDevice &device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings, const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags = {});
 		~B3DDescriptorSetLayout();
 
 		B3DDescriptorSetLayout(const B3DDescriptorSetLayout&) = delete;
@@ -88,14 +94,85 @@ class B3DDescriptorPool
 		friend class B3DDescriptorWriter;
 };
 
+//Descriptor allocator that never runs dry.
+//Sets come from a chain of pools, and a new, larger pool is created whenever the current one is exhausted. With single sets
+//freeable, pools with freed room are tried before growing and emptied pools are reset for reuse.
+//resetPools hands every set back at once with vkResetDescriptorPool, so short-lived sets cost nothing to release.
+//Not thread safe.
+class B3DDescriptorAllocator
+{
+	public:
+
+		//Descriptors of each type a pool holds per set it can allocate
+		struct PoolSizeRatio
+		{
+			VkDescriptorType descriptorType;
+			float ratio;
+		};
+
+		static constexpr uint32_t INITIAL_SETS_PER_POOL = 32;
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		B3DDescriptorAllocator(B3DDevice& device, VkDescriptorPoolCreateFlags poolFlags = 0, const std::vector<PoolSizeRatio>& poolRatios = defaultPoolRatios());
+		~B3DDescriptorAllocator();
+
+		B3DDescriptorAllocator(const B3DDescriptorAllocator&) = delete;
+		B3DDescriptorAllocator& operator=(const B3DDescriptorAllocator&) = delete;
+
+		//Only throws if a fresh pool cannot hold the layout either
+		VkDescriptorSet allocate(VkDescriptorSetLayout descriptorSetLayout);
+
+		//Needs VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, the GPU must be done with the set
+		void free(VkDescriptorSet descriptorSet);
+
+		//Every set from this allocator becomes invalid, the GPU must be done with all of them
+		void resetPools();
+
+		uint32_t poolCount() const { return static_cast<uint32_t>(usedPools.size() + freePools.size()); }
+
+		static std::vector<PoolSizeRatio> defaultPoolRatios();
+
+	private:
+
+		B3DDevice& allocatorDevice;
+		VkDescriptorPoolCreateFlags allocatorPoolFlags;
+		std::vector<PoolSizeRatio> allocatorPoolRatios;
+
+		uint32_t setsPerPool = INITIAL_SETS_PER_POOL;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> usedPools;
+		std::vector<VkDescriptorPool> freePools;
+
+		//Only tracked when sets can be freed one at a time
+		struct PoolUsage
+		{
+			uint32_t liveSets = 0;
+
+			//Set when a set is freed back, so a pool that ran out is only tried again once it has room
+			bool hasFreedSets = false;
+		};
+
+		std::unordered_map<VkDescriptorSet, VkDescriptorPool> setOwners;
+		std::unordered_map<VkDescriptorPool, PoolUsage> poolUsage;
+
+		VkResult tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet);
+		VkDescriptorPool grabPool();
+		VkDescriptorPool createPool(uint32_t setCount);
+};
+
 class B3DDescriptorWriter
 {
 	public:
 
 		B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout, B3DDescriptorPool &pool);
+		B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout, B3DDescriptorAllocator& allocator);
+
+		//For overwrite and B3DDescriptorCache::getSet, which bring their own sets
+		explicit B3DDescriptorWriter(B3DDescriptorSetLayout& setLayout);
 
-		B3DDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
-		B3DDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+		//Array bindings are written one element at a time, arrayElement picks which
+		B3DDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo, uint32_t arrayElement = 0);
+		B3DDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement = 0);
 
 		bool build(VkDescriptorSet& set);
 		void overwrite(VkDescriptorSet& set);
@@ -103,7 +180,84 @@ class B3DDescriptorWriter
 	private:
 
 		B3DDescriptorSetLayout& setLayout;
-		B3DDescriptorPool& pool;
+		B3DDescriptorPool* pool = nullptr;
+		B3DDescriptorAllocator* allocator = nullptr;
 		std::vector<VkWriteDescriptorSet> writes;
 
+		friend class B3DDescriptorCache;
+};
+
+//Frame-aware descriptor sets for Based 3D.
+//getSet hashes the layout and everything a writer binds, so asking for the same set again returns the one already written
+//instead of allocating and updating a new one. Sets unused for a while are freed.
+//allocateTransient hands out sets from per-frame pools that are reset wholesale when the frame's slot comes around again.
+class B3DDescriptorCache
+{
+	public:
+
+		//Cached sets nobody asked for in this many frames are freed
+		static constexpr uint64_t EVICT_AFTER_FRAMES = 240;
+
+		B3DDescriptorCache(B3DDevice& device);
+		~B3DDescriptorCache() = default;
+
+		B3DDescriptorCache(const B3DDescriptorCache&) = delete;
+		B3DDescriptorCache& operator=(const B3DDescriptorCache&) = delete;
+
+		//Call after B3DRenderer::beginFrame, the renderer has waited on the slot's last submit so its transient sets are free to go
+		void beginFrame(int frameIndex);
+
+		//Ask again each frame rather than holding on to the set, that is what keeps it from being evicted
+		VkDescriptorSet getSet(B3DDescriptorWriter& writer);
+
+		//Valid until this frame's slot comes around again
+		VkDescriptorSet allocateTransient(VkDescriptorSetLayout descriptorSetLayout);
+
+		//Call before destroying a buffer or image view that cached sets point at, a new resource could reuse the handle
+		void releaseResource(VkBuffer buffer);
+		void releaseResource(VkImageView imageView);
+
+		size_t cachedSetCount() const { return cachedSets.size(); }
+
+	private:
+
+		struct CacheKey
+		{
+			VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+			std::vector<uint64_t> bindings;
+
+			bool operator==(const CacheKey& other) const { return layout == other.layout && bindings == other.bindings; }
+		};
+
+		struct CacheKeyHash
+		{
+			size_t operator()(const CacheKey& key) const;
+		};
+
+		struct CachedSet
+		{
+			VkDescriptorSet descriptorSet;
+			uint64_t lastUsedFrame;
+			std::vector<uint64_t> resources;
+		};
+
+		//Freed once the graphics timeline passes the last frame that could have the set bound
+		struct PendingFree
+		{
+			VkDescriptorSet descriptorSet;
+			uint64_t releaseValue;
+		};
+
+		B3DDevice& cacheDevice;
+
+		B3DDescriptorAllocator persistentAllocator;
+		std::array<std::unique_ptr<B3DDescriptorAllocator>, B3DSwapChain::MAX_FRAMES_IN_FLIGHT> frameAllocators;
+		int currentFrame = 0;
+		uint64_t frameNumber = 0;
+
+		std::unordered_map<CacheKey, CachedSet, CacheKeyHash> cachedSets;
+		std::deque<PendingFree> pendingFrees;
+
+		void releaseHandle(uint64_t handle);
+		void retire(VkDescriptorSet descriptorSet);
 };
\ No newline at end of file
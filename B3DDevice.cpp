@@ -1,6 +1,8 @@
 #include "B3DDevice.h"
 
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -39,18 +41,34 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 	}
 }
 
-B3DDevice::B3DDevice(B3DWindow& window) : window{window}
+B3DDevice::B3DDevice(B3DWindow& window) : B3DDevice(&window)
 {
+}
+
+B3DDevice::B3DDevice(B3DWindow* window) : window{window}
+{
+	if (isHeadless())
+	{
+		//Nothing is presented, so the swap chain extension is neither needed nor guaranteed to exist
+		deviceExtentions.clear();
+		PLOGI << "Creating headless device";
+	}
+
 	createInstance();
 	setupDebugMessenger();
 	createSurface();
 	pickPhysicalDevice();
+	queryBindlessSupport();
 	createlogicalDevice();
 	createCommandPool();
+	createPipelineCache();
 }
 
 B3DDevice::~B3DDevice()
 {
+	savePipelineCache();
+	graphicsTimeline.reset();
+	vkDestroyPipelineCache(device_, pipelineCache, nullptr);
 	vkDestroyCommandPool(device_, commandPool, nullptr);
 	vkDestroyDevice(device_, nullptr);
 
@@ -59,7 +77,11 @@ B3DDevice::~B3DDevice()
 		DestroyDebugUtilsMessengerEXT(instance, debugMessanger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(instance, surface_, nullptr);
+	if (surface_ != VK_NULL_HANDLE)
+	{
+		vkDestroySurfaceKHR(instance, surface_, nullptr);
+	}
+
 	vkDestroyInstance(instance, nullptr);
 }
 
@@ -76,7 +98,7 @@ void B3DDevice::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(0, 1, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -122,7 +144,12 @@ void B3DDevice::setupDebugMessenger()
 	}
 }
 
-void B3DDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+void B3DDevice::createSurface()
+{
+	if (isHeadless()) return;
+
+	window->createWindowSurface(instance, &surface_);
+}
 
 void B3DDevice::pickPhysicalDevice()
 {
@@ -180,8 +207,13 @@ void B3DDevice::createlogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	bcCompressionSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -190,6 +222,32 @@ void B3DDevice::createlogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
+
+	//Timeline semaphores are core from 1.2, before that isDeviceSuitable made sure the extension is there
+	const bool timelineExtension = properties.apiVersion < VK_API_VERSION_1_2;
+	if (timelineExtension)
+	{
+		deviceExtentions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	createInfo.pNext = &timelineFeatures;
+
+	//Only the features bindless needs are switched on, the rest of the queried struct is cleared
+	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+	if (bindlessSupported)
+	{
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+		timelineFeatures.pNext = &indexingFeatures;
+	}
+
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtentions.size());
 	createInfo.ppEnabledExtensionNames = deviceExtentions.data();
 
@@ -210,6 +268,46 @@ void B3DDevice::createlogicalDevice()
 
 	vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 	vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+	graphicsTimeline = std::make_unique<B3DTimeline>(device_, graphicsQueue_, timelineExtension);
+}
+
+void B3DDevice::queryBindlessSupport()
+{
+	//The feature query itself needs Vulkan 1.1
+	if (properties.apiVersion < VK_API_VERSION_1_1) return;
+
+	const bool core = properties.apiVersion >= VK_API_VERSION_1_2;
+
+	if (!core && !isDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) return;
+
+	VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+	features.pNext = &descriptorIndexingFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	const auto& indexing = descriptorIndexingFeatures;
+	bindlessSupported = indexing.shaderSampledImageArrayNonUniformIndexing && indexing.descriptorBindingSampledImageUpdateAfterBind && indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+		indexing.descriptorBindingUpdateUnusedWhilePending && indexing.descriptorBindingPartiallyBound && indexing.runtimeDescriptorArray;
+
+	if (!bindlessSupported)
+	{
+		PLOGI << "Descriptor indexing features missing, bindless resources disabled";
+		return;
+	}
+
+	VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+	properties2.pNext = &descriptorIndexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	descriptorIndexingProperties.pNext = nullptr;
+
+	if (!core)
+	{
+		deviceExtentions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		deviceExtentions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
+
+	PLOGI << "Bindless resources enabled (" << descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindSampledImages << " sampled images, "
+		<< descriptorIndexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers << " storage buffers)";
 }
 
 void B3DDevice::createCommandPool()
@@ -227,15 +325,116 @@ void B3DDevice::createCommandPool()
 	}
 }
 
+void B3DDevice::createPipelineCache()
+{
+	std::vector<char> cacheData;
+	std::ifstream file{ PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary };
+
+	if (file.is_open())
+	{
+		cacheData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(cacheData.data(), cacheData.size());
+		file.close();
+	}
+
+	if (!cacheData.empty() && !isPipelineCacheCompatible(cacheData))
+	{
+		PLOGW << "Discarding pipeline cache built for a different device or driver";
+		cacheData.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = cacheData.size();
+	cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+	if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
+
+	pipelineCacheWarm = !cacheData.empty();
+
+	PLOGI << "Pipeline cache: " << (pipelineCacheWarm ? "loaded " + std::to_string(cacheData.size()) + " bytes" : std::string("cold"));
+}
+
+void B3DDevice::savePipelineCache()
+{
+	size_t cacheSize = 0;
+
+	if (vkGetPipelineCacheData(device_, pipelineCache, &cacheSize, nullptr) != VK_SUCCESS || cacheSize == 0)
+	{
+		PLOGW << "Failed to query pipeline cache data, cache not saved";
+		return;
+	}
+
+	std::vector<char> cacheData(cacheSize);
+
+	if (vkGetPipelineCacheData(device_, pipelineCache, &cacheSize, cacheData.data()) != VK_SUCCESS)
+	{
+		PLOGW << "Failed to read pipeline cache data, cache not saved";
+		return;
+	}
+
+	//Write next to the real file and rename over it so a crash mid-write never leaves a truncated cache behind
+	const std::string tempPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		file.write(cacheData.data(), cacheSize);
+
+		if (!file.good())
+		{
+			PLOGW << "Failed to write pipeline cache to " << tempPath;
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, error);
+
+	if (error)
+	{
+		PLOGW << "Failed to replace pipeline cache: " << error.message();
+		return;
+	}
+
+	PLOGI << "Pipeline cache saved (" << cacheSize << " bytes)";
+}
+
+bool B3DDevice::isPipelineCacheCompatible(const std::vector<char>& cacheData)
+{
+	//Header layout is fixed by the spec: length, version, vendor ID, device ID, then the cache UUID
+	uint32_t headerLength = 0;
+	uint32_t headerVersion = 0;
+	uint32_t vendorID = 0;
+	uint32_t deviceID = 0;
+	uint8_t cacheUUID[VK_UUID_SIZE];
+
+	if (cacheData.size() < 16 + VK_UUID_SIZE)
+	{
+		return false;
+	}
+
+	std::memcpy(&headerLength, cacheData.data() + 0, sizeof(uint32_t));
+	std::memcpy(&headerVersion, cacheData.data() + 4, sizeof(uint32_t));
+	std::memcpy(&vendorID, cacheData.data() + 8, sizeof(uint32_t));
+	std::memcpy(&deviceID, cacheData.data() + 12, sizeof(uint32_t));
+	std::memcpy(cacheUUID, cacheData.data() + 16, VK_UUID_SIZE);
+
+	return headerLength >= 16 + VK_UUID_SIZE && headerLength <= cacheData.size() && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && vendorID == properties.vendorID && deviceID == properties.deviceID && std::memcmp(cacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
 bool B3DDevice::isDeviceSuitable(VkPhysicalDevice device)
 {
 	QueueFamilyInices indices = findQueueFamilies(device);
 
 	bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;
+	bool swapChainAdequate = isHeadless();
 
-	if (extensionsSupported)
+	if (extensionsSupported && !isHeadless())
 	{
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -244,16 +443,38 @@ bool B3DDevice::isDeviceSuitable(VkPhysicalDevice device)
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && supportsTimelineSemaphores(device);
+}
+
+bool B3DDevice::supportsTimelineSemaphores(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	//The feature query itself needs Vulkan 1.1, and before 1.2 the extension
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_1) return false;
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_2 && !isDeviceExtensionAvailable(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES };
+	VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
 }
 
 std::vector<const char*> B3DDevice::getRequiredExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char *> extenstions;
+
+	if (!isHeadless())
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char *> extenstions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extenstions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers)
 	{
@@ -313,8 +534,16 @@ QueueFamilyInices B3DDevice::findQueueFamilies(VkPhysicalDevice device)
 			indices.graphicsFamilyHasValue = true;
 		}
 
+		//Headless devices never present, the graphics queue stands in as the present queue
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+		if (isHeadless())
+		{
+			presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+		}
 
 		if (queueFamily.queueCount > 0 && presentSupport)
 		{
@@ -333,6 +562,17 @@ QueueFamilyInices B3DDevice::findQueueFamilies(VkPhysicalDevice device)
 	return indices;
 }
 
+uint32_t B3DDevice::getGraphicsTimestampValidBits()
+{
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	return queueFamilies[findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+}
+
 void B3DDevice::populateDebugMessangerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
 {
 	createInfo = {};
@@ -382,6 +622,25 @@ void B3DDevice::hasGlfwRequiredInstanceExtensions()
 	}
 }
 
+bool B3DDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extension)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& available : availableExtensions)
+	{
+		if (std::strcmp(available.extensionName, extension) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 bool B3DDevice::checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
 	uint32_t extensionCount;
@@ -442,6 +701,22 @@ uint32_t B3DDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pr
 	throw std::runtime_error("Failed to find suitable memory type!");
 }
 
+bool B3DDevice::hasMemoryType(VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 VkFormat B3DDevice::findSupportedFormat(const std::vector<VkFormat>& canidates, VkImageTiling tiling, VkFormatFeatureFlags features)
 {
 	for (VkFormat format : canidates)
@@ -462,6 +737,15 @@ VkFormat B3DDevice::findSupportedFormat(const std::vector<VkFormat>& canidates,
 	throw std::runtime_error("Failed to find supported format!");
 }
 
+bool B3DDevice::supportsFormatFeatures(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+	VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? props.linearTilingFeatures : props.optimalTilingFeatures;
+	return (supported & features) == features;
+}
+
 void B3DDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
 {
 	VkBufferCreateInfo bufferInfo{};
@@ -519,8 +803,8 @@ void B3DDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue_);
+	//Only this submit is waited on, not whatever else the queue is still working through
+	graphicsTimeline->wait(graphicsTimeline->submit(submitInfo));
 
 	vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
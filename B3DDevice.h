@@ -2,8 +2,10 @@
 
 //Local
 #include "B3DWindow.h"
+#include "B3DTimeline.h"
 
 //STD
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,6 +41,9 @@ class B3DDevice
 		VkPhysicalDeviceProperties properties;
 
 		B3DDevice(B3DWindow& window);
+
+		//A null window creates a headless device with no surface or swap chain extensions
+		explicit B3DDevice(B3DWindow* window);
 		~B3DDevice();
 
 		B3DDevice(const B3DDevice&) = delete;
@@ -46,18 +51,30 @@ class B3DDevice
 		B3DDevice(B3DDevice&&) = delete;
 		B3DDevice &operator=(B3DDevice&&) = delete;
 
+		static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
 		VkCommandPool getCommandPool() { return commandPool; }
+		VkPipelineCache getPipelineCache() { return pipelineCache; }
+		bool isPipelineCacheWarm() const { return pipelineCacheWarm; }
 		VkDevice device() { return device_; }
 		VkSurfaceKHR surface() { return surface_; }
+		bool isHeadless() const { return window == nullptr; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
 
+		//Everything submitted to the graphics queue goes through this, so its value says how far the GPU has got
+		B3DTimeline& getGraphicsTimeline() { return *graphicsTimeline; }
+
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		bool hasMemoryType(VkMemoryPropertyFlags properties);
 		QueueFamilyInices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+		uint32_t getGraphicsTimestampValidBits();
 		VkFormat findSupportedFormat(const std::vector<VkFormat> &canidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		bool supportsFormatFeatures(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
 		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+		//Single-time commands take a value on the graphics timeline and wait for it, so they belong outside of frames
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -65,6 +82,13 @@ class B3DDevice
 
 		void createImageWidthInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
 
+		//Descriptor indexing with partially bound, update-after-bind arrays, core in 1.2 and VK_EXT_descriptor_indexing before that
+		bool supportsBindless() const { return bindlessSupported; }
+		const VkPhysicalDeviceDescriptorIndexingProperties& getDescriptorIndexingProperties() const { return descriptorIndexingProperties; }
+
+		//BC1 to BC7 sampled images, switched on whenever the device has them
+		bool supportsBCCompression() const { return bcCompressionSupported; }
+
 
 	private:
 
@@ -78,31 +102,45 @@ class B3DDevice
 		VkDebugUtilsMessengerEXT debugMessanger;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 		VkCommandPool commandPool;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		bool pipelineCacheWarm = false;
+
+		B3DWindow* window;
 
-		B3DWindow& window;
+		bool bindlessSupported = false;
+		bool bcCompressionSupported = false;
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+		VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
 
 		VkDevice device_;
-		VkSurfaceKHR surface_;
+		VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		std::unique_ptr<B3DTimeline> graphicsTimeline;
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-		const std::vector<const char*> deviceExtentions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> deviceExtentions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
 		void createInstance();
 		void setupDebugMessenger();
 		void createSurface();
 		void pickPhysicalDevice();
+		void queryBindlessSupport();
 		void createlogicalDevice();
 		void createCommandPool();
+		void createPipelineCache();
+		void savePipelineCache();
 
 		bool isDeviceSuitable(VkPhysicalDevice device);
+		bool supportsTimelineSemaphores(VkPhysicalDevice device);
+		bool isPipelineCacheCompatible(const std::vector<char>& cacheData);
 		std::vector<const char*> getRequiredExtensions();
 		bool checkValidationLayerSupport();
 		QueueFamilyInices findQueueFamilies(VkPhysicalDevice device);
 		void populateDebugMessangerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 		void hasGlfwRequiredInstanceExtensions();
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extension);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 };
 
@@ -0,0 +1,160 @@
+#include "B3DDynamicResolution.h"
+
+//Local
+#include "B3DPipeline.h"
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+//Matches the push constant block in upscale.frag
+struct UpscalePushConstants
+{
+	//Share of the target holding the scene
+	float uvScale[2];
+
+	//One texel of the target in UV
+	float texelSize[2];
+
+	float sharpness;
+};
+
+B3DDynamicResolution::B3DDynamicResolution(B3DDevice& device, B3DPipelineRegistry& pipelineRegistry, VkRenderPass upscaleRenderPass, float gpuBudget) : resolutionDevice{ device },
+	resolutionPipelineRegistry{ pipelineRegistry }, gpuBudget{ gpuBudget }
+{
+	createSampler();
+	createPipelineLayout();
+	createPipeline(upscaleRenderPass);
+
+	PLOGI << "Dynamic resolution between " << MIN_SCALE * 100.f << "% and " << MAX_SCALE * 100.f << "% for a " << gpuBudget << " ms GPU budget";
+}
+
+B3DDynamicResolution::~B3DDynamicResolution()
+{
+	vkDestroyPipelineLayout(resolutionDevice.device(), upscalePipelineLayout, nullptr);
+	vkDestroySampler(resolutionDevice.device(), sceneSampler, nullptr);
+}
+
+void B3DDynamicResolution::update(float gpuFrameTime)
+{
+	if (gpuFrameTime <= 0.f) return;
+
+	//The GPU's work grows with the pixel count, the square of the scale
+	const float wantedScale = std::clamp(renderScale * std::sqrt(gpuBudget * BUDGET_HEADROOM / gpuFrameTime), MIN_SCALE, MAX_SCALE);
+
+	if (std::abs(wantedScale - renderScale) < SCALE_DEADBAND) return;
+
+	renderScale = std::clamp(renderScale + (wantedScale - renderScale) * SCALE_GAIN, MIN_SCALE, MAX_SCALE);
+
+	B3D_PROFILE_COUNTER("Render scale %", renderScale * 100.f);
+}
+
+VkExtent2D B3DDynamicResolution::getRenderExtent(VkExtent2D targetExtent) const
+{
+	VkExtent2D extent{};
+	extent.width = std::max(1u, static_cast<uint32_t>(std::lround(targetExtent.width * renderScale)));
+	extent.height = std::max(1u, static_cast<uint32_t>(std::lround(targetExtent.height * renderScale)));
+
+	return extent;
+}
+
+void B3DDynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, B3DDescriptorCache& descriptorCache, VkImageView sceneView, VkExtent2D renderExtent, VkExtent2D targetExtent)
+{
+	//The upscale shows nothing until its pipeline compiles, the same as every other pass
+	if (!upscalePipeline.isReady()) return;
+
+	//The scene target is a transient of the render graph, so its view can change and isn't worth caching a set for
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sceneSampler;
+	imageInfo.imageView = sceneView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorSet descriptorSet = descriptorCache.allocateTransient(upscaleSetLayout->getDescriptorSetLayout());
+	B3DDescriptorWriter(*upscaleSetLayout).writeImage(0, &imageInfo).overwrite(descriptorSet);
+
+	upscalePipeline.get()->bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+	UpscalePushConstants push{};
+	push.uvScale[0] = static_cast<float>(renderExtent.width) / static_cast<float>(targetExtent.width);
+	push.uvScale[1] = static_cast<float>(renderExtent.height) / static_cast<float>(targetExtent.height);
+	push.texelSize[0] = 1.f / static_cast<float>(targetExtent.width);
+	push.texelSize[1] = 1.f / static_cast<float>(targetExtent.height);
+	push.sharpness = upscaleSharpness;
+
+	vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePushConstants), &push);
+
+	//One triangle covering the screen, generated from the vertex index
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void B3DDynamicResolution::createPipelineLayout()
+{
+	upscaleSetLayout = B3DDescriptorSetLayout::Builder(resolutionDevice).addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT).build();
+
+	VkDescriptorSetLayout descriptorSetLayout = upscaleSetLayout->getDescriptorSetLayout();
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(UpscalePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(resolutionDevice.device(), &pipelineLayoutInfo, nullptr, &upscalePipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upscale pipeline layout!");
+	}
+}
+
+void B3DDynamicResolution::createPipeline(VkRenderPass renderPass)
+{
+	assert(upscalePipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+	PipelineConfigInfo pipelineConfig{};
+
+	B3DPipeline::deafultPipelineConfigInfo(pipelineConfig);
+
+	pipelineConfig.renderPass = renderPass;
+	pipelineConfig.pipelineLayout = upscalePipelineLayout;
+
+	//No vertex buffers and no depth, every pixel of the swap chain is written once
+	pipelineConfig.bindingDescriptions.clear();
+	pipelineConfig.attributeDescriptions.clear();
+	pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+	pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+
+	upscalePipeline = resolutionPipelineRegistry.requestPipeline(B3DShaderLibrary::ShaderVariant{ "upscale.vert" }, B3DShaderLibrary::ShaderVariant{ "upscale.frag" }, pipelineConfig);
+}
+
+void B3DDynamicResolution::createSampler()
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = 0.f;
+
+	if (vkCreateSampler(resolutionDevice.device(), &samplerInfo, nullptr, &sceneSampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upscale sampler!");
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DDescriptors.h"
+#include "B3DPipelineRegistry.h"
+
+//Vulkan
+#include <vulkan/vulkan.h>
+
+//STD
+#include <memory>
+
+//Dynamic resolution for Based 3D.
+//The scene is drawn into a target the size of the swap chain, but only into its top left corner, scaled so the GPU frame time
+//stays inside a budget. Scaling only changes the viewport, so the target is never reallocated. An upscale pass then stretches
+//the corner over the swap chain with bilinear filtering and a light sharpen to win back some of the lost detail.
+class B3DDynamicResolution
+{
+	public:
+
+		static constexpr float MIN_SCALE = 0.5f;
+		static constexpr float MAX_SCALE = 1.f;
+
+		//Fraction of the gap to the wanted scale closed per frame, so one slow frame doesn't drop the resolution
+		static constexpr float SCALE_GAIN = 0.1f;
+
+		//Wanted scales closer than this to the current one are ignored, so the resolution doesn't hunt around the budget
+		static constexpr float SCALE_DEADBAND = 0.02f;
+
+		//Share of the budget aimed for, leaving room for spikes
+		static constexpr float BUDGET_HEADROOM = 0.9f;
+
+		static constexpr float DEFAULT_SHARPNESS = 0.25f;
+
+		//The upscale pass must be compatible with upscaleRenderPass, see B3DRenderGraph::getCompatibleRenderPass
+		B3DDynamicResolution(B3DDevice& device, B3DPipelineRegistry& pipelineRegistry, VkRenderPass upscaleRenderPass, float gpuBudget);
+		~B3DDynamicResolution();
+
+		B3DDynamicResolution(const B3DDynamicResolution&) = delete;
+		B3DDynamicResolution& operator=(const B3DDynamicResolution&) = delete;
+
+		//Takes the GPU time of the last frame read back in milliseconds, 0 if none was measured leaves the scale alone
+		void update(float gpuFrameTime);
+
+		float getScale() const { return renderScale; }
+		void setSharpness(float sharpness) { upscaleSharpness = sharpness; }
+
+		//The corner of a target this size the scene is drawn into this frame
+		VkExtent2D getRenderExtent(VkExtent2D targetExtent) const;
+
+		//Called from a graph pass writing the swap chain with inline contents and sampling the scene target
+		void recordUpscale(VkCommandBuffer commandBuffer, B3DDescriptorCache& descriptorCache, VkImageView sceneView, VkExtent2D renderExtent, VkExtent2D targetExtent);
+
+	private:
+
+		B3DDevice& resolutionDevice;
+		B3DPipelineRegistry& resolutionPipelineRegistry;
+
+		float gpuBudget;
+		float renderScale = MAX_SCALE;
+		float upscaleSharpness = DEFAULT_SHARPNESS;
+
+		std::unique_ptr<B3DDescriptorSetLayout> upscaleSetLayout;
+		VkPipelineLayout upscalePipelineLayout = VK_NULL_HANDLE;
+		B3DPipelineRegistry::PipelineHandle upscalePipeline;
+		VkSampler sceneSampler = VK_NULL_HANDLE;
+
+		void createPipelineLayout();
+		void createPipeline(VkRenderPass renderPass);
+		void createSampler();
+};
@@ -0,0 +1,472 @@
+#include "B3DFrameCapture.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	//Deflate stored blocks carry at most this many bytes each
+	constexpr size_t MAX_STORED_BLOCK = 65535;
+
+	struct Crc32Table
+	{
+		uint32_t values[256];
+
+		Crc32Table()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				values[i] = c;
+			}
+		}
+	};
+
+	const Crc32Table crcTable{};
+
+	uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = crcTable.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+
+		return crc;
+	}
+
+	void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> header;
+		appendBigEndian(header, static_cast<uint32_t>(data.size()));
+		header.insert(header.end(), type, type + 4);
+
+		uint32_t crc = updateCrc(0xFFFFFFFFu, header.data() + 4, 4);
+		crc = updateCrc(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+		std::vector<uint8_t> footer;
+		appendBigEndian(footer, crc);
+
+		file.write(reinterpret_cast<const char*>(header.data()), header.size());
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+	}
+
+	//Captures are for diffing rather than sharing, so the image data is stored uncompressed to keep encoding cheap
+	bool writePng(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba)
+	{
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		if (!file.is_open()) return false;
+
+		const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		std::vector<uint8_t> header;
+		appendBigEndian(header, width);
+		appendBigEndian(header, height);
+		header.insert(header.end(), { 8, 6, 0, 0, 0 });
+		writeChunk(file, "IHDR", header);
+
+		//Every row starts with a filter type byte, 0 leaves it unfiltered
+		const size_t rowSize = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> scanlines;
+		scanlines.reserve((rowSize + 1) * height);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			scanlines.push_back(0);
+			scanlines.insert(scanlines.end(), rgba.begin() + y * rowSize, rgba.begin() + (y + 1) * rowSize);
+		}
+
+		std::vector<uint8_t> zlib;
+		zlib.reserve(scanlines.size() + scanlines.size() / MAX_STORED_BLOCK * 5 + 16);
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+
+		uint32_t adlerA = 1;
+		uint32_t adlerB = 0;
+
+		for (size_t offset = 0; offset < scanlines.size() || offset == 0; offset += MAX_STORED_BLOCK)
+		{
+			const size_t blockSize = std::min(MAX_STORED_BLOCK, scanlines.size() - offset);
+			const bool lastBlock = offset + blockSize >= scanlines.size();
+
+			zlib.push_back(lastBlock ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(blockSize));
+			zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+			zlib.push_back(static_cast<uint8_t>(~blockSize));
+			zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+
+			for (size_t i = offset; i < offset + blockSize; i++)
+			{
+				adlerA = (adlerA + scanlines[i]) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+
+			if (lastBlock) break;
+		}
+
+		appendBigEndian(zlib, (adlerB << 16) | adlerA);
+		writeChunk(file, "IDAT", zlib);
+		writeChunk(file, "IEND", {});
+
+		return file.good();
+	}
+
+	bool isBgra(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	bool isSupportedFormat(VkFormat format)
+	{
+		return isBgra(format) || format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+	}
+}
+
+B3DFrameCapture::B3DFrameCapture(B3DDevice& device) : captureDevice{ device }
+{
+	//Cached memory makes the CPU reads fast, every implementation has coherent memory to fall back on
+	const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	stagingMemoryProperties = captureDevice.hasMemoryType(cached) ? cached : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	for (uint32_t i = 0; i < ENCODER_THREADS; i++)
+	{
+		encoderThreads.emplace_back(&B3DFrameCapture::encoderLoop, this, i);
+	}
+}
+
+B3DFrameCapture::~B3DFrameCapture()
+{
+	{
+		std::lock_guard<std::mutex> lock(encodeMutex);
+		stopping = true;
+	}
+	encodeCondition.notify_all();
+
+	for (auto& thread : encoderThreads)
+	{
+		thread.join();
+	}
+}
+
+void B3DFrameCapture::captureFrame(const std::string& path, Format format)
+{
+	pendingPath = path;
+	pendingFormat = format;
+}
+
+void B3DFrameCapture::startSequence(const std::string& directory, uint32_t frameCount, Format format)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	if (error)
+	{
+		PLOGW << "Failed to create capture directory " << directory << ": " << error.message();
+		return;
+	}
+
+	sequenceActive = true;
+	sequenceDirectory = directory;
+	sequenceFormat = format;
+	sequenceFrame = 0;
+	sequenceLength = frameCount;
+
+	PLOGI << "Capturing " << (frameCount == 0 ? std::string("every") : std::to_string(frameCount)) << " frames to " << directory;
+}
+
+void B3DFrameCapture::stopSequence()
+{
+	if (!sequenceActive) return;
+
+	sequenceActive = false;
+	PLOGI << "Capture sequence stopped after " << sequenceFrame << " frames, " << droppedCount << " dropped";
+}
+
+void B3DFrameCapture::beginFrame()
+{
+	B3DTimeline& timeline = captureDevice.getGraphicsTimeline();
+
+	//Copies are queued in frame order, so the oldest are always at the front
+	while (!pendingCopies.empty() && timeline.isComplete(pendingCopies.front().readyValue))
+	{
+		submitForEncoding(pendingCopies.front().staging);
+		pendingCopies.pop_front();
+	}
+}
+
+void B3DFrameCapture::recordCopy(B3DRenderer& renderer, VkCommandBuffer commandBuffer)
+{
+	if (!isCapturing()) return;
+
+	B3D_PROFILE_FUNCTION();
+
+	const VkFormat format = renderer.getSwapChainImageFormat();
+
+	if (!renderer.supportsReadback() || !isSupportedFormat(format))
+	{
+		if (!warnedUnsupported)
+		{
+			PLOGW << "Frame capture is unsupported for this swap chain, captures are skipped";
+			warnedUnsupported = true;
+		}
+
+		pendingPath.clear();
+		stopSequence();
+		return;
+	}
+
+	const VkExtent2D extent = renderer.getSwapChainExtent();
+	const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	//A one-off capture takes priority over the frame's sequence entry
+	std::string path;
+	Format fileFormat;
+
+	if (!pendingPath.empty())
+	{
+		path = std::move(pendingPath);
+		fileFormat = pendingFormat;
+		pendingPath.clear();
+	}
+	else
+	{
+		char name[64];
+		if (sequenceFormat == Format::PNG)
+		{
+			std::snprintf(name, sizeof(name), "frame_%06u.png", sequenceFrame);
+		}
+		else
+		{
+			std::snprintf(name, sizeof(name), "frame_%06u_%ux%u.raw", sequenceFrame, extent.width, extent.height);
+		}
+		path = (std::filesystem::path{ sequenceDirectory } / name).string();
+		fileFormat = sequenceFormat;
+
+		if (++sequenceFrame == sequenceLength)
+		{
+			stopSequence();
+		}
+	}
+
+	StagingBuffer* staging = acquireStagingBuffer(size);
+
+	if (!staging)
+	{
+		if (droppedCount++ % 60 == 0)
+		{
+			PLOGW << "Frame capture can't keep up, " << droppedCount << " frames dropped so far";
+		}
+		return;
+	}
+
+	staging->extent = extent;
+	staging->format = format;
+	staging->fileFormat = fileFormat;
+	staging->path = std::move(path);
+
+	const VkImage image = renderer.getCurrentSwapChainImage();
+	const VkImageLayout finalLayout = renderer.getSwapChainFinalLayout();
+
+	VkImageMemoryBarrier toTransfer{};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toTransfer.oldLayout = finalLayout;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = image;
+	toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging->buffer->getBuffer(), 1, &region);
+
+	//Back to whatever present expects, and make the copy visible to the host once the frame's timeline value signals
+	VkImageMemoryBarrier toFinal = toTransfer;
+	toFinal.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toFinal.dstAccessMask = 0;
+	toFinal.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toFinal.newLayout = finalLayout;
+
+	VkBufferMemoryBarrier toHost{};
+	toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.buffer = staging->buffer->getBuffer();
+	toHost.offset = 0;
+	toHost.size = VK_WHOLE_SIZE;
+
+	const uint32_t imageBarrierCount = finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 0 : 1;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &toHost, imageBarrierCount, &toFinal);
+
+	pendingCopies.push_back({ staging, captureDevice.getGraphicsTimeline().getFrameValue() });
+}
+
+void B3DFrameCapture::flush()
+{
+	for (const PendingCopy& pending : pendingCopies)
+	{
+		submitForEncoding(pending.staging);
+	}
+
+	pendingCopies.clear();
+
+	std::unique_lock<std::mutex> lock(encodeMutex);
+	idleCondition.wait(lock, [this]() { return encodeQueue.empty() && activeEncodes == 0; });
+}
+
+B3DFrameCapture::StagingBuffer* B3DFrameCapture::acquireStagingBuffer(VkDeviceSize size)
+{
+	StagingBuffer* resizable = nullptr;
+
+	for (auto& staging : stagingBuffers)
+	{
+		if (staging->busy.load(std::memory_order_acquire)) continue;
+
+		if (staging->size >= size)
+		{
+			staging->busy.store(true, std::memory_order_relaxed);
+			return staging.get();
+		}
+
+		resizable = staging.get();
+	}
+
+	//Buffers only grow, so after a resize the old small ones get replaced as they come free
+	if (!resizable && stagingBuffers.size() < MAX_STAGING_BUFFERS)
+	{
+		stagingBuffers.push_back(std::make_unique<StagingBuffer>());
+		resizable = stagingBuffers.back().get();
+	}
+
+	if (!resizable) return nullptr;
+
+	resizable->buffer = std::make_unique<B3DBuffer>(captureDevice, size, 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT, stagingMemoryProperties);
+	resizable->buffer->map();
+	resizable->size = size;
+	resizable->busy.store(true, std::memory_order_relaxed);
+
+	return resizable;
+}
+
+void B3DFrameCapture::submitForEncoding(StagingBuffer* staging)
+{
+	{
+		std::lock_guard<std::mutex> lock(encodeMutex);
+		encodeQueue.push_back(staging);
+	}
+
+	encodeCondition.notify_one();
+}
+
+void B3DFrameCapture::encoderLoop(uint32_t threadIndex)
+{
+	B3DProfiler::setThreadName("Capture encoder " + std::to_string(threadIndex));
+
+	while (true)
+	{
+		StagingBuffer* staging;
+
+		{
+			std::unique_lock<std::mutex> lock(encodeMutex);
+			encodeCondition.wait(lock, [this]() { return stopping || !encodeQueue.empty(); });
+
+			//Whatever is still queued at shutdown is finished first
+			if (encodeQueue.empty()) return;
+
+			staging = encodeQueue.front();
+			encodeQueue.pop_front();
+			activeEncodes++;
+		}
+
+		try
+		{
+			encode(*staging);
+		}
+		catch (const std::exception& e)
+		{
+			PLOGE << "Failed to encode frame capture " << staging->path << ": " << e.what();
+		}
+
+		staging->busy.store(false, std::memory_order_release);
+
+		{
+			std::lock_guard<std::mutex> lock(encodeMutex);
+			activeEncodes--;
+		}
+		idleCondition.notify_all();
+	}
+}
+
+void B3DFrameCapture::encode(StagingBuffer& staging)
+{
+	B3D_PROFILE_SCOPE("Encode frame capture");
+
+	if (!(stagingMemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		staging.buffer->invalidate();
+	}
+
+	const size_t byteCount = static_cast<size_t>(staging.extent.width) * staging.extent.height * 4;
+	const uint8_t* source = static_cast<const uint8_t*>(staging.buffer->getMappedMemory());
+
+	//Both formats are written as RGBA8, raw files have no header
+	std::vector<uint8_t> rgba(source, source + byteCount);
+
+	if (isBgra(staging.format))
+	{
+		for (size_t i = 0; i < byteCount; i += 4)
+		{
+			std::swap(rgba[i], rgba[i + 2]);
+		}
+	}
+
+	bool written;
+
+	if (staging.fileFormat == Format::PNG)
+	{
+		written = writePng(staging.path, staging.extent.width, staging.extent.height, rgba);
+	}
+	else
+	{
+		std::ofstream file{ staging.path, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+		written = file.good();
+	}
+
+	if (!written)
+	{
+		PLOGW << "Failed to write frame capture " << staging.path;
+	}
+}
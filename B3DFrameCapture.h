@@ -0,0 +1,116 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DBuffer.h"
+#include "B3DRenderer.h"
+#include "B3DSwapChain.h"
+
+//STD
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Asynchronous frame readback for Based 3D.
+//The finished image is copied into a host-visible staging buffer at the end of the frame. The buffer is picked up once the graphics timeline
+//has passed the frame's value, and is encoded to disk on background threads. The render loop never waits on the GPU.
+class B3DFrameCapture
+{
+	public:
+
+		//Captures beyond what the staging ring can hold are dropped rather than stalling the frame
+		static constexpr uint32_t MAX_STAGING_BUFFERS = 8;
+		static constexpr uint32_t ENCODER_THREADS = 2;
+
+		enum class Format
+		{
+			PNG,
+			RAW,
+		};
+
+		B3DFrameCapture(B3DDevice& device);
+		~B3DFrameCapture();
+
+		B3DFrameCapture(const B3DFrameCapture&) = delete;
+		B3DFrameCapture& operator=(const B3DFrameCapture&) = delete;
+
+		void captureFrame(const std::string& path, Format format = Format::PNG);
+
+		//Writes every frame to directory/frame_000000.png and up (raw names carry the size), a frameCount of 0 keeps going until stopped
+		void startSequence(const std::string& directory, uint32_t frameCount = 0, Format format = Format::PNG);
+		void stopSequence();
+
+		bool isCapturing() const { return !pendingPath.empty() || sequenceActive; }
+		uint32_t getDroppedCount() const { return droppedCount; }
+
+		//Call once per frame, hands the copies the GPU has finished to the encoders
+		void beginFrame();
+
+		//Call after the last render pass of the frame and before B3DRenderer::endFrame
+		void recordCopy(B3DRenderer& renderer, VkCommandBuffer commandBuffer);
+
+		//Requires the device to be idle, encodes everything still pending and waits for it to reach disk
+		void flush();
+
+	private:
+
+		struct StagingBuffer
+		{
+			std::unique_ptr<B3DBuffer> buffer;
+			VkDeviceSize size = 0;
+
+			//Set while the GPU copy or the encode is outstanding
+			std::atomic<bool> busy{ false };
+
+			VkExtent2D extent{};
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			Format fileFormat = Format::PNG;
+			std::string path;
+		};
+
+		B3DDevice& captureDevice;
+		VkMemoryPropertyFlags stagingMemoryProperties;
+
+		//A copy is ready once the graphics timeline reaches the value of the frame that recorded it
+		struct PendingCopy
+		{
+			StagingBuffer* staging;
+			uint64_t readyValue;
+		};
+
+		std::vector<std::unique_ptr<StagingBuffer>> stagingBuffers;
+		std::deque<PendingCopy> pendingCopies;
+
+		std::string pendingPath;
+		Format pendingFormat = Format::PNG;
+
+		bool sequenceActive = false;
+		std::string sequenceDirectory;
+		Format sequenceFormat = Format::PNG;
+		uint32_t sequenceFrame = 0;
+		uint32_t sequenceLength = 0;
+
+		uint32_t droppedCount = 0;
+		bool warnedUnsupported = false;
+
+		//Encoding runs on its own threads rather than the job system, whose waits would pull it onto the render thread
+		std::vector<std::thread> encoderThreads;
+		std::mutex encodeMutex;
+		std::condition_variable encodeCondition;
+		std::condition_variable idleCondition;
+		std::deque<StagingBuffer*> encodeQueue;
+		uint32_t activeEncodes = 0;
+		bool stopping = false;
+
+		StagingBuffer* acquireStagingBuffer(VkDeviceSize size);
+		void submitForEncoding(StagingBuffer* staging);
+		void encoderLoop(uint32_t threadIndex);
+		void encode(StagingBuffer& staging);
+};
@@ -2,6 +2,9 @@
 
 //Local
 #include "B3DCamera.h"
+#include "B3DSceneGraph.h"
+#include "B3DGpuProfiler.h"
+#include "B3DDescriptors.h"
 
 //Vulkan
 #include <vulkan/vulkan.h>
@@ -14,4 +17,10 @@ struct FrameInfo
 	VkCommandBuffer commandBuffer;
 	B3DCamera& camera;
 	VkDescriptorSet globalDescriptorSet;
+	B3DSceneGraph& sceneGraph;
+	B3DGpuProfiler& gpuProfiler;
+	B3DDescriptorCache& descriptorCache;
+
+	//The corner of the scene targets drawn into, smaller than the swap chain under dynamic resolution
+	VkExtent2D renderExtent;
 };
\ No newline at end of file
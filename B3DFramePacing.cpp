@@ -0,0 +1,126 @@
+#include "B3DFramePacing.h"
+
+//STD
+#include <algorithm>
+#include <thread>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	//OS sleeps overshoot by up to a scheduler tick, so the last stretch of the wait is spun instead
+	constexpr std::chrono::microseconds SPIN_THRESHOLD{ 2000 };
+
+	float millisecondsBetween(B3DFramePacer::clock::time_point begin, B3DFramePacer::clock::time_point end)
+	{
+		return std::chrono::duration<float, std::chrono::milliseconds::period>(end - begin).count();
+	}
+}
+
+void B3DFramePacer::setPolicy(const FramePacingPolicy& newPolicy)
+{
+	policy = newPolicy;
+
+	//Numbers from different settings must not blend into one average
+	samples.clear();
+	framesSinceReport = 0;
+	inputPending = false;
+	limiterStarted = false;
+}
+
+void B3DFramePacer::limitFrameRate()
+{
+	if (policy.frameRateLimit <= 0.f) return;
+
+	const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / policy.frameRateLimit));
+
+	if (limiterStarted)
+	{
+		std::this_thread::sleep_until(nextFrameStart - SPIN_THRESHOLD);
+
+		while (clock::now() < nextFrameStart)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	auto now = clock::now();
+
+	//A frame that ran long restarts the schedule instead of letting the next ones rush to catch up
+	nextFrameStart = limiterStarted && now - nextFrameStart < period ? nextFrameStart + period : now + period;
+	limiterStarted = true;
+}
+
+void B3DFramePacer::markInputSampled()
+{
+	inputSampleTime = clock::now();
+	inputPending = true;
+}
+
+void B3DFramePacer::markSubmitted()
+{
+	submitTime = clock::now();
+}
+
+void B3DFramePacer::markPresented()
+{
+	//Frames dropped for a swap chain rebuild never present, their input is resampled next loop
+	if (!inputPending) return;
+
+	auto presentTime = clock::now();
+	inputPending = false;
+
+	samples.push_back(LatencySample{ millisecondsBetween(inputSampleTime, submitTime), millisecondsBetween(inputSampleTime, presentTime) });
+
+	if (samples.size() > LATENCY_WINDOW)
+	{
+		samples.pop_front();
+	}
+
+	if (++framesSinceReport >= LATENCY_REPORT_INTERVAL)
+	{
+		framesSinceReport = 0;
+		reportLatency();
+	}
+}
+
+B3DFramePacer::LatencyStats B3DFramePacer::getLatencyStats() const
+{
+	LatencyStats stats{};
+	stats.sampleCount = samples.size();
+
+	if (samples.empty()) return stats;
+
+	for (const auto& sample : samples)
+	{
+		stats.averageInputToSubmit += sample.inputToSubmit;
+		stats.averageInputToPresent += sample.inputToPresent;
+		stats.worstInputToPresent = std::max(stats.worstInputToPresent, sample.inputToPresent);
+	}
+
+	stats.averageInputToSubmit /= static_cast<float>(samples.size());
+	stats.averageInputToPresent /= static_cast<float>(samples.size());
+
+	return stats;
+}
+
+const char* B3DFramePacer::presentModeName(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "Mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "V-Sync";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "V-Sync relaxed";
+		default: return "Unknown";
+	}
+}
+
+void B3DFramePacer::reportLatency() const
+{
+	LatencyStats stats = getLatencyStats();
+
+	PLOGI << "Latency (" << policy.framesInFlight << " frames in flight, " << presentModeName(presentMode) << ", limit " << policy.frameRateLimit << " fps): input to submit "
+		<< stats.averageInputToSubmit << " ms, input to present " << stats.averageInputToPresent << " ms avg / " << stats.worstInputToPresent << " ms worst";
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+//Vulkan
+#include <vulkan/vulkan.h>
+
+//STD
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+//How frames are paced, chosen per deployment to trade throughput against latency
+struct FramePacingPolicy
+{
+	//1 gives the lowest latency, more lets the CPU run further ahead of the GPU. Capped at B3DSwapChain::MAX_FRAMES_IN_FLIGHT
+	uint32_t framesInFlight = 2;
+
+	//The first mode the surface supports wins, FIFO is always supported and used if none match
+	std::vector<VkPresentModeKHR> presentModes{ VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+
+	//Frames per second the CPU is held to, 0 leaves it uncapped
+	float frameRateLimit = 0.f;
+};
+
+//Frame limiter and input latency tracker for Based 3D.
+//Latency runs from the moment input is sampled to the frame's queue submit and to its present call returning.
+class B3DFramePacer
+{
+	public:
+
+		using clock = std::chrono::steady_clock;
+
+		static constexpr size_t LATENCY_WINDOW = 240;
+		static constexpr uint32_t LATENCY_REPORT_INTERVAL = 1000;
+
+		struct LatencyStats
+		{
+			float averageInputToSubmit = 0.f;
+			float averageInputToPresent = 0.f;
+			float worstInputToPresent = 0.f;
+			size_t sampleCount = 0;
+		};
+
+		B3DFramePacer() = default;
+		~B3DFramePacer() = default;
+
+		B3DFramePacer(const B3DFramePacer&) = delete;
+		B3DFramePacer& operator=(const B3DFramePacer&) = delete;
+
+		void setPolicy(const FramePacingPolicy& newPolicy);
+		const FramePacingPolicy& getPolicy() const { return policy; }
+		void setPresentMode(VkPresentModeKHR mode) { presentMode = mode; }
+
+		//Sleeps off what is left of the frame budget, call it right before sampling input so the wait doesn't add latency
+		void limitFrameRate();
+
+		void markInputSampled();
+		void markSubmitted();
+		void markPresented();
+
+		LatencyStats getLatencyStats() const;
+
+		static const char* presentModeName(VkPresentModeKHR mode);
+
+	private:
+
+		struct LatencySample
+		{
+			float inputToSubmit;
+			float inputToPresent;
+		};
+
+		FramePacingPolicy policy{};
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+		clock::time_point nextFrameStart{};
+		bool limiterStarted = false;
+
+		clock::time_point inputSampleTime{};
+		clock::time_point submitTime{};
+		bool inputPending = false;
+
+		std::deque<LatencySample> samples;
+		uint32_t framesSinceReport = 0;
+
+		void reportLatency() const;
+};
@@ -2,23 +2,11 @@
 
 //local
 #include "B3DModel.h"
+#include "B3DSceneGraph.h"
 
 //std
 #include <memory>
 
-//GLM
-#include <glm/gtc/matrix_transform.hpp>
-
-struct TransformComponent
-{
-	glm::vec3 translation{};
-	glm::vec3 scale{1.f, 1.f, 1.f};
-	glm::vec3 rotation{};
-
-	glm::mat4 mat4();
-	glm::mat3 normalMatrix();
-};
-
 class B3DGameObj
 {
 	public:
@@ -26,8 +14,13 @@ class B3DGameObj
 		using id_t = unsigned int;
 
 		std::shared_ptr<B3DModel> model{};
-		glm::vec3 color{};
+		glm::vec3 color{ 1.f, 1.f, 1.f };
+		uint32_t materialId = 0;
 		TransformComponent transform{};
+		B3DSceneGraph::node_t sceneNode = B3DSceneGraph::INVALID_NODE;
+
+		//Never moves, so its shadows are drawn once into the shadow cache instead of every frame
+		bool isStatic = false;
 
 		static B3DGameObj createGameObject()
 		{
@@ -0,0 +1,199 @@
+#include "B3DGpuProfiler.h"
+
+//STD
+#include <algorithm>
+#include <stdexcept>
+
+B3DGpuProfiler::B3DGpuProfiler(B3DDevice& device) : profilerDevice{ device }
+{
+	const uint32_t validBits = profilerDevice.getGraphicsTimestampValidBits();
+
+	if (validBits == 0)
+	{
+		PLOGW << "Graphics queue doesn't support timestamps, GPU profiling disabled";
+		return;
+	}
+
+	timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t{ 1 } << validBits) - 1;
+	timestampPeriod = profilerDevice.properties.limits.timestampPeriod;
+
+	for (auto& frame : frames)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = MAX_ZONES_PER_FRAME * 2;
+
+		if (vkCreateQueryPool(profilerDevice.device(), &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+	}
+
+	PLOGI << "GPU profiler enabled (" << validBits << " valid timestamp bits, " << timestampPeriod << " ns per tick)";
+}
+
+B3DGpuProfiler::~B3DGpuProfiler()
+{
+	for (auto& frame : frames)
+	{
+		if (frame.queryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(profilerDevice.device(), frame.queryPool, nullptr);
+		}
+	}
+}
+
+void B3DGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+{
+	if (!isSupported()) return;
+
+	FrameQueries& frame = frames[frameIndex];
+
+	//The renderer has already waited on this slot's last submit, so whatever it recorded last time has landed
+	if (frame.hasResults)
+	{
+		collectResults(frame);
+	}
+
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_ZONES_PER_FRAME * 2);
+
+	frame.zoneCount.store(0, std::memory_order_relaxed);
+	frame.hasResults = true;
+	currentFrame = frameIndex;
+
+	if (++framesSinceReport >= REPORT_INTERVAL)
+	{
+		framesSinceReport = 0;
+		logReport();
+	}
+}
+
+uint32_t B3DGpuProfiler::beginZone(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (!isSupported() || currentFrame < 0) return INVALID_ZONE;
+
+	FrameQueries& frame = frames[currentFrame];
+	uint32_t zone = frame.zoneCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (zone >= MAX_ZONES_PER_FRAME) return INVALID_ZONE;
+
+	frame.zoneNames[zone] = name;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, zone * 2);
+
+	return zone;
+}
+
+void B3DGpuProfiler::endZone(VkCommandBuffer commandBuffer, uint32_t zone)
+{
+	if (zone == INVALID_ZONE) return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[currentFrame].queryPool, zone * 2 + 1);
+}
+
+void B3DGpuProfiler::collectResults(FrameQueries& frame)
+{
+	const uint32_t zoneCount = std::min(frame.zoneCount.load(std::memory_order_relaxed), MAX_ZONES_PER_FRAME);
+
+	if (zoneCount == 0) return;
+
+	//Pairs of value and availability, a zone whose queries aren't both available yet is dropped rather than waited on
+	std::vector<uint64_t> results(static_cast<size_t>(zoneCount) * 4);
+
+	VkResult result = vkGetQueryPoolResults(profilerDevice.device(), frame.queryPool, 0, zoneCount * 2, results.size() * sizeof(uint64_t), results.data(),
+		sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if (result != VK_SUCCESS && result != VK_NOT_READY) return;
+
+	//Zones that repeat in a frame, like one per recording thread, are summed into a single sample
+	std::map<std::string, float> frameTimes;
+
+	//Offsets from the first available zone, signed so zones that started before it and a counter that wrapped both work out
+	uint64_t reference = 0;
+	int64_t frameBegin = 0;
+	int64_t frameEnd = 0;
+	bool frameStarted = false;
+
+	auto offsetFrom = [this](uint64_t timestamp, uint64_t origin)
+	{
+		const uint64_t ticks = (timestamp - origin) & timestampMask;
+		return ticks > timestampMask / 2 ? static_cast<int64_t>(ticks) - static_cast<int64_t>(timestampMask) - 1 : static_cast<int64_t>(ticks);
+	};
+
+	for (uint32_t zone = 0; zone < zoneCount; zone++)
+	{
+		const uint64_t* queries = &results[static_cast<size_t>(zone) * 4];
+
+		if (queries[1] == 0 || queries[3] == 0) continue;
+
+		uint64_t ticks = (queries[2] - queries[0]) & timestampMask;
+		frameTimes[frame.zoneNames[zone]] += static_cast<float>(ticks) * timestampPeriod / 1000000.f;
+
+		if (!frameStarted)
+		{
+			reference = queries[0];
+			frameStarted = true;
+		}
+
+		frameBegin = std::min(frameBegin, offsetFrom(queries[0], reference));
+		frameEnd = std::max(frameEnd, offsetFrom(queries[2], reference));
+	}
+
+	if (frameStarted)
+	{
+		lastFrameTime.store(static_cast<float>(frameEnd - frameBegin) * timestampPeriod / 1000000.f, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+
+	for (const auto& [name, milliseconds] : frameTimes)
+	{
+		auto& samples = zoneSamples[name];
+		samples.push_back(milliseconds);
+
+		if (samples.size() > STATS_WINDOW)
+		{
+			samples.pop_front();
+		}
+	}
+}
+
+std::vector<B3DGpuProfiler::ZoneStats> B3DGpuProfiler::getZoneStats() const
+{
+	std::vector<ZoneStats> allStats;
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+
+	for (const auto& [name, samples] : zoneSamples)
+	{
+		if (samples.empty()) continue;
+
+		std::vector<float> sorted(samples.begin(), samples.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		ZoneStats stats{};
+		stats.name = name;
+		stats.sampleCount = sorted.size();
+		stats.p50 = sorted[sorted.size() / 2];
+		stats.p95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+		stats.max = sorted.back();
+
+		for (float sample : sorted)
+		{
+			stats.average += sample;
+		}
+		stats.average /= static_cast<float>(sorted.size());
+
+		allStats.push_back(std::move(stats));
+	}
+
+	return allStats;
+}
+
+void B3DGpuProfiler::logReport() const
+{
+	for (const auto& stats : getZoneStats())
+	{
+		PLOGI << "GPU zone " << stats.name << ": avg " << stats.average << " ms, p50 " << stats.p50 << " ms, p95 " << stats.p95 << " ms, max " << stats.max << " ms";
+	}
+}
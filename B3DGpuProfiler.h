@@ -0,0 +1,103 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DSwapChain.h"
+
+//STD
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//GPU timestamp profiler for Based 3D.
+//Each frame in flight owns a query pool. A slot's results are read back the next time the slot comes around,
+//after its last submit has been waited on, so collecting them never stalls the CPU.
+class B3DGpuProfiler
+{
+	public:
+
+		static constexpr uint32_t MAX_ZONES_PER_FRAME = 128;
+		static constexpr uint32_t INVALID_ZONE = std::numeric_limits<uint32_t>::max();
+		static constexpr size_t STATS_WINDOW = 256;
+		static constexpr uint32_t REPORT_INTERVAL = 1000;
+
+		struct ZoneStats
+		{
+			std::string name;
+			float average = 0.f;
+			float p50 = 0.f;
+			float p95 = 0.f;
+			float max = 0.f;
+			size_t sampleCount = 0;
+		};
+
+		//Times everything recorded into the command buffer while it is alive
+		class Scope
+		{
+			public:
+
+				Scope(B3DGpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name) : profiler{ profiler }, commandBuffer{ commandBuffer }, zone{ profiler.beginZone(commandBuffer, name) } {}
+				~Scope() { profiler.endZone(commandBuffer, zone); }
+
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+
+			private:
+
+				B3DGpuProfiler& profiler;
+				VkCommandBuffer commandBuffer;
+				uint32_t zone;
+		};
+
+		B3DGpuProfiler(B3DDevice& device);
+		~B3DGpuProfiler();
+
+		B3DGpuProfiler(const B3DGpuProfiler&) = delete;
+		B3DGpuProfiler& operator=(const B3DGpuProfiler&) = delete;
+
+		bool isSupported() const { return timestampMask != 0; }
+
+		//Call after B3DRenderer::beginFrame and outside any render pass
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+		//Safe to call from recording threads, names must outlive the profiler
+		uint32_t beginZone(VkCommandBuffer commandBuffer, const char* name);
+		void endZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+		std::vector<ZoneStats> getZoneStats() const;
+
+		//Milliseconds from the first zone starting to the last one ending in the most recent frame read back, 0 before any
+		float getLastFrameTime() const { return lastFrameTime.load(std::memory_order_relaxed); }
+		void logReport() const;
+
+	private:
+
+		struct FrameQueries
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			std::atomic<uint32_t> zoneCount{ 0 };
+			std::array<const char*, MAX_ZONES_PER_FRAME> zoneNames{};
+			bool hasResults = false;
+		};
+
+		B3DDevice& profilerDevice;
+
+		float timestampPeriod = 1.f;
+		uint64_t timestampMask = 0;
+
+		std::array<FrameQueries, B3DSwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+		int currentFrame = -1;
+		uint32_t framesSinceReport = 0;
+		std::atomic<float> lastFrameTime{ 0.f };
+
+		mutable std::mutex statsMutex;
+		std::map<std::string, std::deque<float>> zoneSamples;
+
+		void collectResults(FrameQueries& frame);
+};
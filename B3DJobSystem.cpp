@@ -0,0 +1,282 @@
+#include "B3DJobSystem.h"
+
+//Plog
+#include <plog/Log.h>
+
+thread_local uint32_t B3DJobSystem::threadIndex = B3DJobSystem::INVALID_THREAD_INDEX;
+
+B3DJobSystem::B3DJobSystem(uint32_t workerCount) : B3DJobSystem(workerCount, ProfilerHooks{})
+{
+}
+
+B3DJobSystem::B3DJobSystem(uint32_t workerCount, const ProfilerHooks& hooks) : profilerHooks{hooks}
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	//The constructing thread is the main thread and owns queue 0, it helps out whenever it waits
+	threadIndex = MAIN_THREAD_INDEX;
+
+	queues.resize(workerCount + 1);
+	for (auto& queue : queues)
+	{
+		queue = std::make_unique<WorkQueue>();
+	}
+
+	for (uint32_t i = 1; i <= workerCount; i++)
+	{
+		workers.emplace_back(&B3DJobSystem::workerLoop, this, i);
+	}
+
+	PLOGI << "Job system started with " << workerCount << " worker threads";
+}
+
+B3DJobSystem::~B3DJobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	sleepCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+B3DJobSystem::JobHandle B3DJobSystem::run(Job job, const char* name, JobHandle counter)
+{
+	if (!counter)
+	{
+		counter = createCounter();
+	}
+
+	counter->pending.fetch_add(1, std::memory_order_relaxed);
+	push(Task{ std::move(job), counter, name });
+
+	return counter;
+}
+
+B3DJobSystem::JobHandle B3DJobSystem::runAfter(const JobHandle& dependency, Job job, const char* name)
+{
+	JobHandle counter = createCounter();
+	counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	Task task{ std::move(job), counter, name };
+
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+
+		if (dependency->pending.load(std::memory_order_acquire) > 0)
+		{
+			auto sharedTask = std::make_shared<Task>(std::move(task));
+			dependency->continuations.push_back([this, sharedTask]() { push(std::move(*sharedTask)); });
+			return counter;
+		}
+	}
+
+	push(std::move(task));
+	return counter;
+}
+
+B3DJobSystem::JobHandle B3DJobSystem::runOnMainThread(Job job, const char* name)
+{
+	JobHandle counter = createCounter();
+	counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+	mainThreadQueue.tasks.push_back(Task{ std::move(job), counter, name });
+
+	return counter;
+}
+
+void B3DJobSystem::wait(const JobHandle& counter)
+{
+	const uint32_t index = threadIndex;
+
+	while (!isDone(counter))
+	{
+		Task task;
+
+		if (index == MAIN_THREAD_INDEX && popMainThreadTask(task))
+		{
+			execute(task);
+		}
+		else if (index != INVALID_THREAD_INDEX ? pop(index, task) || steal(index, task) : steal(0, task))
+		{
+			execute(task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	//Jobs run on other threads, so their failures are handed back to whoever waits on them
+	if (counter && counter->exception)
+	{
+		std::rethrow_exception(counter->exception);
+	}
+}
+
+void B3DJobSystem::runMainThreadJobs()
+{
+	if (!isMainThread())
+	{
+		throw std::runtime_error("Main thread jobs can only be run from the main thread!");
+	}
+
+	Task task;
+	while (popMainThreadTask(task))
+	{
+		execute(task);
+	}
+}
+
+void B3DJobSystem::workerLoop(uint32_t index)
+{
+	threadIndex = index;
+
+	if (profilerHooks.threadStarted)
+	{
+		profilerHooks.threadStarted(index);
+	}
+
+	while (true)
+	{
+		Task task;
+
+		if (pop(index, task) || steal(index, task))
+		{
+			execute(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+
+		if (!running && queuedTasks.load() == 0)
+		{
+			break;
+		}
+
+		sleepCondition.wait(lock, [this]() { return !running || queuedTasks.load() > 0; });
+	}
+}
+
+void B3DJobSystem::push(Task task)
+{
+	uint32_t index = threadIndex;
+
+	//Threads outside the pool spread their work round robin, pool threads keep it local for cache reuse
+	if (index == INVALID_THREAD_INDEX || index >= queues.size())
+	{
+		index = nextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(queues.size());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedTasks.fetch_add(1);
+	}
+	sleepCondition.notify_one();
+}
+
+bool B3DJobSystem::pop(uint32_t index, Task& task)
+{
+	auto& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.tasks.empty()) return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	queuedTasks.fetch_sub(1);
+
+	return true;
+}
+
+bool B3DJobSystem::steal(uint32_t thief, Task& task)
+{
+	const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+
+	for (uint32_t offset = 1; offset <= queueCount; offset++)
+	{
+		auto& queue = *queues[(thief + offset) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.tasks.empty()) continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		queuedTasks.fetch_sub(1);
+
+		return true;
+	}
+
+	return false;
+}
+
+bool B3DJobSystem::popMainThreadTask(Task& task)
+{
+	std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+
+	if (mainThreadQueue.tasks.empty()) return false;
+
+	task = std::move(mainThreadQueue.tasks.front());
+	mainThreadQueue.tasks.pop_front();
+
+	return true;
+}
+
+void B3DJobSystem::execute(Task& task)
+{
+	if (profilerHooks.beginZone)
+	{
+		profilerHooks.beginZone(task.name);
+	}
+
+	try
+	{
+		task.job();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(task.counter->continuationMutex);
+
+		if (!task.counter->exception)
+		{
+			task.counter->exception = std::current_exception();
+		}
+	}
+
+	if (profilerHooks.endZone)
+	{
+		profilerHooks.endZone();
+	}
+
+	complete(task.counter);
+}
+
+void B3DJobSystem::complete(const JobHandle& counter)
+{
+	if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->continuationMutex);
+		continuations.swap(counter->continuations);
+	}
+
+	for (auto& continuation : continuations)
+	{
+		continuation();
+	}
+}
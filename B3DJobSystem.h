@@ -0,0 +1,141 @@
+#pragma once
+
+//STD
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+//Work-stealing job system for Based 3D.
+//Each thread owns a deque, pushes and pops its own work from the back and steals from the front of the others.
+class B3DJobSystem
+{
+	public:
+
+		using Job = std::function<void()>;
+
+		struct JobCounter
+		{
+			std::atomic<uint32_t> pending{ 0 };
+			std::mutex continuationMutex;
+			std::vector<std::function<void()>> continuations;
+			std::exception_ptr exception;
+		};
+
+		using JobHandle = std::shared_ptr<JobCounter>;
+
+		struct ProfilerHooks
+		{
+			void (*beginZone)(const char* name) = nullptr;
+			void (*endZone)() = nullptr;
+			void (*threadStarted)(uint32_t threadIndex) = nullptr;
+		};
+
+		static constexpr uint32_t MAIN_THREAD_INDEX = 0;
+		static constexpr uint32_t INVALID_THREAD_INDEX = std::numeric_limits<uint32_t>::max();
+
+		explicit B3DJobSystem(uint32_t workerCount = 0);
+		B3DJobSystem(uint32_t workerCount, const ProfilerHooks& hooks);
+		~B3DJobSystem();
+
+		B3DJobSystem(const B3DJobSystem&) = delete;
+		B3DJobSystem& operator=(const B3DJobSystem&) = delete;
+
+		JobHandle createCounter() const { return std::make_shared<JobCounter>(); }
+
+		JobHandle run(Job job, const char* name = "Job", JobHandle counter = nullptr);
+		JobHandle runAfter(const JobHandle& dependency, Job job, const char* name = "Job");
+		JobHandle runOnMainThread(Job job, const char* name = "Main thread job");
+
+		void wait(const JobHandle& counter);
+		bool isDone(const JobHandle& counter) const { return !counter || counter->pending.load(std::memory_order_acquire) == 0; }
+
+		void runMainThreadJobs();
+
+		//Splits [begin, end) into chunks of grainSize (0 picks one from the thread count) and calls func(chunkBegin, chunkEnd) for each
+		template<typename Func>
+		JobHandle parallelForAsync(size_t begin, size_t end, size_t grainSize, Func func, const char* name = "Parallel for");
+
+		template<typename Func>
+		void parallelFor(size_t begin, size_t end, size_t grainSize, Func&& func, const char* name = "Parallel for");
+
+		uint32_t threadCount() const { return static_cast<uint32_t>(queues.size()); }
+		static uint32_t currentThreadIndex() { return threadIndex; }
+		bool isMainThread() const { return threadIndex == MAIN_THREAD_INDEX; }
+
+	private:
+
+		struct Task
+		{
+			Job job;
+			JobHandle counter;
+			const char* name = nullptr;
+		};
+
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		static thread_local uint32_t threadIndex;
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::vector<std::thread> workers;
+		WorkQueue mainThreadQueue;
+
+		std::atomic<bool> running{ true };
+		std::atomic<uint32_t> queuedTasks{ 0 };
+		std::atomic<uint32_t> nextQueue{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		const ProfilerHooks profilerHooks;
+
+		void workerLoop(uint32_t index);
+		void push(Task task);
+		bool pop(uint32_t index, Task& task);
+		bool steal(uint32_t thief, Task& task);
+		bool popMainThreadTask(Task& task);
+		void execute(Task& task);
+		void complete(const JobHandle& counter);
+		size_t defaultGrainSize(size_t count) const { return std::max<size_t>(1, count / (static_cast<size_t>(threadCount()) * 4)); }
+};
+
+template<typename Func>
+B3DJobSystem::JobHandle B3DJobSystem::parallelForAsync(size_t begin, size_t end, size_t grainSize, Func func, const char* name)
+{
+	JobHandle counter = createCounter();
+
+	if (grainSize == 0)
+	{
+		grainSize = defaultGrainSize(end - begin);
+	}
+
+	for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+	{
+		size_t chunkEnd = std::min(end, chunkBegin + grainSize);
+		run([func, chunkBegin, chunkEnd]() { func(chunkBegin, chunkEnd); }, name, counter);
+	}
+
+	return counter;
+}
+
+template<typename Func>
+void B3DJobSystem::parallelFor(size_t begin, size_t end, size_t grainSize, Func&& func, const char* name)
+{
+	if (begin >= end) return;
+
+	//The caller blocks until every chunk is done, so chunks can share the callable instead of copying it
+	auto* funcPtr = &func;
+	wait(parallelForAsync(begin, end, grainSize, [funcPtr](size_t chunkBegin, size_t chunkEnd) { (*funcPtr)(chunkBegin, chunkEnd); }, name));
+}
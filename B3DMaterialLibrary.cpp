@@ -0,0 +1,144 @@
+#include "B3DMaterialLibrary.h"
+
+//STD
+#include <algorithm>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+B3DMaterialLibrary::B3DMaterialLibrary(B3DDevice& device, B3DBindlessHeap& heap) : libraryDevice{ device }, libraryHeap{ heap }
+{
+	materials.push_back(MaterialData{});
+	albedoTextures.emplace_back();
+}
+
+B3DMaterialLibrary::~B3DMaterialLibrary()
+{
+	for (auto& frameBuffer : frameBuffers)
+	{
+		libraryHeap.removeBuffer(frameBuffer.bindlessIndex);
+	}
+}
+
+uint32_t B3DMaterialLibrary::createMaterial(const MaterialData& material)
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	materials.push_back(material);
+	albedoTextures.emplace_back();
+	materialsVersion++;
+
+	return static_cast<uint32_t>(materials.size() - 1);
+}
+
+void B3DMaterialLibrary::setMaterial(uint32_t materialId, const MaterialData& material)
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	if (materialId >= materials.size())
+	{
+		throw std::runtime_error("Material does not exist!");
+	}
+
+	materials[materialId] = material;
+	materialsVersion++;
+}
+
+void B3DMaterialLibrary::setAlbedoTexture(uint32_t materialId, std::shared_ptr<B3DTexture> texture)
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	if (materialId >= materials.size())
+	{
+		throw std::runtime_error("Material does not exist!");
+	}
+
+	albedoTextures[materialId] = texture;
+	materials[materialId].albedoTexture = texture ? texture->getBindlessIndex() : B3DBindlessHeap::INVALID_INDEX;
+	materialsVersion++;
+
+	if (texture && std::find(texturedMaterials.begin(), texturedMaterials.end(), materialId) == texturedMaterials.end())
+	{
+		texturedMaterials.push_back(materialId);
+	}
+}
+
+std::shared_ptr<B3DTexture> B3DMaterialLibrary::getAlbedoTexture(uint32_t materialId) const
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	if (materialId >= albedoTextures.size()) return nullptr;
+
+	return albedoTextures[materialId];
+}
+
+MaterialData B3DMaterialLibrary::getMaterial(uint32_t materialId) const
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	if (materialId >= materials.size())
+	{
+		PLOGW << "Material " << materialId << " does not exist, using the default";
+		return materials[DEFAULT_MATERIAL];
+	}
+
+	return materials[materialId];
+}
+
+uint32_t B3DMaterialLibrary::materialCount() const
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+	return static_cast<uint32_t>(materials.size());
+}
+
+uint32_t B3DMaterialLibrary::prepareFrame(int frameIndex)
+{
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	//Textures finish uploading while their materials are already in use, and streamed ones change slot as their mips change
+	for (auto it = texturedMaterials.begin(); it != texturedMaterials.end();)
+	{
+		const auto& texture = albedoTextures[*it];
+		const uint32_t textureIndex = texture && texture->isReady() ? texture->getBindlessIndex() : B3DBindlessHeap::INVALID_INDEX;
+
+		if (materials[*it].albedoTexture != textureIndex)
+		{
+			materials[*it].albedoTexture = textureIndex;
+			materialsVersion++;
+		}
+
+		it = texture ? it + 1 : texturedMaterials.erase(it);
+	}
+
+	FrameBuffer& frameBuffer = frameBuffers[frameIndex];
+
+	if (frameBuffer.version == materialsVersion) return frameBuffer.bindlessIndex;
+
+	//The renderer has waited on this slot's last submit, so the old buffer and its heap slot are no longer read
+	if (!frameBuffer.buffer || frameBuffer.buffer->getInstanceCount() < materials.size())
+	{
+		uint32_t capacity = frameBuffer.buffer ? frameBuffer.buffer->getInstanceCount() : INITIAL_MATERIAL_CAPACITY;
+		while (capacity < materials.size())
+		{
+			capacity *= 2;
+		}
+
+		frameBuffer.buffer = std::make_unique<B3DBuffer>(libraryDevice, sizeof(MaterialData), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frameBuffer.buffer->map();
+
+		if (frameBuffer.bindlessIndex == B3DBindlessHeap::INVALID_INDEX)
+		{
+			frameBuffer.bindlessIndex = libraryHeap.addBuffer(frameBuffer.buffer->getBuffer());
+		}
+		else
+		{
+			libraryHeap.updateBuffer(frameBuffer.bindlessIndex, frameBuffer.buffer->getBuffer());
+		}
+	}
+
+	frameBuffer.buffer->writeToBuffer(materials.data(), sizeof(MaterialData) * materials.size());
+	frameBuffer.version = materialsVersion;
+
+	return frameBuffer.bindlessIndex;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DBuffer.h"
+#include "B3DBindless.h"
+#include "B3DSwapChain.h"
+#include "B3DTexture.h"
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//STD
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Matches MaterialData in simple_shader.frag under std430
+struct MaterialData
+{
+	glm::vec4 baseColor{ 1.f };
+
+	//Index into the bindless texture array, INVALID_INDEX samples nothing
+	uint32_t albedoTexture = B3DBindlessHeap::INVALID_INDEX;
+	uint32_t padding[3]{};
+};
+
+static_assert(sizeof(MaterialData) == 32, "MaterialData must match the std430 layout in simple_shader.frag");
+
+//Material table for Based 3D.
+//Every material lives in one storage buffer registered with the bindless heap, objects pick theirs by B3DGameObj::materialId.
+//Material 0 is plain white and is what every object starts with.
+class B3DMaterialLibrary
+{
+	public:
+
+		static constexpr uint32_t DEFAULT_MATERIAL = 0;
+		static constexpr uint32_t INITIAL_MATERIAL_CAPACITY = 64;
+
+		B3DMaterialLibrary(B3DDevice& device, B3DBindlessHeap& heap);
+		~B3DMaterialLibrary();
+
+		B3DMaterialLibrary(const B3DMaterialLibrary&) = delete;
+		B3DMaterialLibrary& operator=(const B3DMaterialLibrary&) = delete;
+
+		//Safe to call from any thread, changes show up from the next prepareFrame
+		uint32_t createMaterial(const MaterialData& material);
+		void setMaterial(uint32_t materialId, const MaterialData& material);
+
+		//The material's albedoTexture follows the texture's bindless index, it stays invalid until the texture has been uploaded
+		//and changes whenever a streamed texture is rebuilt
+		void setAlbedoTexture(uint32_t materialId, std::shared_ptr<B3DTexture> texture);
+		std::shared_ptr<B3DTexture> getAlbedoTexture(uint32_t materialId) const;
+
+		MaterialData getMaterial(uint32_t materialId) const;
+		uint32_t materialCount() const;
+
+		//Call after B3DRenderer::beginFrame, uploads this frame's copy of the table if it is stale and returns its bindless buffer index
+		uint32_t prepareFrame(int frameIndex);
+
+		B3DBindlessHeap& getHeap() { return libraryHeap; }
+
+	private:
+
+		struct FrameBuffer
+		{
+			std::unique_ptr<B3DBuffer> buffer;
+			uint32_t bindlessIndex = B3DBindlessHeap::INVALID_INDEX;
+			uint64_t version = 0;
+		};
+
+		B3DDevice& libraryDevice;
+		B3DBindlessHeap& libraryHeap;
+
+		mutable std::mutex materialMutex;
+		std::vector<MaterialData> materials;
+		std::vector<std::shared_ptr<B3DTexture>> albedoTextures;
+		std::vector<uint32_t> texturedMaterials;
+		uint64_t materialsVersion = 1;
+
+		//One copy per frame in flight, so an edit never touches a table the GPU may still be reading
+		std::array<FrameBuffer, B3DSwapChain::MAX_FRAMES_IN_FLIGHT> frameBuffers;
+};
@@ -4,6 +4,9 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyObjectLoader/tiny_obj_loader.h>
 
+//STD
+#include <cmath>
+
 namespace std
 {
 	template<>
@@ -22,6 +25,53 @@ B3DModel::B3DModel(B3DDevice& device, const B3DModel::Builder& builder) : modelD
 {
 	createVertexBuffers(builder.vertices);
 	createIndexBuffers(builder.indices);
+	computeBounds(builder);
+}
+
+void B3DModel::computeBounds(const Builder& builder)
+{
+	if (builder.vertices.empty()) return;
+
+	glm::vec3 minPosition = builder.vertices[0].position;
+	glm::vec3 maxPosition = builder.vertices[0].position;
+
+	for (const auto& vertex : builder.vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.position);
+		maxPosition = glm::max(maxPosition, vertex.position);
+	}
+
+	boundingCenter = (minPosition + maxPosition) * 0.5f;
+
+	for (const auto& vertex : builder.vertices)
+	{
+		boundingRadius = glm::max(boundingRadius, glm::length(vertex.position - boundingCenter));
+	}
+
+	//Ratio of the total UV area to the total surface area, over triangles from the index buffer or the raw vertex list
+	const size_t indexCount = builder.indices.empty() ? builder.vertices.size() : builder.indices.size();
+	auto vertexAt = [&](size_t i) -> const Vertex& { return builder.vertices[builder.indices.empty() ? i : builder.indices[i]]; };
+
+	double surfaceArea = 0.0;
+	double uvArea = 0.0;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const Vertex& a = vertexAt(i);
+		const Vertex& b = vertexAt(i + 1);
+		const Vertex& c = vertexAt(i + 2);
+
+		surfaceArea += 0.5 * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+
+		glm::vec2 uvEdge1 = b.uv - a.uv;
+		glm::vec2 uvEdge2 = c.uv - a.uv;
+		uvArea += 0.5 * glm::abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+	}
+
+	if (surfaceArea > 0.0)
+	{
+		uvDensity = static_cast<float>(std::sqrt(uvArea / surfaceArea));
+	}
 }
 
 B3DModel::~B3DModel()
@@ -38,7 +88,19 @@ std::unique_ptr<B3DModel> B3DModel::createModelFromFile(B3DDevice& device, const
 
 void B3DModel::bind(VkCommandBuffer commandBuffer)
 {
-	VkBuffer buffers[] = { vertexBuffer->getBuffer()};
+	VkBuffer buffers[] = { positionBuffer->getBuffer(), attributeBuffer->getBuffer() };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+	if (hasIndexBuffer)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+}
+
+void B3DModel::bindPositions(VkCommandBuffer commandBuffer)
+{
+	VkBuffer buffers[] = { positionBuffer->getBuffer() };
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
@@ -48,15 +110,15 @@ void B3DModel::bind(VkCommandBuffer commandBuffer)
 	}
 }
 
-void B3DModel::draw(VkCommandBuffer commandBuffer)
+void B3DModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
 {
 	if (hasIndexBuffer)
 	{
-		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
 	}
 	else
 	{
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 	}
 }
 
@@ -66,18 +128,17 @@ void B3DModel::createVertexBuffers(const std::vector<Vertex>& verticies)
 
 	assert(vertexCount >= 3 && "Vertex count must be at least 3");
 
-	VkDeviceSize bufferSize = sizeof(verticies[0]) * vertexCount;
+	std::vector<glm::vec3> positions(vertexCount);
+	std::vector<VertexAttributes> attributes(vertexCount);
 
-	uint32_t vertexSize = sizeof(verticies[0]);
-
-	B3DBuffer stagingBuffer{modelDevice, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)verticies.data());
-
-	vertexBuffer = std::make_unique<B3DBuffer>(modelDevice, vertexSize, vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		positions[i] = verticies[i].position;
+		attributes[i] = { verticies[i].color, verticies[i].normal, verticies[i].uv };
+	}
 
-	modelDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+	positionBuffer = createDeviceLocalBuffer(positions.data(), sizeof(positions[0]), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	attributeBuffer = createDeviceLocalBuffer(attributes.data(), sizeof(attributes[0]), vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
 void B3DModel::createIndexBuffers(const std::vector<uint32_t>& indices)
@@ -88,27 +149,37 @@ void B3DModel::createIndexBuffers(const std::vector<uint32_t>& indices)
 
 	if (!hasIndexBuffer) return;
 
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-	uint32_t indexSize = sizeof(indices[0]);
+	indexBuffer = createDeviceLocalBuffer(indices.data(), sizeof(indices[0]), indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+std::unique_ptr<B3DBuffer> B3DModel::createDeviceLocalBuffer(const void* data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage)
+{
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(elementSize) * elementCount;
 
-	B3DBuffer stagingBuffer{ modelDevice, indexSize, indexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
+	B3DBuffer stagingBuffer{ modelDevice, elementSize, elementCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT };
 
 	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)indices.data());
+	stagingBuffer.writeToBuffer(const_cast<void*>(data));
 
-	indexBuffer = std::make_unique<B3DBuffer>(modelDevice, indexSize, indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	auto buffer = std::make_unique<B3DBuffer>(modelDevice, elementSize, elementCount, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	modelDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+	modelDevice.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), bufferSize);
+
+	return buffer;
 }
 
 std::vector<VkVertexInputBindingDescription> B3DModel::Vertex::getBindingDecriptions()
 {
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
 
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
+	bindingDescriptions[0].stride = sizeof(glm::vec3);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(VertexAttributes);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
 	return bindingDescriptions;
 }
 
@@ -116,14 +187,24 @@ std::vector<VkVertexInputAttributeDescription> B3DModel::Vertex::getAttributeDec
 {
 	std::vector<VkVertexInputAttributeDescription> attributeDescritptions{};
 
-	attributeDescritptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
-	attributeDescritptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
-	attributeDescritptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-	attributeDescritptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+	attributeDescritptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+	attributeDescritptions.push_back({ 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, color) });
+	attributeDescritptions.push_back({ 2, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, normal) });
+	attributeDescritptions.push_back({ 3, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttributes, uv) });
 
 	return attributeDescritptions;
 }
 
+std::vector<VkVertexInputBindingDescription> B3DModel::Vertex::getPositionBindingDescriptions()
+{
+	return { getBindingDecriptions()[0] };
+}
+
+std::vector<VkVertexInputAttributeDescription> B3DModel::Vertex::getPositionAttributeDescriptions()
+{
+	return { getAttributeDecriptions()[0] };
+}
+
 void B3DModel::Builder::loadModels(const std::string& filePath)
 {
 	tinyobj::attrib_t attrib;
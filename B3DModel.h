@@ -24,6 +24,8 @@ class B3DModel
 {
 	public:
 
+		//Vertices are uploaded as two streams, positions on their own in binding 0 and everything else in binding 1.
+		//A depth-only pass binds just the first, so it fetches 12 bytes per vertex
 		struct Vertex
 		{
 			glm::vec3 position{};
@@ -34,6 +36,9 @@ class B3DModel
 			static std::vector<VkVertexInputBindingDescription> getBindingDecriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDecriptions();
 
+			static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+
 			bool operator==(const Vertex& other) const { return position == other.position && color == other.color && normal == other.normal && uv == other.uv; }
 		};
 
@@ -54,19 +59,43 @@ class B3DModel
 		static std::unique_ptr<B3DModel> createModelFromFile(B3DDevice &device, const std::string &filePath);
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void bindPositions(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+		//Model space bounding sphere
+		const glm::vec3& getBoundingCenter() const { return boundingCenter; }
+		float getBoundingRadius() const { return boundingRadius; }
+
+		//UV units per model space unit, averaged over the surface. Texture streaming uses it to pick mips
+		float getUvDensity() const { return uvDensity; }
 
 	private:
 
 		B3DDevice& modelDevice;
 
-		std::unique_ptr<B3DBuffer> vertexBuffer;
+		//Layout of binding 1
+		struct VertexAttributes
+		{
+			glm::vec3 color;
+			glm::vec3 normal;
+			glm::vec2 uv;
+		};
+
+		std::unique_ptr<B3DBuffer> positionBuffer;
+		std::unique_ptr<B3DBuffer> attributeBuffer;
 		uint32_t vertexCount;
 
 		std::unique_ptr<B3DBuffer> indexBuffer;
 		uint32_t indexCount;
 		bool hasIndexBuffer = false;
 
+		glm::vec3 boundingCenter{ 0.f };
+		float boundingRadius = 0.f;
+		float uvDensity = 0.f;
+
+		void computeBounds(const Builder& builder);
+
 		void createVertexBuffers(const std::vector<Vertex>& verticies);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		std::unique_ptr<B3DBuffer> createDeviceLocalBuffer(const void* data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage);
 };
\ No newline at end of file
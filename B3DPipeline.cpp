@@ -4,10 +4,17 @@
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
+#include <chrono>
+#include <cstring>
 
 B3DPipeline::B3DPipeline(B3DDevice& device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo) : B3DPipelineDevice{ device }
 {
-	createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
+	createGraphicsPipeline(readFile(vertFilePath), readFile(fragFilePath), configInfo);
+}
+
+B3DPipeline::B3DPipeline(B3DDevice& device, const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo) : B3DPipelineDevice{ device }
+{
+	createGraphicsPipeline(vertCode, fragCode, configInfo);
 }
 
 B3DPipeline::~B3DPipeline()
@@ -91,6 +98,20 @@ void B3DPipeline::deafultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 	configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
 	configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 	configInfo.dynamicStateInfo.flags = 0;
+
+	configInfo.bindingDescriptions = B3DModel::Vertex::getBindingDecriptions();
+	configInfo.attributeDescriptions = B3DModel::Vertex::getAttributeDecriptions();
+}
+
+void B3DPipeline::depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo)
+{
+	deafultPipelineConfigInfo(configInfo);
+
+	configInfo.colorBlendInfo.attachmentCount = 0;
+	configInfo.colorBlendInfo.pAttachments = nullptr;
+
+	configInfo.bindingDescriptions = B3DModel::Vertex::getPositionBindingDescriptions();
+	configInfo.attributeDescriptions = B3DModel::Vertex::getPositionAttributeDescriptions();
 }
 
 std::vector<char> B3DPipeline::readFile(const std::string& filePath)
@@ -112,16 +133,53 @@ std::vector<char> B3DPipeline::readFile(const std::string& filePath)
 	return buffer;
 }
 
-void B3DPipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
+void B3DPipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value)
+{
+	for (const auto& entry : configInfo.specializationEntries)
+	{
+		if (entry.constantID == constantId)
+		{
+			configInfo.specializationData[entry.offset / sizeof(uint32_t)] = value;
+			return;
+		}
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = constantId;
+	entry.offset = static_cast<uint32_t>(configInfo.specializationData.size() * sizeof(uint32_t));
+	entry.size = sizeof(uint32_t);
+
+	configInfo.specializationEntries.push_back(entry);
+	configInfo.specializationData.push_back(value);
+}
+
+void B3DPipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	setSpecializationConstant(configInfo, constantId, bits);
+}
+
+void B3DPipeline::createGraphicsPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo)
 {
 	assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline! No piplineLayout provided in config");
 	assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline! No renderPass provided in config");
 
-	auto vertCode = readFile(vertFilePath);
-	auto fragCode = readFile(fragFilePath);
-
 	createShaderModule(vertCode, &vertShaderModule);
-	createShaderModule(fragCode, &fragShaderModule);
+
+	if (!fragCode.empty())
+	{
+		createShaderModule(fragCode, &fragShaderModule);
+	}
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationEntries.size());
+	specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+	specializationInfo.dataSize = configInfo.specializationData.size() * sizeof(uint32_t);
+	specializationInfo.pData = configInfo.specializationData.data();
+
+	const VkSpecializationInfo* stageSpecialization = configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
 
 	VkPipelineShaderStageCreateInfo shaderStages[2];
 	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -130,7 +188,7 @@ void B3DPipeline::createGraphicsPipeline(const std::string& vertFilePath, const
 	shaderStages[0].pName = "main";
 	shaderStages[0].flags = 0;
 	shaderStages[0].pNext = nullptr;
-	shaderStages[0].pSpecializationInfo = nullptr;
+	shaderStages[0].pSpecializationInfo = stageSpecialization;
 
 	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -138,21 +196,18 @@ void B3DPipeline::createGraphicsPipeline(const std::string& vertFilePath, const
 	shaderStages[1].pName = "main";
 	shaderStages[1].flags = 0;
 	shaderStages[1].pNext = nullptr;
-	shaderStages[1].pSpecializationInfo = nullptr;
-
-	auto bindingDescriptions = B3DModel::Vertex::getBindingDecriptions();
-	auto attributeDescriptions = B3DModel::Vertex::getAttributeDecriptions();
+	shaderStages[1].pSpecializationInfo = stageSpecialization;
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(configInfo.attributeDescriptions.size());
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(configInfo.bindingDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = configInfo.attributeDescriptions.data();
+	vertexInputInfo.pVertexBindingDescriptions = configInfo.bindingDescriptions.data();
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
+	pipelineInfo.stageCount = fragShaderModule != VK_NULL_HANDLE ? 2 : 1;
 	pipelineInfo.pStages = shaderStages;
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
 	pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
@@ -170,10 +225,15 @@ void B3DPipeline::createGraphicsPipeline(const std::string& vertFilePath, const
 	pipelineInfo.basePipelineIndex = -1;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(B3DPipelineDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(B3DPipelineDevice.device(), B3DPipelineDevice.getPipelineCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics pipelines!");
 	}
+
+	float creationTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	PLOGI << "Created graphics pipeline in " << creationTime << " ms (" << (B3DPipelineDevice.isPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache)";
 }
 
 void B3DPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
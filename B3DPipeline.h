@@ -21,15 +21,23 @@ struct PipelineConfigInfo
 	VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 	std::vector<VkDynamicState> dynamicStateEnables;
 	VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 	VkPipelineLayout pipelineLayout = nullptr;
 	VkRenderPass renderPass = nullptr;
 	uint32_t subpass = 0;
+
+	//Shared by every stage, constants a stage doesn't declare are ignored by it
+	std::vector<VkSpecializationMapEntry> specializationEntries;
+	std::vector<uint32_t> specializationData;
 };
 
 class B3DPipeline
 {
 	public:
 		B3DPipeline(B3DDevice &device, const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo &configInfo);
+		//Empty fragment code builds a pipeline with only a vertex stage
+		B3DPipeline(B3DDevice &device, const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo &configInfo);
 		~B3DPipeline();
 
 		B3DPipeline(const B3DPipeline&) = delete;
@@ -39,17 +47,22 @@ class B3DPipeline
 
 		static void deafultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-	private:
+		//Positions only and no color attachments, for passes that just lay down depth. Pair it with empty fragment code
+		static void depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo);
+		static std::vector<char> readFile(const std::string& filePath);
 
-		std::vector<char> readFile(const std::string& filePath);
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value);
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, float value);
+
+	private:
 
 		B3DDevice& B3DPipelineDevice;
 		VkPipeline graphicsPipeline;
 		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		VkShaderModule fragShaderModule = VK_NULL_HANDLE;
 
 
-		void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo &configInfo);
+		void createGraphicsPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo &configInfo);
 		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 };
 
@@ -0,0 +1,236 @@
+#include "B3DPipelineRegistry.h"
+
+//Local
+#include "B3DUtils.h"
+
+//STD
+#include <string_view>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	size_t hashShaderCode(const std::vector<char>& code)
+	{
+		return std::hash<std::string_view>{}(std::string_view{ code.data(), code.size() });
+	}
+}
+
+B3DPipelineRegistry::B3DPipelineRegistry(B3DDevice& device, B3DJobSystem& jobSystem) : registryDevice{ device }, registryJobSystem{ jobSystem }
+{
+}
+
+B3DPipelineRegistry::~B3DPipelineRegistry()
+{
+	//Compile jobs write into the entries, so they have to land before the pipelines are destroyed
+	for (auto& [key, entry] : entries)
+	{
+		try
+		{
+			registryJobSystem.wait(entry->compileJob);
+		}
+		catch (const std::exception&)
+		{
+			//Already logged by the compile job
+		}
+	}
+}
+
+B3DPipelineRegistry::PipelineHandle B3DPipelineRegistry::requestPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
+{
+	return requestPipeline(B3DPipeline::readFile(vertFilePath), B3DPipeline::readFile(fragFilePath), configInfo);
+}
+
+B3DPipelineRegistry::PipelineHandle B3DPipelineRegistry::requestPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo)
+{
+	size_t key = hashPipelineConfigInfo(configInfo);
+	B3DUtills::hashCombine(key, hashShaderCode(vertCode), hashShaderCode(fragCode));
+
+	auto candidate = std::make_shared<PipelineEntry>();
+	candidate->vertCode = vertCode;
+	candidate->fragCode = fragCode;
+	copyPipelineConfigInfo(configInfo, candidate->configInfo);
+
+	return findOrCompile(key, std::move(candidate));
+}
+
+B3DPipelineRegistry::PipelineHandle B3DPipelineRegistry::requestPipeline(const B3DShaderLibrary::ShaderVariant& vertVariant, const B3DShaderLibrary::ShaderVariant& fragVariant, const PipelineConfigInfo& configInfo)
+{
+	size_t key = hashPipelineConfigInfo(configInfo);
+	B3DUtills::hashCombine(key, shaderLibrary.hashVariant(vertVariant), shaderLibrary.hashVariant(fragVariant));
+
+	auto candidate = std::make_shared<PipelineEntry>();
+	candidate->vertVariant = vertVariant;
+	candidate->fragVariant = fragVariant;
+	copyPipelineConfigInfo(configInfo, candidate->configInfo);
+
+	return findOrCompile(key, std::move(candidate));
+}
+
+void B3DPipelineRegistry::waitFor(const PipelineHandle& handle)
+{
+	if (!handle.isValid()) return;
+
+	registryJobSystem.wait(handle.entry->compileJob);
+}
+
+void B3DPipelineRegistry::waitForAll()
+{
+	std::vector<B3DJobSystem::JobHandle> jobs;
+	{
+		std::lock_guard<std::mutex> lock(entriesMutex);
+
+		for (auto& [key, entry] : entries)
+		{
+			jobs.push_back(entry->compileJob);
+		}
+	}
+
+	for (auto& job : jobs)
+	{
+		registryJobSystem.wait(job);
+	}
+}
+
+B3DPipelineRegistry::PipelineHandle B3DPipelineRegistry::findOrCompile(size_t key, std::shared_ptr<PipelineEntry> candidate)
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+
+	//The config only contributes its hash, so the shaders are compared in full to rule out collisions there
+	auto [first, last] = entries.equal_range(key);
+	for (auto it = first; it != last; it++)
+	{
+		const PipelineEntry& existing = *it->second;
+
+		if (existing.vertCode == candidate->vertCode && existing.fragCode == candidate->fragCode &&
+			existing.vertVariant == candidate->vertVariant && existing.fragVariant == candidate->fragVariant)
+		{
+			return PipelineHandle{ it->second };
+		}
+	}
+
+	candidate->key = key;
+
+	PipelineEntry* entryPtr = candidate.get();
+	candidate->compileJob = registryJobSystem.run([this, entryPtr]() { compile(*entryPtr); }, "Compile pipeline");
+
+	entries.emplace(key, candidate);
+
+	return PipelineHandle{ std::move(candidate) };
+}
+
+size_t B3DPipelineRegistry::pipelineCount() const
+{
+	std::lock_guard<std::mutex> lock(entriesMutex);
+	return entries.size();
+}
+
+void B3DPipelineRegistry::compile(PipelineEntry& entry)
+{
+	try
+	{
+		if (!entry.vertVariant.sourcePath.empty())
+		{
+			//A variant without a source is a pipeline with no fragment stage
+			std::vector<char> fragCode = entry.fragVariant.sourcePath.empty() ? std::vector<char>{} : shaderLibrary.getSpirv(entry.fragVariant);
+			entry.pipeline = std::make_unique<B3DPipeline>(registryDevice, shaderLibrary.getSpirv(entry.vertVariant), fragCode, entry.configInfo);
+		}
+		else
+		{
+			entry.pipeline = std::make_unique<B3DPipeline>(registryDevice, entry.vertCode, entry.fragCode, entry.configInfo);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		PLOGE << "Background pipeline compile failed: " << e.what();
+		entry.failed.store(true, std::memory_order_release);
+		throw;
+	}
+
+	entry.ready.store(true, std::memory_order_release);
+}
+
+size_t B3DPipelineRegistry::hashPipelineConfigInfo(const PipelineConfigInfo& configInfo)
+{
+	size_t seed = 0;
+
+	const auto& inputAssembly = configInfo.inputAssemblyInfo;
+	B3DUtills::hashCombine(seed, inputAssembly.topology, inputAssembly.primitiveRestartEnable);
+
+	const auto& viewport = configInfo.viewportInfo;
+	B3DUtills::hashCombine(seed, viewport.viewportCount, viewport.scissorCount);
+
+	const auto& rasterization = configInfo.rasterizationInfo;
+	B3DUtills::hashCombine(seed, rasterization.depthClampEnable, rasterization.rasterizerDiscardEnable, rasterization.polygonMode, rasterization.cullMode, rasterization.frontFace,
+		rasterization.depthBiasEnable, rasterization.depthBiasConstantFactor, rasterization.depthBiasClamp, rasterization.depthBiasSlopeFactor, rasterization.lineWidth);
+
+	const auto& multisample = configInfo.multisampleInfo;
+	B3DUtills::hashCombine(seed, multisample.rasterizationSamples, multisample.sampleShadingEnable, multisample.minSampleShading, multisample.alphaToCoverageEnable, multisample.alphaToOneEnable);
+
+	const auto& blendAttachment = configInfo.colorBlendAttachment;
+	B3DUtills::hashCombine(seed, blendAttachment.blendEnable, blendAttachment.srcColorBlendFactor, blendAttachment.dstColorBlendFactor, blendAttachment.colorBlendOp,
+		blendAttachment.srcAlphaBlendFactor, blendAttachment.dstAlphaBlendFactor, blendAttachment.alphaBlendOp, blendAttachment.colorWriteMask);
+
+	const auto& colorBlend = configInfo.colorBlendInfo;
+	B3DUtills::hashCombine(seed, colorBlend.logicOpEnable, colorBlend.logicOp, colorBlend.attachmentCount,
+		colorBlend.blendConstants[0], colorBlend.blendConstants[1], colorBlend.blendConstants[2], colorBlend.blendConstants[3]);
+
+	const auto& depthStencil = configInfo.depthStencilInfo;
+	B3DUtills::hashCombine(seed, depthStencil.depthTestEnable, depthStencil.depthWriteEnable, depthStencil.depthCompareOp, depthStencil.depthBoundsTestEnable,
+		depthStencil.stencilTestEnable, depthStencil.minDepthBounds, depthStencil.maxDepthBounds);
+
+	for (const VkStencilOpState& stencil : { depthStencil.front, depthStencil.back })
+	{
+		B3DUtills::hashCombine(seed, stencil.failOp, stencil.passOp, stencil.depthFailOp, stencil.compareOp, stencil.compareMask, stencil.writeMask, stencil.reference);
+	}
+
+	for (VkDynamicState state : configInfo.dynamicStateEnables)
+	{
+		B3DUtills::hashCombine(seed, state);
+	}
+
+	for (const auto& binding : configInfo.bindingDescriptions)
+	{
+		B3DUtills::hashCombine(seed, binding.binding, binding.stride, binding.inputRate);
+	}
+
+	for (const auto& attribute : configInfo.attributeDescriptions)
+	{
+		B3DUtills::hashCombine(seed, attribute.location, attribute.binding, attribute.format, attribute.offset);
+	}
+
+	for (const auto& entry : configInfo.specializationEntries)
+	{
+		B3DUtills::hashCombine(seed, entry.constantID, configInfo.specializationData[entry.offset / sizeof(uint32_t)]);
+	}
+
+	B3DUtills::hashCombine(seed, configInfo.pipelineLayout, configInfo.renderPass, configInfo.subpass);
+
+	return seed;
+}
+
+void B3DPipelineRegistry::copyPipelineConfigInfo(const PipelineConfigInfo& source, PipelineConfigInfo& destination)
+{
+	destination.viewportInfo = source.viewportInfo;
+	destination.inputAssemblyInfo = source.inputAssemblyInfo;
+	destination.rasterizationInfo = source.rasterizationInfo;
+	destination.multisampleInfo = source.multisampleInfo;
+	destination.colorBlendAttachment = source.colorBlendAttachment;
+	destination.colorBlendInfo = source.colorBlendInfo;
+	destination.depthStencilInfo = source.depthStencilInfo;
+	destination.dynamicStateEnables = source.dynamicStateEnables;
+	destination.dynamicStateInfo = source.dynamicStateInfo;
+	destination.pipelineLayout = source.pipelineLayout;
+	destination.renderPass = source.renderPass;
+	destination.subpass = source.subpass;
+	destination.specializationEntries = source.specializationEntries;
+	destination.specializationData = source.specializationData;
+	destination.bindingDescriptions = source.bindingDescriptions;
+	destination.attributeDescriptions = source.attributeDescriptions;
+
+	//The config points into itself, so those pointers have to follow the copy
+	destination.colorBlendInfo.pAttachments = &destination.colorBlendAttachment;
+	destination.dynamicStateInfo.pDynamicStates = destination.dynamicStateEnables.data();
+	destination.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(destination.dynamicStateEnables.size());
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DPipeline.h"
+#include "B3DJobSystem.h"
+#include "B3DShaderLibrary.h"
+
+//STD
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Deduplicating store of graphics pipelines for Based 3D.
+//Pipelines are keyed by a hash of their full config and shader code or shader variants, and compile on the job system in the background.
+//Render code holds a handle and skips or substitutes a fallback until the pipeline is ready, so new variants never stall a frame.
+class B3DPipelineRegistry
+{
+	struct PipelineEntry;
+
+	public:
+
+		class PipelineHandle
+		{
+			public:
+
+				PipelineHandle() = default;
+
+				bool isValid() const { return entry != nullptr; }
+				bool isReady() const { return entry && entry->ready.load(std::memory_order_acquire); }
+				bool hasFailed() const { return entry && entry->failed.load(std::memory_order_acquire); }
+
+				//Returns nullptr until the background compile has finished
+				B3DPipeline* get() const { return isReady() ? entry->pipeline.get() : nullptr; }
+				B3DPipeline* getOr(B3DPipeline* fallback) const { return isReady() ? entry->pipeline.get() : fallback; }
+
+				size_t getKey() const { return entry ? entry->key : 0; }
+
+			private:
+
+				friend class B3DPipelineRegistry;
+
+				explicit PipelineHandle(std::shared_ptr<PipelineEntry> entry) : entry{ std::move(entry) } {}
+
+				std::shared_ptr<PipelineEntry> entry;
+		};
+
+		B3DPipelineRegistry(B3DDevice& device, B3DJobSystem& jobSystem);
+		~B3DPipelineRegistry();
+
+		B3DPipelineRegistry(const B3DPipelineRegistry&) = delete;
+		B3DPipelineRegistry& operator=(const B3DPipelineRegistry&) = delete;
+
+		PipelineHandle requestPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo);
+		PipelineHandle requestPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo);
+
+		//Variants are compiled to SPIR-V on the worker as part of the pipeline job
+		PipelineHandle requestPipeline(const B3DShaderLibrary::ShaderVariant& vertVariant, const B3DShaderLibrary::ShaderVariant& fragVariant, const PipelineConfigInfo& configInfo);
+
+		//Blocks until the handle's pipeline has compiled, rethrowing any compile failure
+		void waitFor(const PipelineHandle& handle);
+		void waitForAll();
+
+		size_t pipelineCount() const;
+		B3DShaderLibrary& getShaderLibrary() { return shaderLibrary; }
+
+		static size_t hashPipelineConfigInfo(const PipelineConfigInfo& configInfo);
+		static void copyPipelineConfigInfo(const PipelineConfigInfo& source, PipelineConfigInfo& destination);
+
+	private:
+
+		struct PipelineEntry
+		{
+			size_t key = 0;
+
+			//Either the code or the variants are set, never both
+			std::vector<char> vertCode;
+			std::vector<char> fragCode;
+			B3DShaderLibrary::ShaderVariant vertVariant;
+			B3DShaderLibrary::ShaderVariant fragVariant;
+			PipelineConfigInfo configInfo{};
+
+			std::unique_ptr<B3DPipeline> pipeline;
+			B3DJobSystem::JobHandle compileJob;
+			std::atomic<bool> ready{ false };
+			std::atomic<bool> failed{ false };
+		};
+
+		B3DDevice& registryDevice;
+		B3DJobSystem& registryJobSystem;
+		B3DShaderLibrary shaderLibrary;
+
+		mutable std::mutex entriesMutex;
+		std::unordered_multimap<size_t, std::shared_ptr<PipelineEntry>> entries;
+
+		PipelineHandle findOrCompile(size_t key, std::shared_ptr<PipelineEntry> candidate);
+		void compile(PipelineEntry& entry);
+};
@@ -0,0 +1,284 @@
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//Plog
+#include <plog/Log.h>
+
+std::atomic<bool> B3DProfiler::enabled{ false };
+
+namespace
+{
+	//Writers can be a few events ahead of the snapshot an export reads, so the oldest slots are left alone
+	constexpr uint64_t EXPORT_SAFETY_MARGIN = 1024;
+
+	struct ThreadBuffer
+	{
+		uint32_t threadId = 0;
+		std::string name;
+		std::unique_ptr<B3DProfiler::Event[]> events;
+		std::atomic<uint64_t> writeCount{ 0 };
+		uint64_t captureStart = 0;
+	};
+
+	//Buffers are never freed, a thread that exits mid-capture still has its events exported
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+	//Capture state, only touched from the thread driving frames
+	uint64_t frameNumber = 0;
+	bool captureArmed = false;
+	bool captureActive = false;
+	bool enabledBeforeCapture = false;
+	uint32_t captureFramesRemaining = 0;
+	std::string capturePath;
+
+	//One bit per nested job zone, so a job that began while recording was off doesn't emit a stray end
+	thread_local uint64_t jobZoneRecorded = 0;
+
+	ThreadBuffer& getThreadBuffer()
+	{
+		if (localBuffer) return *localBuffer;
+
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->events = std::make_unique<B3DProfiler::Event[]>(B3DProfiler::EVENTS_PER_THREAD);
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+		buffer->name = "Thread " + std::to_string(buffer->threadId);
+
+		localBuffer = buffer.get();
+		threadBuffers.push_back(std::move(buffer));
+
+		return *localBuffer;
+	}
+
+	uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerEpoch).count());
+	}
+
+	void writeEscaped(std::ostream& out, const char* text)
+	{
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\') out << '\\';
+			out << *c;
+		}
+	}
+
+	void jobBeginZone(const char* name)
+	{
+		const bool recorded = B3DProfiler::isEnabled();
+		jobZoneRecorded = (jobZoneRecorded << 1) | (recorded ? 1 : 0);
+
+		if (recorded) B3DProfiler::beginZone(name);
+	}
+
+	void jobEndZone()
+	{
+		const bool recorded = jobZoneRecorded & 1;
+		jobZoneRecorded >>= 1;
+
+		if (recorded) B3DProfiler::endZone();
+	}
+
+	void jobThreadStarted(uint32_t threadIndex)
+	{
+		B3DProfiler::setThreadName("Worker " + std::to_string(threadIndex));
+	}
+}
+
+void B3DProfiler::beginZone(const char* name)
+{
+	record(EventType::BEGIN, name, 0);
+}
+
+void B3DProfiler::endZone()
+{
+	record(EventType::END, nullptr, 0);
+}
+
+void B3DProfiler::counter(const char* name, int64_t value)
+{
+	if (!isEnabled()) return;
+
+	record(EventType::COUNTER, name, value);
+}
+
+void B3DProfiler::setThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer.name = name;
+}
+
+void B3DProfiler::frameBegin()
+{
+	frameNumber++;
+
+	if (captureArmed)
+	{
+		captureArmed = false;
+		captureActive = true;
+		enabledBeforeCapture = isEnabled();
+
+		//Anything recorded before this point is outside the capture, even if recording was already on
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		for (auto& buffer : threadBuffers)
+		{
+			buffer->captureStart = buffer->writeCount.load(std::memory_order_acquire);
+		}
+
+		setEnabled(true);
+	}
+
+	if (isEnabled())
+	{
+		record(EventType::FRAME_BEGIN, "Frame", static_cast<int64_t>(frameNumber));
+	}
+}
+
+void B3DProfiler::frameEnd()
+{
+	if (isEnabled())
+	{
+		record(EventType::FRAME_END, "Frame", static_cast<int64_t>(frameNumber));
+	}
+
+	if (captureActive && --captureFramesRemaining == 0)
+	{
+		captureActive = false;
+		setEnabled(enabledBeforeCapture);
+
+		if (writeCapture(capturePath))
+		{
+			PLOGI << "Profiler capture written to " << capturePath;
+		}
+		else
+		{
+			PLOGW << "Failed to write profiler capture to " << capturePath;
+		}
+	}
+}
+
+void B3DProfiler::captureFrames(uint32_t frameCount, const std::string& path)
+{
+	if (frameCount == 0 || isCapturing()) return;
+
+	captureArmed = true;
+	captureFramesRemaining = frameCount;
+	capturePath = path;
+
+	PLOGI << "Profiler capturing the next " << frameCount << " frames";
+}
+
+bool B3DProfiler::isCapturing()
+{
+	return captureArmed || captureActive;
+}
+
+B3DJobSystem::ProfilerHooks B3DProfiler::jobSystemHooks()
+{
+	B3DJobSystem::ProfilerHooks hooks{};
+
+#if B3D_PROFILER_ENABLED
+	hooks.beginZone = &jobBeginZone;
+	hooks.endZone = &jobEndZone;
+	hooks.threadStarted = &jobThreadStarted;
+#endif
+
+	return hooks;
+}
+
+void B3DProfiler::record(EventType type, const char* name, int64_t value)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+
+	//Only this thread writes the buffer, the release store publishes the event to the exporter
+	const uint64_t index = buffer.writeCount.load(std::memory_order_relaxed);
+	buffer.events[index % EVENTS_PER_THREAD] = Event{ name, now(), value, type };
+	buffer.writeCount.store(index + 1, std::memory_order_release);
+}
+
+bool B3DProfiler::writeCapture(const std::string& path)
+{
+	std::ofstream file{ path, std::ios::trunc };
+
+	if (!file.is_open()) return false;
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	bool first = true;
+	auto separator = [&]() -> std::ostream&
+	{
+		if (!first) file << ",\n";
+		first = false;
+		return file;
+	};
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	for (const auto& buffer : threadBuffers)
+	{
+		separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+		writeEscaped(file, buffer->name.c_str());
+		file << "\"}}";
+
+		const uint64_t end = buffer->writeCount.load(std::memory_order_acquire);
+		const uint64_t oldestSafe = end > EVENTS_PER_THREAD - EXPORT_SAFETY_MARGIN ? end - (EVENTS_PER_THREAD - EXPORT_SAFETY_MARGIN) : 0;
+		const uint64_t begin = std::max(buffer->captureStart, oldestSafe);
+
+		for (uint64_t i = begin; i < end; i++)
+		{
+			const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+			const double timestamp = static_cast<double>(event.timestamp) / 1000.0;
+
+			switch (event.type)
+			{
+				case EventType::BEGIN:
+				case EventType::FRAME_BEGIN:
+					separator() << "{\"name\":\"";
+					writeEscaped(file, event.name);
+					file << "\",\"ph\":\"B\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << timestamp;
+
+					if (event.type == EventType::FRAME_BEGIN)
+					{
+						file << ",\"args\":{\"frame\":" << event.value << "}";
+					}
+
+					file << "}";
+					break;
+
+				case EventType::END:
+				case EventType::FRAME_END:
+					separator() << "{\"ph\":\"E\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << timestamp << "}";
+					break;
+
+				case EventType::COUNTER:
+					separator() << "{\"name\":\"";
+					writeEscaped(file, event.name);
+					file << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << timestamp << ",\"args\":{\"value\":" << event.value << "}}";
+					break;
+			}
+		}
+	}
+
+	file << "\n]}\n";
+
+	return file.good();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+//Local
+#include "B3DJobSystem.h"
+
+//STD
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//Set to 0 to compile every profiling macro out entirely
+#ifndef B3D_PROFILER_ENABLED
+#define B3D_PROFILER_ENABLED 1
+#endif
+
+#define B3D_PROFILE_CONCAT_INNER(a, b) a##b
+#define B3D_PROFILE_CONCAT(a, b) B3D_PROFILE_CONCAT_INNER(a, b)
+
+#if B3D_PROFILER_ENABLED
+#define B3D_PROFILE_SCOPE(name) B3DProfiler::Scope B3D_PROFILE_CONCAT(profileScope, __LINE__){ name }
+#define B3D_PROFILE_FUNCTION() B3D_PROFILE_SCOPE(__FUNCTION__)
+#define B3D_PROFILE_COUNTER(name, value) B3DProfiler::counter(name, static_cast<int64_t>(value))
+#define B3D_PROFILE_FRAME_BEGIN() B3DProfiler::frameBegin()
+#define B3D_PROFILE_FRAME_END() B3DProfiler::frameEnd()
+#else
+#define B3D_PROFILE_SCOPE(name) ((void)0)
+#define B3D_PROFILE_FUNCTION() ((void)0)
+#define B3D_PROFILE_COUNTER(name, value) ((void)0)
+#define B3D_PROFILE_FRAME_BEGIN() ((void)0)
+#define B3D_PROFILE_FRAME_END() ((void)0)
+#endif
+
+//CPU scoped-zone profiler for Based 3D.
+//Every thread records into its own fixed-size ring that only it writes to, so recording never takes a lock.
+//Recording is off until enabled or a capture is requested, at which point each zone costs two clock reads.
+//Captures are written as Chrome trace JSON, which chrome://tracing and Perfetto both open.
+class B3DProfiler
+{
+	public:
+
+		static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+		enum class EventType : uint8_t
+		{
+			BEGIN,
+			END,
+			COUNTER,
+			FRAME_BEGIN,
+			FRAME_END,
+		};
+
+		struct Event
+		{
+			const char* name;
+			uint64_t timestamp;
+			int64_t value;
+			EventType type;
+		};
+
+		class Scope
+		{
+			public:
+
+				explicit Scope(const char* name) : active{ isEnabled() }
+				{
+					if (active) beginZone(name);
+				}
+
+				~Scope()
+				{
+					if (active) endZone();
+				}
+
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+
+			private:
+
+				//Zones keep their end even if recording stops halfway through them
+				const bool active;
+		};
+
+		B3DProfiler() = delete;
+
+		static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+		static void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+		static void beginZone(const char* name);
+		static void endZone();
+		static void counter(const char* name, int64_t value);
+		static void setThreadName(const std::string& name);
+
+		//Driven by the renderer, captures start and finish on frame boundaries
+		static void frameBegin();
+		static void frameEnd();
+
+		//Records the next frameCount frames and writes them to path once the last one ends
+		static void captureFrames(uint32_t frameCount, const std::string& path);
+		static bool isCapturing();
+
+		static B3DJobSystem::ProfilerHooks jobSystemHooks();
+
+	private:
+
+		static std::atomic<bool> enabled;
+
+		static void record(EventType type, const char* name, int64_t value);
+		static bool writeCapture(const std::string& path);
+};
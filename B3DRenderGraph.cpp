@@ -0,0 +1,1004 @@
+#include "B3DRenderGraph.h"
+
+//Local
+#include "B3DProfiler.h"
+#include "B3DUtils.h"
+
+//STD
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	//Non-dispatchable handles are pointers on 64-bit builds and integers elsewhere
+	template<typename Handle>
+	uint64_t handleValue(Handle handle)
+	{
+		return (uint64_t)(handle);
+	}
+}
+
+B3DRenderGraph::ResourceHandle B3DRenderGraph::PassBuilder::createImage(const char* name, const ImageDesc& desc)
+{
+	assert(desc.format != VK_FORMAT_UNDEFINED && "Render graph images need a format!");
+
+	Resource resource{};
+	resource.name = name;
+	resource.desc = desc;
+	graph.resources.push_back(resource);
+
+	return static_cast<ResourceHandle>(graph.resources.size() - 1);
+}
+
+void B3DRenderGraph::PassBuilder::writeColor(ResourceHandle image, const VkClearColorValue* clear)
+{
+	VkClearValue clearValue{};
+	if (clear) clearValue.color = *clear;
+
+	graph.addAccess(pass, image, AccessType::COLOR_WRITE, 0, clear ? &clearValue : nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::writeDepth(ResourceHandle image, const VkClearDepthStencilValue* clear)
+{
+	VkClearValue clearValue{};
+	if (clear) clearValue.depthStencil = *clear;
+
+	graph.addAccess(pass, image, AccessType::DEPTH_WRITE, 0, clear ? &clearValue : nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::readDepth(ResourceHandle image)
+{
+	graph.addAccess(pass, image, AccessType::DEPTH_READ, 0, nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::sampleImage(ResourceHandle image, VkPipelineStageFlags stages)
+{
+	graph.addAccess(pass, image, AccessType::SAMPLED, stages, nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::copyFrom(ResourceHandle image)
+{
+	graph.addAccess(pass, image, AccessType::TRANSFER_SRC, 0, nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::copyTo(ResourceHandle image)
+{
+	graph.addAccess(pass, image, AccessType::TRANSFER_DST, 0, nullptr);
+}
+
+void B3DRenderGraph::PassBuilder::setSideEffects()
+{
+	graph.passes[pass].sideEffects = true;
+}
+
+void B3DRenderGraph::PassBuilder::setSubpassContents(VkSubpassContents contents)
+{
+	graph.passes[pass].contents = contents;
+}
+
+B3DRenderGraph::B3DRenderGraph(B3DDevice& device) : graphDevice{ device }
+{
+
+}
+
+B3DRenderGraph::~B3DRenderGraph()
+{
+	releaseCompiled();
+
+	for (const auto& retired : retiredObjects)
+	{
+		destroyRetired(retired);
+	}
+
+	for (const auto& [key, renderPass] : renderPassCache)
+	{
+		vkDestroyRenderPass(graphDevice.device(), renderPass, nullptr);
+	}
+}
+
+void B3DRenderGraph::beginFrame(VkExtent2D extent)
+{
+	frameCounter++;
+
+	renderExtent = extent;
+	passes.clear();
+	resources.clear();
+
+	B3DTimeline& timeline = graphDevice.getGraphicsTimeline();
+
+	for (auto it = retiredObjects.begin(); it != retiredObjects.end();)
+	{
+		if (timeline.isComplete(it->releaseValue))
+		{
+			destroyRetired(*it);
+			it = retiredObjects.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (auto it = framebufferCache.begin(); it != framebufferCache.end();)
+	{
+		if (it->second.lastUsedFrame + FRAMEBUFFER_EVICT_FRAMES <= frameCounter)
+		{
+			vkDestroyFramebuffer(graphDevice.device(), it->second.framebuffer, nullptr);
+			it = framebufferCache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+B3DRenderGraph::ResourceHandle B3DRenderGraph::importImage(const char* name, const ImportedImage& image)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.imported = true;
+	resource.import = image;
+	resource.desc.format = image.format;
+	resource.desc.extent = image.extent;
+	resources.push_back(resource);
+
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+B3DRenderGraph::PassHandle B3DRenderGraph::addPass(const char* name, const std::function<void(PassBuilder&)>& setup, ExecuteFunction execute)
+{
+	Pass pass{};
+	pass.name = name;
+	pass.execute = std::move(execute);
+	passes.push_back(std::move(pass));
+
+	const PassHandle handle = static_cast<PassHandle>(passes.size() - 1);
+
+	PassBuilder builder{ *this, handle };
+	setup(builder);
+
+	return handle;
+}
+
+void B3DRenderGraph::addAccess(PassHandle pass, ResourceHandle resource, AccessType type, VkPipelineStageFlags shaderStages, const VkClearValue* clear)
+{
+	assert(resource < resources.size() && "Unknown render graph resource!");
+
+	Access access{};
+	access.resource = resource;
+	access.type = type;
+	access.shaderStages = shaderStages;
+	access.clear = clear != nullptr;
+	if (clear) access.clearValue = *clear;
+
+	passes[pass].accesses.push_back(access);
+}
+
+void B3DRenderGraph::execute(VkCommandBuffer commandBuffer, B3DGpuProfiler* profiler)
+{
+	B3D_PROFILE_FUNCTION();
+
+	const size_t hash = hashDeclarations();
+	if (!compiled || hash != compiledHash)
+	{
+		compile();
+		compiledHash = hash;
+	}
+
+	//Created images start each frame undefined, after whatever last used their memory
+	std::vector<ResourceState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		ResourceState& state = states[i];
+		state.written = true;
+
+		if (resources[i].imported)
+		{
+			state.layout = resources[i].import.initialLayout;
+			state.stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			state.access = state.layout == VK_IMAGE_LAYOUT_UNDEFINED ? 0 : VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+		else if (transientOfResource[i] != INVALID_HANDLE)
+		{
+			state.awaitingBlock = true;
+		}
+	}
+
+	for (const auto& compiledPass : compiledPasses)
+	{
+		const Pass& pass = passes[compiledPass.pass];
+
+		std::vector<VkImageMemoryBarrier> barriers{};
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		for (const auto& access : pass.accesses)
+		{
+			ResourceState& state = states[access.resource];
+
+			//Read here and not before the loop, an earlier pass may have used the same memory through another image
+			if (state.awaitingBlock)
+			{
+				const MemoryBlock& block = memoryBlocks[transientImages[transientOfResource[access.resource]].block];
+				state.stages = block.lastStages;
+				state.access = block.lastAccess;
+				state.awaitingBlock = false;
+			}
+
+			VkImageLayout layout;
+			VkPipelineStageFlags stages;
+			VkAccessFlags accessFlags;
+			accessState(access, layout, stages, accessFlags);
+
+			const bool write = isWrite(access.type);
+
+			if (layout == state.layout && !state.written && !write)
+			{
+				//Reads after reads in the same layout need nothing, the next write waits on all of them
+				state.stages |= stages;
+				state.access |= accessFlags;
+			}
+			else
+			{
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = layout;
+				barrier.srcAccessMask = state.written ? state.access : 0;
+				barrier.dstAccessMask = accessFlags;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = getImage(access.resource);
+				barrier.subresourceRange = { barrierAspect(resourceFormat(resources[access.resource])), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+				barriers.push_back(barrier);
+
+				srcStages |= state.stages;
+				dstStages |= stages;
+
+				state.layout = layout;
+				state.stages = stages;
+				state.access = accessFlags;
+				state.written = write;
+			}
+
+			if (!resources[access.resource].imported)
+			{
+				MemoryBlock& block = memoryBlocks[transientImages[transientOfResource[access.resource]].block];
+				block.lastStages = state.stages;
+				block.lastAccess = state.access;
+			}
+		}
+
+		if (!barriers.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		}
+
+		std::optional<B3DGpuProfiler::Scope> zone;
+		if (profiler)
+		{
+			zone.emplace(*profiler, commandBuffer, pass.name);
+		}
+
+		PassContext context{ commandBuffer, compiledPass.renderPass, VK_NULL_HANDLE, compiledPass.extent, *this };
+
+		if (compiledPass.renderPass == VK_NULL_HANDLE)
+		{
+			if (pass.execute) pass.execute(context);
+			continue;
+		}
+
+		context.framebuffer = getFramebuffer(compiledPass);
+
+		std::vector<VkClearValue> clearValues{};
+		for (uint32_t index : compiledPass.attachmentAccesses)
+		{
+			clearValues.push_back(pass.accesses[index].clearValue);
+		}
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = compiledPass.renderPass;
+		renderPassInfo.framebuffer = context.framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = compiledPass.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, pass.contents);
+
+		//A subpass recorded from secondary buffers can't contain inline commands, each secondary sets its own state
+		if (pass.contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			VkViewport viewport{ 0.f, 0.f, static_cast<float>(compiledPass.extent.width), static_cast<float>(compiledPass.extent.height), 0.f, 1.f };
+			VkRect2D scissor{ { 0, 0 }, compiledPass.extent };
+
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		}
+
+		if (pass.execute) pass.execute(context);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	//Imported images are handed back in the layout their owner expects, whatever comes next waits on the graph's last use
+	std::vector<VkImageMemoryBarrier> finalBarriers{};
+	VkPipelineStageFlags srcStages = 0;
+
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		const Resource& resource = resources[i];
+		const ResourceState& state = states[i];
+
+		if (!resource.imported || (state.layout == resource.import.finalLayout && !state.written)) continue;
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = state.layout;
+		barrier.newLayout = resource.import.finalLayout;
+		barrier.srcAccessMask = state.written ? state.access : 0;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.import.image;
+		barrier.subresourceRange = { barrierAspect(resource.import.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+		finalBarriers.push_back(barrier);
+
+		srcStages |= state.stages;
+	}
+
+	if (!finalBarriers.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+	}
+}
+
+VkImage B3DRenderGraph::getImage(ResourceHandle resource) const
+{
+	assert(resource < resources.size() && "Unknown render graph resource!");
+
+	if (resources[resource].imported) return resources[resource].import.image;
+	if (resource >= transientOfResource.size() || transientOfResource[resource] == INVALID_HANDLE) return VK_NULL_HANDLE;
+
+	return transientImages[transientOfResource[resource]].image;
+}
+
+VkImageView B3DRenderGraph::getImageView(ResourceHandle resource) const
+{
+	assert(resource < resources.size() && "Unknown render graph resource!");
+
+	if (resources[resource].imported) return resources[resource].import.view;
+	if (resource >= transientOfResource.size() || transientOfResource[resource] == INVALID_HANDLE) return VK_NULL_HANDLE;
+
+	return transientImages[transientOfResource[resource]].view;
+}
+
+VkRenderPass B3DRenderGraph::getCompatibleRenderPass(const std::vector<VkFormat>& colorFormats, VkFormat depthFormat)
+{
+	std::vector<VkAttachmentDescription> attachments{};
+
+	for (VkFormat format : colorFormats)
+	{
+		VkAttachmentDescription attachment{};
+		attachment.format = format;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments.push_back(attachment);
+	}
+
+	const bool hasDepth = depthFormat != VK_FORMAT_UNDEFINED;
+	if (hasDepth)
+	{
+		VkAttachmentDescription attachment{};
+		attachment.format = depthFormat;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments.push_back(attachment);
+	}
+
+	//Compatibility only looks at formats and sample counts, so this matches every pass writing the same formats
+	return getRenderPass(attachments, static_cast<uint32_t>(colorFormats.size()), hasDepth, false);
+}
+
+size_t B3DRenderGraph::hashDeclarations() const
+{
+	size_t seed = 0;
+	B3DUtills::hashCombine(seed, renderExtent.width, renderExtent.height, resources.size(), passes.size());
+
+	for (const auto& resource : resources)
+	{
+		const VkExtent2D extent = resolveExtent(resource);
+		B3DUtills::hashCombine(seed, resource.imported, static_cast<uint32_t>(resourceFormat(resource)), extent.width, extent.height, resource.desc.extraUsage);
+
+		if (resource.imported)
+		{
+			B3DUtills::hashCombine(seed, static_cast<uint32_t>(resource.import.initialLayout), static_cast<uint32_t>(resource.import.finalLayout));
+		}
+	}
+
+	for (const auto& pass : passes)
+	{
+		B3DUtills::hashCombine(seed, pass.sideEffects, static_cast<uint32_t>(pass.contents), pass.accesses.size());
+
+		for (const auto& access : pass.accesses)
+		{
+			B3DUtills::hashCombine(seed, access.resource, static_cast<uint32_t>(access.type), access.shaderStages, access.clear);
+		}
+	}
+
+	return seed;
+}
+
+void B3DRenderGraph::compile()
+{
+	B3D_PROFILE_FUNCTION();
+
+	releaseCompiled();
+
+	const std::vector<bool> alive = cullPasses();
+
+	std::vector<PassHandle> order{};
+	for (PassHandle pass = 0; pass < passes.size(); pass++)
+	{
+		if (alive[pass]) order.push_back(pass);
+	}
+
+	culledPassCount = static_cast<uint32_t>(passes.size() - order.size());
+
+	allocateTransients(order);
+
+	for (uint32_t position = 0; position < order.size(); position++)
+	{
+		CompiledPass compiledPass{};
+		compiledPass.pass = order[position];
+		buildRenderPass(compiledPass, order, position);
+		compiledPasses.push_back(std::move(compiledPass));
+	}
+
+	compiled = true;
+
+	PLOGI << "Render graph compiled: " << order.size() << " passes, " << culledPassCount << " culled, " << transientImages.size() << " transient images in "
+		<< memoryBlocks.size() << " memory blocks (" << transientMemorySize / 1024 << " KB)";
+}
+
+void B3DRenderGraph::releaseCompiled()
+{
+	//Frames in flight may still use the old images and framebuffers
+	RetiredObjects retired{};
+	retired.releaseValue = graphDevice.getGraphicsTimeline().getFrameValue();
+
+	for (const auto& transient : transientImages)
+	{
+		retired.views.push_back(transient.view);
+		retired.images.push_back(transient.image);
+	}
+
+	for (const auto& block : memoryBlocks)
+	{
+		retired.memory.push_back(block.memory);
+	}
+
+	for (const auto& [key, cached] : framebufferCache)
+	{
+		retired.framebuffers.push_back(cached.framebuffer);
+	}
+
+	if (!retired.images.empty() || !retired.framebuffers.empty())
+	{
+		retiredObjects.push_back(std::move(retired));
+	}
+
+	framebufferCache.clear();
+	transientImages.clear();
+	transientOfResource.clear();
+	memoryBlocks.clear();
+	compiledPasses.clear();
+	transientMemorySize = 0;
+	culledPassCount = 0;
+	compiled = false;
+}
+
+void B3DRenderGraph::destroyRetired(const RetiredObjects& retired)
+{
+	for (auto framebuffer : retired.framebuffers)
+	{
+		vkDestroyFramebuffer(graphDevice.device(), framebuffer, nullptr);
+	}
+
+	for (auto view : retired.views)
+	{
+		vkDestroyImageView(graphDevice.device(), view, nullptr);
+	}
+
+	for (auto image : retired.images)
+	{
+		vkDestroyImage(graphDevice.device(), image, nullptr);
+	}
+
+	for (auto memory : retired.memory)
+	{
+		vkFreeMemory(graphDevice.device(), memory, nullptr);
+	}
+}
+
+std::vector<bool> B3DRenderGraph::cullPasses() const
+{
+	std::vector<bool> alive(passes.size(), false);
+
+	//Walking backwards, a resource is needed while a later surviving pass reads what is in it at this point
+	std::vector<bool> needed(resources.size(), false);
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		const Pass& pass = passes[i];
+		bool keep = pass.sideEffects;
+
+		for (const auto& access : pass.accesses)
+		{
+			if (isWrite(access.type) && (resources[access.resource].imported || needed[access.resource]))
+			{
+				keep = true;
+			}
+		}
+
+		if (!keep) continue;
+
+		alive[i] = true;
+
+		//A clear starts the contents over, anything that loads or reads needs whatever wrote it before
+		for (const auto& access : pass.accesses)
+		{
+			if (access.clear) needed[access.resource] = false;
+		}
+
+		for (const auto& access : pass.accesses)
+		{
+			if (!access.clear) needed[access.resource] = true;
+		}
+	}
+
+	return alive;
+}
+
+void B3DRenderGraph::allocateTransients(const std::vector<PassHandle>& order)
+{
+	//Lifetimes are in positions of the surviving passes
+	std::vector<std::pair<uint32_t, uint32_t>> lifetimes(resources.size(), { UINT32_MAX, 0 });
+	std::vector<VkImageUsageFlags> usages(resources.size(), 0);
+
+	for (uint32_t position = 0; position < order.size(); position++)
+	{
+		for (const auto& access : passes[order[position]].accesses)
+		{
+			auto& lifetime = lifetimes[access.resource];
+			lifetime.first = std::min(lifetime.first, position);
+			lifetime.second = std::max(lifetime.second, position);
+			usages[access.resource] |= imageUsage(access.type);
+		}
+	}
+
+	struct Candidate
+	{
+		ResourceHandle resource;
+		VkMemoryRequirements requirements;
+	};
+
+	std::vector<Candidate> candidates{};
+	transientOfResource.assign(resources.size(), INVALID_HANDLE);
+
+	for (ResourceHandle handle = 0; handle < resources.size(); handle++)
+	{
+		const Resource& resource = resources[handle];
+		if (resource.imported || lifetimes[handle].first == UINT32_MAX) continue;
+
+		const VkExtent2D extent = resolveExtent(resource);
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = extent.width;
+		imageInfo.extent.height = extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usages[handle] | resource.desc.extraUsage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		TransientImage transient{};
+
+		if (vkCreateImage(graphDevice.device(), &imageInfo, nullptr, &transient.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph image!");
+		}
+
+		transientOfResource[handle] = static_cast<uint32_t>(transientImages.size());
+		transientImages.push_back(transient);
+
+		Candidate candidate{ handle, {} };
+		vkGetImageMemoryRequirements(graphDevice.device(), transient.image, &candidate.requirements);
+		candidates.push_back(candidate);
+	}
+
+	//Biggest first, each image takes the first block big enough that no image alive at the same time is using
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.requirements.size > b.requirements.size; });
+
+	VkDeviceSize unaliasedSize = 0;
+
+	for (const auto& candidate : candidates)
+	{
+		const auto& lifetime = lifetimes[candidate.resource];
+		const auto& requirements = candidate.requirements;
+		uint32_t chosen = INVALID_HANDLE;
+
+		for (uint32_t blockIndex = 0; blockIndex < memoryBlocks.size(); blockIndex++)
+		{
+			const MemoryBlock& block = memoryBlocks[blockIndex];
+
+			if ((block.memoryTypeBits & requirements.memoryTypeBits) == 0 || block.size < requirements.size) continue;
+
+			bool overlaps = std::any_of(block.lifetimes.begin(), block.lifetimes.end(), [&](const std::pair<uint32_t, uint32_t>& other)
+			{
+				return other.first <= lifetime.second && lifetime.first <= other.second;
+			});
+
+			if (!overlaps)
+			{
+				chosen = blockIndex;
+				break;
+			}
+		}
+
+		if (chosen == INVALID_HANDLE)
+		{
+			MemoryBlock block{};
+			block.size = requirements.size;
+			block.memoryTypeBits = requirements.memoryTypeBits;
+			memoryBlocks.push_back(block);
+			chosen = static_cast<uint32_t>(memoryBlocks.size() - 1);
+		}
+
+		MemoryBlock& block = memoryBlocks[chosen];
+		block.memoryTypeBits &= requirements.memoryTypeBits;
+		block.lifetimes.push_back(lifetime);
+
+		transientImages[transientOfResource[candidate.resource]].block = chosen;
+		unaliasedSize += requirements.size;
+	}
+
+	for (auto& block : memoryBlocks)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = graphDevice.findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(graphDevice.device(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate render graph memory!");
+		}
+
+		transientMemorySize += block.size;
+	}
+
+	for (ResourceHandle handle = 0; handle < resources.size(); handle++)
+	{
+		if (transientOfResource[handle] == INVALID_HANDLE) continue;
+
+		TransientImage& transient = transientImages[transientOfResource[handle]];
+		const VkFormat format = resources[handle].desc.format;
+
+		//Every image starts at the block's base, the block was sized for its largest user
+		if (vkBindImageMemory(graphDevice.device(), transient.image, memoryBlocks[transient.block].memory, 0) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to bind render graph image memory!");
+		}
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = transient.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(graphDevice.device(), &viewInfo, nullptr, &transient.view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph image view!");
+		}
+	}
+
+	if (unaliasedSize > transientMemorySize)
+	{
+		PLOGI << "Render graph aliasing saves " << (unaliasedSize - transientMemorySize) / 1024 << " KB";
+	}
+}
+
+void B3DRenderGraph::buildRenderPass(CompiledPass& compiledPass, const std::vector<PassHandle>& order, uint32_t position)
+{
+	const Pass& pass = passes[compiledPass.pass];
+
+	uint32_t depthAccess = INVALID_HANDLE;
+
+	for (uint32_t index = 0; index < pass.accesses.size(); index++)
+	{
+		const AccessType type = pass.accesses[index].type;
+
+		if (type == AccessType::COLOR_WRITE)
+		{
+			compiledPass.attachmentAccesses.push_back(index);
+		}
+		else if (type == AccessType::DEPTH_WRITE || type == AccessType::DEPTH_READ)
+		{
+			assert(depthAccess == INVALID_HANDLE && "A render graph pass can only have one depth attachment!");
+			depthAccess = index;
+		}
+	}
+
+	const uint32_t colorCount = static_cast<uint32_t>(compiledPass.attachmentAccesses.size());
+	if (depthAccess != INVALID_HANDLE)
+	{
+		compiledPass.attachmentAccesses.push_back(depthAccess);
+	}
+
+	if (compiledPass.attachmentAccesses.empty()) return;
+
+	//Whether surviving passes touch a resource before or after this one decides what is loaded and stored
+	auto usedBetween = [&](ResourceHandle resource, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t other = begin; other < end; other++)
+		{
+			for (const auto& access : passes[order[other]].accesses)
+			{
+				if (access.resource == resource) return true;
+			}
+		}
+
+		return false;
+	};
+
+	std::vector<VkAttachmentDescription> attachments{};
+
+	for (uint32_t index : compiledPass.attachmentAccesses)
+	{
+		const Access& access = pass.accesses[index];
+		const Resource& resource = resources[access.resource];
+
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags accessFlags;
+		accessState(access, layout, stages, accessFlags);
+
+		const bool hasContents = usedBetween(access.resource, 0, position) || (resource.imported && resource.import.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+		const bool keepContents = resource.imported || usedBetween(access.resource, position + 1, static_cast<uint32_t>(order.size()));
+
+		VkAttachmentDescription attachment{};
+		attachment.format = resourceFormat(resource);
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = keepContents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		//The graph's barriers do the transitions, the render pass leaves layouts alone
+		attachment.initialLayout = layout;
+		attachment.finalLayout = layout;
+		attachments.push_back(attachment);
+
+		const VkExtent2D extent = resolveExtent(resource);
+		assert((compiledPass.extent.width == 0 || (compiledPass.extent.width == extent.width && compiledPass.extent.height == extent.height)) && "Render graph attachments must share an extent!");
+		compiledPass.extent = extent;
+	}
+
+	const bool depthReadOnly = depthAccess != INVALID_HANDLE && pass.accesses[depthAccess].type == AccessType::DEPTH_READ;
+	compiledPass.renderPass = getRenderPass(attachments, colorCount, depthAccess != INVALID_HANDLE, depthReadOnly);
+}
+
+VkRenderPass B3DRenderGraph::getRenderPass(const std::vector<VkAttachmentDescription>& attachments, uint32_t colorCount, bool hasDepth, bool depthReadOnly)
+{
+	std::vector<uint32_t> key{ colorCount, hasDepth, depthReadOnly };
+	for (const auto& attachment : attachments)
+	{
+		key.insert(key.end(), { static_cast<uint32_t>(attachment.format), static_cast<uint32_t>(attachment.loadOp), static_cast<uint32_t>(attachment.storeOp),
+			static_cast<uint32_t>(attachment.initialLayout), static_cast<uint32_t>(attachment.finalLayout) });
+	}
+
+	auto cached = renderPassCache.find(key);
+	if (cached != renderPassCache.end()) return cached->second;
+
+	std::vector<VkAttachmentReference> colorReferences{};
+	for (uint32_t i = 0; i < colorCount; i++)
+	{
+		colorReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+	}
+
+	VkAttachmentReference depthReference{ colorCount, depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = colorCount;
+	subpass.pColorAttachments = colorReferences.empty() ? nullptr : colorReferences.data();
+	subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+	//Barriers are recorded by the graph between passes, so no external dependencies are needed
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+
+	VkRenderPass renderPass;
+	if (vkCreateRenderPass(graphDevice.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create render graph render pass!");
+	}
+
+	renderPassCache.emplace(std::move(key), renderPass);
+	return renderPass;
+}
+
+VkFramebuffer B3DRenderGraph::getFramebuffer(const CompiledPass& compiledPass)
+{
+	const Pass& pass = passes[compiledPass.pass];
+
+	std::vector<VkImageView> views{};
+	std::vector<uint64_t> key{ handleValue(compiledPass.renderPass), compiledPass.extent.width, compiledPass.extent.height };
+
+	for (uint32_t index : compiledPass.attachmentAccesses)
+	{
+		const ResourceHandle resource = pass.accesses[index].resource;
+		const VkImageView view = getImageView(resource);
+
+		views.push_back(view);
+		key.push_back(handleValue(view));
+		key.push_back(resources[resource].imported ? resources[resource].import.generation : 0);
+	}
+
+	auto cached = framebufferCache.find(key);
+	if (cached != framebufferCache.end())
+	{
+		cached->second.lastUsedFrame = frameCounter;
+		return cached->second.framebuffer;
+	}
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = compiledPass.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = compiledPass.extent.width;
+	framebufferInfo.height = compiledPass.extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(graphDevice.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create render graph framebuffer!");
+	}
+
+	framebufferCache.emplace(std::move(key), CachedFramebuffer{ framebuffer, frameCounter });
+	return framebuffer;
+}
+
+VkExtent2D B3DRenderGraph::resolveExtent(const Resource& resource) const
+{
+	if (resource.imported) return resource.import.extent;
+	if (resource.desc.extent.width == 0 || resource.desc.extent.height == 0) return renderExtent;
+
+	return resource.desc.extent;
+}
+
+VkFormat B3DRenderGraph::resourceFormat(const Resource& resource) const
+{
+	return resource.imported ? resource.import.format : resource.desc.format;
+}
+
+bool B3DRenderGraph::isWrite(AccessType type)
+{
+	return type == AccessType::COLOR_WRITE || type == AccessType::DEPTH_WRITE || type == AccessType::TRANSFER_DST;
+}
+
+VkImageUsageFlags B3DRenderGraph::imageUsage(AccessType type)
+{
+	switch (type)
+	{
+		case AccessType::COLOR_WRITE: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case AccessType::DEPTH_WRITE:
+		case AccessType::DEPTH_READ: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case AccessType::SAMPLED: return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case AccessType::TRANSFER_SRC: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case AccessType::TRANSFER_DST: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	return 0;
+}
+
+void B3DRenderGraph::accessState(const Access& access, VkImageLayout& layout, VkPipelineStageFlags& stages, VkAccessFlags& accessFlags)
+{
+	switch (access.type)
+	{
+		case AccessType::COLOR_WRITE:
+			layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			accessFlags = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			break;
+		case AccessType::DEPTH_WRITE:
+			layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			accessFlags = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			break;
+		case AccessType::DEPTH_READ:
+			layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			accessFlags = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			break;
+		case AccessType::SAMPLED:
+			layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			stages = access.shaderStages;
+			accessFlags = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case AccessType::TRANSFER_SRC:
+			layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			accessFlags = VK_ACCESS_TRANSFER_READ_BIT;
+			break;
+		case AccessType::TRANSFER_DST:
+			layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			accessFlags = VK_ACCESS_TRANSFER_WRITE_BIT;
+			break;
+	}
+}
+
+bool B3DRenderGraph::isDepthFormat(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+VkImageAspectFlags B3DRenderGraph::barrierAspect(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
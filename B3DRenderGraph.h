@@ -0,0 +1,272 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DGpuProfiler.h"
+#include "B3DSwapChain.h"
+
+//Vulkan
+#include <vulkan/vulkan.h>
+
+//STD
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+//Frame graph for Based 3D.
+//Passes are declared every frame with what they read and write, then the graph culls passes nothing depends on, records the
+//barriers and layout transitions between them and builds their render passes and framebuffers. Images created by passes are
+//transient: they only live inside the frame and those whose lifetimes don't overlap share memory.
+//Compiled results are kept while the declarations stay the same, so an unchanged frame only pays for its barriers.
+class B3DRenderGraph
+{
+	public:
+
+		using ResourceHandle = uint32_t;
+		using PassHandle = uint32_t;
+
+		static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+		//Framebuffers unused for this many frames are destroyed, well past any frame still in flight
+		static constexpr uint64_t FRAMEBUFFER_EVICT_FRAMES = 16;
+
+		struct ImageDesc
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+
+			//0 by 0 follows the render extent given to beginFrame
+			VkExtent2D extent{ 0, 0 };
+
+			//Usage on top of what the graph works out from the passes
+			VkImageUsageFlags extraUsage = 0;
+		};
+
+		//An image the graph doesn't own, such as the swap chain image, in the layout it has on entry and the one it must be left in
+		struct ImportedImage
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkExtent2D extent{ 0, 0 };
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			//Bumped by the owner whenever its images are recreated, so framebuffers made from old views are never reused
+			uint64_t generation = 0;
+		};
+
+		struct PassContext
+		{
+			VkCommandBuffer commandBuffer;
+
+			//Null for passes without attachments
+			VkRenderPass renderPass;
+			VkFramebuffer framebuffer;
+			VkExtent2D extent;
+
+			const B3DRenderGraph& graph;
+		};
+
+		using ExecuteFunction = std::function<void(const PassContext&)>;
+
+		class PassBuilder
+		{
+			public:
+
+				ResourceHandle createImage(const char* name, const ImageDesc& desc);
+
+				//A null clear value keeps what earlier passes wrote
+				void writeColor(ResourceHandle image, const VkClearColorValue* clear = nullptr);
+				void writeDepth(ResourceHandle image, const VkClearDepthStencilValue* clear = nullptr);
+
+				//Depth testing against an earlier pass's depth without writing it
+				void readDepth(ResourceHandle image);
+
+				void sampleImage(ResourceHandle image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+				void copyFrom(ResourceHandle image);
+				void copyTo(ResourceHandle image);
+
+				//Keeps the pass even when nothing reads what it writes
+				void setSideEffects();
+				void setSubpassContents(VkSubpassContents contents);
+
+			private:
+
+				friend class B3DRenderGraph;
+
+				PassBuilder(B3DRenderGraph& graph, PassHandle pass) : graph{ graph }, pass{ pass } {}
+
+				B3DRenderGraph& graph;
+				PassHandle pass;
+		};
+
+		B3DRenderGraph(B3DDevice& device);
+		~B3DRenderGraph();
+
+		B3DRenderGraph(const B3DRenderGraph&) = delete;
+		B3DRenderGraph& operator=(const B3DRenderGraph&) = delete;
+
+		//Call after B3DRenderer::beginFrame, drops the last frame's declarations
+		void beginFrame(VkExtent2D renderExtent);
+
+		ResourceHandle importImage(const char* name, const ImportedImage& image);
+
+		//Setup runs straight away, execute runs inside the pass's render pass during execute if the pass survives culling.
+		//The name is kept for GPU profiler zones, so it must outlive the graph
+		PassHandle addPass(const char* name, const std::function<void(PassBuilder&)>& setup, ExecuteFunction execute);
+
+		//Compiles if the declarations changed, then records every pass into the command buffer
+		void execute(VkCommandBuffer commandBuffer, B3DGpuProfiler* profiler = nullptr);
+
+		VkImage getImage(ResourceHandle resource) const;
+		VkImageView getImageView(ResourceHandle resource) const;
+
+		//A render pass compatible with the one the graph builds for a pass writing these formats, pipelines are created against it
+		VkRenderPass getCompatibleRenderPass(const std::vector<VkFormat>& colorFormats, VkFormat depthFormat);
+
+		uint32_t getCulledPassCount() const { return culledPassCount; }
+		VkDeviceSize getTransientMemorySize() const { return transientMemorySize; }
+
+	private:
+
+		enum class AccessType : uint8_t
+		{
+			COLOR_WRITE,
+			DEPTH_WRITE,
+			DEPTH_READ,
+			SAMPLED,
+			TRANSFER_SRC,
+			TRANSFER_DST
+		};
+
+		struct Access
+		{
+			ResourceHandle resource;
+			AccessType type;
+			VkPipelineStageFlags shaderStages = 0;
+			bool clear = false;
+			VkClearValue clearValue{};
+		};
+
+		struct Pass
+		{
+			const char* name;
+			std::vector<Access> accesses;
+			ExecuteFunction execute;
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+			bool sideEffects = false;
+		};
+
+		struct Resource
+		{
+			const char* name;
+			bool imported = false;
+			ImageDesc desc{};
+			ImportedImage import{};
+		};
+
+		//Layout and last use of an image while a frame is recorded
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags access = 0;
+			bool written = false;
+
+			//Transients pick up their memory block's state at their first access, after any image aliasing it earlier in the frame
+			bool awaitingBlock = false;
+		};
+
+		struct TransientImage
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			uint32_t block = 0;
+		};
+
+		//Memory shared by transient images whose lifetimes don't overlap, with the last use of whichever image touched it last
+		struct MemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = 0;
+			std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+
+			VkPipelineStageFlags lastStages = 0;
+			VkAccessFlags lastAccess = 0;
+		};
+
+		struct CompiledPass
+		{
+			PassHandle pass;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+
+			//Indices into the pass's accesses, colors first and depth last
+			std::vector<uint32_t> attachmentAccesses;
+			VkExtent2D extent{ 0, 0 };
+		};
+
+		struct CachedFramebuffer
+		{
+			VkFramebuffer framebuffer;
+			uint64_t lastUsedFrame;
+		};
+
+		struct RetiredObjects
+		{
+			std::vector<VkImageView> views;
+			std::vector<VkImage> images;
+			std::vector<VkDeviceMemory> memory;
+			std::vector<VkFramebuffer> framebuffers;
+
+			//Graphics timeline value of the last frame that could use them
+			uint64_t releaseValue;
+		};
+
+		B3DDevice& graphDevice;
+
+		//This frame's declarations
+		VkExtent2D renderExtent{ 0, 0 };
+		std::vector<Pass> passes;
+		std::vector<Resource> resources;
+
+		//Kept between frames while the declarations hash the same
+		size_t compiledHash = 0;
+		bool compiled = false;
+		std::vector<CompiledPass> compiledPasses;
+		std::vector<TransientImage> transientImages;
+		std::vector<uint32_t> transientOfResource;
+		std::vector<MemoryBlock> memoryBlocks;
+		uint32_t culledPassCount = 0;
+		VkDeviceSize transientMemorySize = 0;
+
+		std::map<std::vector<uint32_t>, VkRenderPass> renderPassCache;
+		std::map<std::vector<uint64_t>, CachedFramebuffer> framebufferCache;
+		std::vector<RetiredObjects> retiredObjects;
+		uint64_t frameCounter = 0;
+
+		void addAccess(PassHandle pass, ResourceHandle resource, AccessType type, VkPipelineStageFlags shaderStages, const VkClearValue* clear);
+
+		size_t hashDeclarations() const;
+		void compile();
+		void releaseCompiled();
+		void destroyRetired(const RetiredObjects& retired);
+
+		std::vector<bool> cullPasses() const;
+		void allocateTransients(const std::vector<PassHandle>& order);
+		void buildRenderPass(CompiledPass& compiledPass, const std::vector<PassHandle>& order, uint32_t position);
+
+		VkRenderPass getRenderPass(const std::vector<VkAttachmentDescription>& attachments, uint32_t colorCount, bool hasDepth, bool depthReadOnly);
+		VkFramebuffer getFramebuffer(const CompiledPass& compiledPass);
+
+		VkExtent2D resolveExtent(const Resource& resource) const;
+		VkFormat resourceFormat(const Resource& resource) const;
+
+		static bool isWrite(AccessType type);
+		static VkImageUsageFlags imageUsage(AccessType type);
+		static void accessState(const Access& access, VkImageLayout& layout, VkPipelineStageFlags& stages, VkAccessFlags& accessFlags);
+		static bool isDepthFormat(VkFormat format);
+		static VkImageAspectFlags barrierAspect(VkFormat format);
+};
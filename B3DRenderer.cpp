@@ -1,15 +1,29 @@
 #include "B3DRenderer.h"
+#include <algorithm>
 #include <iostream>
 
 
-B3DRenderer::B3DRenderer(B3DWindow &window, B3DDevice &device) : rendererWindow{window}, rendererDevice{device}
+B3DRenderer::B3DRenderer(B3DWindow &window, B3DDevice &device, const FramePacingPolicy &policy) : B3DRenderer{ &window, device, window.getExtent(), policy } {}
+
+B3DRenderer::B3DRenderer(B3DWindow* window, B3DDevice& device, VkExtent2D headlessExtent, const FramePacingPolicy& policy) : rendererWindow{ window }, headlessExtent{ headlessExtent }, rendererDevice{ device }
 {
-	recreateSwapChain();
+	assert((window == nullptr) == device.isHeadless() && "Renderer and device must agree on whether there is a window!");
+
+	framePacer.setPolicy(policy);
+
+	//Nothing can be rendered without a first swap chain, so a window that opens minimized is waited on here
+	while (!recreateSwapChain())
+	{
+		glfwWaitEvents();
+	}
+
 	createCommandBuffers();
+	createSecondaryCommandBuffers();
 }
 
 B3DRenderer::~B3DRenderer()
 {
+	destroySecondaryCommandBuffers();
 	freeCommandBuffers();
 }
 
@@ -17,6 +31,13 @@ VkCommandBuffer B3DRenderer::beginFrame()
 {
 	assert(!isFrameStarted && "Can't begin frame while one is in progess!");
 
+	//Control goes back to the game loop while minimized, rather than blocking in here until the window comes back
+	if (swapChainOutdated && !recreateSwapChain())
+	{
+		glfwWaitEventsTimeout(MINIMIZED_WAIT_SECONDS);
+		return nullptr;
+	}
+
 	auto result = rendererSwapChain->acquireNextImage(&currentImageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -31,6 +52,16 @@ VkCommandBuffer B3DRenderer::beginFrame()
 	}
 
 	isFrameStarted = true;
+	B3D_PROFILE_FRAME_BEGIN();
+
+	releaseRetiredSwapChains();
+
+	//The slot's last submit has been waited on, so nothing recorded from these pools is still executing
+	for (auto& slot : recordingSlots[currentFrameIndex])
+	{
+		vkResetCommandPool(rendererDevice.device(), slot.pool, 0);
+		slot.buffersUsed = 0;
+	}
 
 	auto commandBuffer = getCurrentCommandBuffer();
 
@@ -57,11 +88,22 @@ void B3DRenderer::endFrame()
 	}
 
 
-	auto result = rendererSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+	VkResult result;
+	{
+		B3D_PROFILE_SCOPE("Submit and present");
+
+		rendererSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		framePacer.markSubmitted();
+
+		result = rendererSwapChain->presentImage(&currentImageIndex);
+		framePacer.markPresented();
+	}
+
+	bool windowResized = !isHeadless() && rendererWindow->wasWindowResized();
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || rendererWindow.wasWindowResized())
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || windowResized)
 	{
-		rendererWindow.resetWindowResizedFlag();
+		if (windowResized) rendererWindow->resetWindowResizedFlag();
 		recreateSwapChain();
 	}
 	else if (result != VK_SUCCESS)
@@ -70,53 +112,108 @@ void B3DRenderer::endFrame()
 	}
 
 	isFrameStarted = false;
-	currentFrameIndex = (currentFrameIndex + 1) % B3DSwapChain::MAX_FRAMES_IN_FLIGHT;
+	B3D_PROFILE_FRAME_END();
+	currentFrameIndex = (currentFrameIndex + 1) % static_cast<int>(rendererSwapChain->getFramesInFlight());
 }
 
-void B3DRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+void B3DRenderer::setFramePacingPolicy(const FramePacingPolicy& policy)
 {
-	assert(isFrameStarted && "Can't begin a render pass if no frames are started!");
-	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot perform a render pass on a different frame!");
+	assert(!isFrameStarted && "Can't change the frame pacing policy while a frame is in progress!");
+
+	//A new frames in flight count can't take over the old sync objects, so everything in flight is finished first
+	vkDeviceWaitIdle(rendererDevice.device());
+
+	framePacer.setPolicy(policy);
+	recreateSwapChain();
+
+	//The GPU is idle, so nothing is left for the old swap chains to wait on
+	retiredSwapChains.clear();
+
+	//The new swap chain starts its sync objects from slot 0, so the per-frame resources have to follow
+	currentFrameIndex = 0;
+}
+
+VkCommandBuffer B3DRenderer::beginSecondaryCommandBuffer(uint32_t recordingThread, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent)
+{
+	assert(isFrameStarted && "Can't begin a secondary command buffer if no frames are started!");
+	assert(recordingThread < recordingThreadCount && "Recording thread index out of range!");
+
+	RecordingSlot& slot = recordingSlots[currentFrameIndex][recordingThread];
+
+	//Slots start with one buffer, frames recording several passes from the same slot grow it once and keep the extra buffers
+	if (slot.buffersUsed == slot.buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = slot.pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer newBuffer;
+		if (vkAllocateCommandBuffers(rendererDevice.device(), &allocInfo, &newBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate secondary command buffers!");
+		}
+
+		slot.buffers.push_back(newBuffer);
+	}
+
+	auto commandBuffer = slot.buffers[slot.buffersUsed++];
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin secondary command buffer recording!");
+	}
+
+	setViewportAndScissor(commandBuffer, extent);
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = rendererSwapChain->getRenderPass();
-	renderPassInfo.framebuffer = rendererSwapChain->getFrameBuffer(currentImageIndex);
+	return commandBuffer;
+}
 
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = rendererSwapChain->getSwapChainExtent();
+void B3DRenderer::endSecondaryCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end secondary command buffer recording!");
+	}
+}
 
-	std::array<VkClearValue, 2> clearValues{};
-	clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-	clearValues[1].depthStencil = { 1.0f, 0 };
+void B3DRenderer::executeSecondaryCommandBuffers(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer>& secondaryBuffers)
+{
+	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot execute secondary command buffers on a different frame!");
 
-	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderPassInfo.pClearValues = clearValues.data();
+	if (secondaryBuffers.empty()) return;
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+}
 
+void B3DRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(rendererSwapChain->getSwapChainExtent().width);
-	viewport.height = static_cast<float>(rendererSwapChain->getSwapChainExtent().height);
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 
-	VkRect2D scissor{ {0, 0}, rendererSwapChain->getSwapChainExtent() };
+	VkRect2D scissor{ {0, 0}, extent };
 
 	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
-void B3DRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
-{
-	assert(isFrameStarted && "Can't end a render pass if no frames are started!");
-	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot end a render pass on a different frame!");
-
-	vkCmdEndRenderPass(commandBuffer);
-}
-
 void B3DRenderer::createCommandBuffers()
 {
 	commandBuffers.resize(B3DSwapChain::MAX_FRAMES_IN_FLIGHT);
@@ -139,31 +236,112 @@ void B3DRenderer::freeCommandBuffers()
 	commandBuffers.clear();
 }
 
-
-void B3DRenderer::recreateSwapChain()
+void B3DRenderer::createSecondaryCommandBuffers()
 {
-	auto extent = rendererWindow.getExtent();
+	recordingThreadCount = std::max(1u, std::min(MAX_RECORDING_THREADS, std::thread::hardware_concurrency()));
 
-	while (extent.width == 0 || extent.height == 0)
+	recordingSlots.resize(B3DSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+	QueueFamilyInices queueFamilyIndices = rendererDevice.findPhysicalQueueFamilies();
+
+	for (size_t frame = 0; frame < B3DSwapChain::MAX_FRAMES_IN_FLIGHT; frame++)
 	{
-		extent = rendererWindow.getExtent();
-		glfwWaitEvents();
+		recordingSlots[frame].resize(recordingThreadCount);
+
+		for (uint32_t thread = 0; thread < recordingThreadCount; thread++)
+		{
+			RecordingSlot& slot = recordingSlots[frame][thread];
+
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			if (vkCreateCommandPool(rendererDevice.device(), &poolInfo, nullptr, &slot.pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create secondary command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = slot.pool;
+			allocInfo.commandBufferCount = 1;
+
+			slot.buffers.resize(1);
+			if (vkAllocateCommandBuffers(rendererDevice.device(), &allocInfo, slot.buffers.data()) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate secondary command buffers!");
+			}
+		}
 	}
 
-	vkDeviceWaitIdle(rendererDevice.device());
+	PLOGI << "Recording threads: " << recordingThreadCount;
+}
+
+void B3DRenderer::destroySecondaryCommandBuffers()
+{
+	//Destroying a pool frees every buffer allocated from it
+	for (auto& frameSlots : recordingSlots)
+	{
+		for (auto& slot : frameSlots)
+		{
+			vkDestroyCommandPool(rendererDevice.device(), slot.pool, nullptr);
+		}
+	}
+
+	recordingSlots.clear();
+}
+
+
+bool B3DRenderer::recreateSwapChain()
+{
+	B3D_PROFILE_FUNCTION();
+
+	auto extent = isHeadless() ? headlessExtent : rendererWindow->getExtent();
+
+	//A minimized window can't have a swap chain, beginFrame tries again every frame until it has an area
+	if (extent.width == 0 || extent.height == 0)
+	{
+		swapChainOutdated = true;
+		return false;
+	}
 
 	if (rendererSwapChain == nullptr)
 	{
-		rendererSwapChain = std::make_unique<B3DSwapChain>(rendererDevice, extent);
+		rendererSwapChain = std::make_unique<B3DSwapChain>(rendererDevice, extent, framePacer.getPolicy());
 	}
 	else
 	{
+		//The old swap chain is handed to the driver so it can reuse its images, and then kept until the frames still in
+		//flight on it are done. Framebuffers and depth are rebuilt and retired by the render graph when the extent changes
 		std::shared_ptr<B3DSwapChain> oldSwapChain = std::move(rendererSwapChain);
-		rendererSwapChain = std::make_unique<B3DSwapChain>(rendererDevice, extent, oldSwapChain);
+		rendererSwapChain = std::make_unique<B3DSwapChain>(rendererDevice, extent, framePacer.getPolicy(), oldSwapChain);
 
 		if (!oldSwapChain->compareSwapFormats(*rendererSwapChain.get()))
 		{
 			throw std::runtime_error("Swap chain image or depth format has changed!");
 		}
+
+		//Waiting for the frames after the old swap chain's last one to finish too gives the presentation engine time to let
+		//go of its images
+		B3DTimeline& timeline = rendererDevice.getGraphicsTimeline();
+		retiredSwapChains.push_back({ std::move(oldSwapChain), timeline.getFrameValue(B3DSwapChain::MAX_FRAMES_IN_FLIGHT - 1) });
+	}
+
+	framePacer.setPresentMode(rendererSwapChain->getPresentMode());
+	swapChainGeneration++;
+	swapChainOutdated = false;
+
+	return true;
+}
+
+void B3DRenderer::releaseRetiredSwapChains()
+{
+	B3DTimeline& timeline = rendererDevice.getGraphicsTimeline();
+
+	while (!retiredSwapChains.empty() && timeline.isComplete(retiredSwapChains.front().releaseValue))
+	{
+		retiredSwapChains.pop_front();
 	}
 }
\ No newline at end of file
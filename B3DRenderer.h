@@ -3,30 +3,51 @@
 //Local
 #include "B3DDevice.h"
 #include "B3DSwapChain.h"
+#include "B3DFramePacing.h"
+#include "B3DProfiler.h"
 #include "B3DWindow.h"
 
 //STD
 #include <cassert>
+#include <deque>
 #include <memory>
+#include <thread>
 #include <vector>
 
 class B3DRenderer
 {
 	public:
 
-		B3DRenderer(B3DWindow &window, B3DDevice &device);
+		static constexpr uint32_t MAX_RECORDING_THREADS = 8;
+
+		//How long beginFrame waits for window events while minimized before handing control back without a frame
+		static constexpr double MINIMIZED_WAIT_SECONDS = 0.1;
+
+		B3DRenderer(B3DWindow &window, B3DDevice &device, const FramePacingPolicy &policy = FramePacingPolicy{});
+
+		//A null window renders headless into offscreen images of the given extent, the device must be headless too
+		B3DRenderer(B3DWindow* window, B3DDevice& device, VkExtent2D headlessExtent, const FramePacingPolicy& policy = FramePacingPolicy{});
 		~B3DRenderer();
 
 		B3DRenderer(const B3DRenderer&) = delete;
 		B3DRenderer& operator=(const B3DRenderer&) = delete;
 
+		//Null if there is no frame to render, such as while the window is minimized or the swap chain was just rebuilt
 		VkCommandBuffer beginFrame();
 		void endFrame();
 
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		//Secondaries continue a render pass begun by B3DRenderGraph, so they inherit its render pass and framebuffer
+		VkCommandBuffer beginSecondaryCommandBuffer(uint32_t recordingThread, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+		void endSecondaryCommandBuffer(VkCommandBuffer commandBuffer);
+		void executeSecondaryCommandBuffers(VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer>& secondaryBuffers);
+
+		//Rebuilds the swap chain, so it waits for the GPU to go idle
+		void setFramePacingPolicy(const FramePacingPolicy& policy);
+		B3DFramePacer& getFramePacer() { return framePacer; }
+		uint32_t getFramesInFlight() const { return rendererSwapChain->getFramesInFlight(); }
 
 		bool isFrameInProgress() const { return isFrameStarted; }
+		uint32_t getRecordingThreadCount() const { return recordingThreadCount; }
 
 		int getFrameIndex() const
 		{
@@ -34,8 +55,29 @@ class B3DRenderer
 			return currentFrameIndex;
 		}
 
-		VkRenderPass getSwapChainRenderPass() const { return rendererSwapChain->getRenderPass(); }
+		bool isHeadless() const { return rendererWindow == nullptr; }
+
 		float getAspectRatio() const { return rendererSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return rendererSwapChain->getSwapChainExtent(); }
+		VkFormat getSwapChainImageFormat() const { return rendererSwapChain->getSwapChainImageFormat(); }
+		VkFormat getDepthFormat() const { return rendererSwapChain->getDepthFormat(); }
+
+		//Changes every time the swap chain is rebuilt, anything made from its image views must be made again
+		uint64_t getSwapChainGeneration() const { return swapChainGeneration; }
+		VkImageLayout getSwapChainFinalLayout() const { return rendererSwapChain->getFinalLayout(); }
+		bool supportsReadback() const { return rendererSwapChain->supportsReadback(); }
+
+		VkImage getCurrentSwapChainImage() const
+		{
+			assert(isFrameStarted && "Cannot get swap chain image when frame not in progress");
+			return rendererSwapChain->getImage(currentImageIndex);
+		}
+
+		VkImageView getCurrentSwapChainImageView() const
+		{
+			assert(isFrameStarted && "Cannot get swap chain image view when frame not in progress");
+			return rendererSwapChain->getImageView(currentImageIndex);
+		}
 
 		VkCommandBuffer getCurrentCommandBuffer() const
 		{
@@ -45,16 +87,48 @@ class B3DRenderer
 
 	private:
 
-		B3DWindow &rendererWindow;
+		B3DWindow* rendererWindow;
+		VkExtent2D headlessExtent;
 		B3DDevice &rendererDevice;
 		std::unique_ptr<B3DSwapChain> rendererSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
+		B3DFramePacer framePacer;
+
+		//A recording slot hands out a fresh buffer to every pass recorded from it in a frame, since re-recording one the
+		//primary already executes would invalidate the primary
+		struct RecordingSlot
+		{
+			VkCommandPool pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> buffers;
+			uint32_t buffersUsed = 0;
+		};
+
+		//Indexed by [frame][recording slot], each recording job owns one slot's pool so no locking is needed
+		std::vector<std::vector<RecordingSlot>> recordingSlots;
+		uint32_t recordingThreadCount = 1;
+
+		//Replaced swap chains wait here until the graphics timeline passes the frames that used their images
+		struct RetiredSwapChain
+		{
+			std::shared_ptr<B3DSwapChain> swapChain;
+			uint64_t releaseValue;
+		};
+
+		std::deque<RetiredSwapChain> retiredSwapChains;
 
 		uint32_t currentImageIndex;
+		uint64_t swapChainGeneration = 0;
 		int currentFrameIndex = 0;
 		bool isFrameStarted = false;
 
+		//Set when the swap chain couldn't be rebuilt because the window has no area
+		bool swapChainOutdated = false;
+
 		void createCommandBuffers();
 		void freeCommandBuffers();
-		void recreateSwapChain();
+		void createSecondaryCommandBuffers();
+		void destroySecondaryCommandBuffers();
+		void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
+		bool recreateSwapChain();
+		void releaseRetiredSwapChains();
 };
\ No newline at end of file
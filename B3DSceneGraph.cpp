@@ -0,0 +1,288 @@
+#include "B3DSceneGraph.h"
+
+//STD
+#include <algorithm>
+
+B3DSceneGraph::node_t B3DSceneGraph::createNode(node_t parent)
+{
+	assert((parent == INVALID_NODE || isValid(parent)) && "Parent node does not exist!");
+
+	node_t node;
+
+	if (!freeHandles.empty())
+	{
+		node = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		node = static_cast<node_t>(handleToIndex.size());
+		handleToIndex.push_back(INVALID_INDEX);
+		handleParents.push_back(INVALID_NODE);
+	}
+
+	handleToIndex[node] = static_cast<uint32_t>(indexToHandle.size());
+	handleParents[node] = parent;
+
+	indexToHandle.push_back(node);
+	parentIndices.push_back(INVALID_INDEX);
+	subtreeEnds.push_back(static_cast<uint32_t>(indexToHandle.size()));
+	flags.push_back(LOCAL_DIRTY);
+	updatedOn.push_back(0);
+	localTransforms.push_back(TransformComponent{});
+	worldMatrices.push_back(glm::mat4{ 1.f });
+	normalMatrices.push_back(glm::mat3{ 1.f });
+
+	topologyDirty = true;
+
+	return node;
+}
+
+void B3DSceneGraph::destroyNode(node_t node)
+{
+	assert(isValid(node) && "Cannot destroy a node that does not exist!");
+
+	if (topologyDirty)
+	{
+		rebuildOrder();
+	}
+
+	const uint32_t begin = handleToIndex[node];
+	const uint32_t end = subtreeEnds[begin];
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		node_t handle = indexToHandle[i];
+		handleToIndex[handle] = INVALID_INDEX;
+		handleParents[handle] = INVALID_NODE;
+		freeHandles.push_back(handle);
+	}
+
+	topologyDirty = true;
+}
+
+void B3DSceneGraph::setParent(node_t node, node_t parent)
+{
+	assert(isValid(node) && "Cannot parent a node that does not exist!");
+	assert((parent == INVALID_NODE || isValid(parent)) && "Parent node does not exist!");
+
+	for (node_t ancestor = parent; ancestor != INVALID_NODE; ancestor = handleParents[ancestor])
+	{
+		if (ancestor == node)
+		{
+			throw std::runtime_error("Cannot parent a scene node to one of its own descendants!");
+		}
+	}
+
+	handleParents[node] = parent;
+	topologyDirty = true;
+}
+
+TransformComponent& B3DSceneGraph::editLocalTransform(node_t node)
+{
+	uint32_t index = indexOf(node);
+	markDirty(index);
+
+	return localTransforms[index];
+}
+
+void B3DSceneGraph::update()
+{
+	if (topologyDirty)
+	{
+		rebuildOrder();
+	}
+
+	updateCount++;
+	updateRange(0, static_cast<uint32_t>(nodeCount()));
+}
+
+void B3DSceneGraph::update(B3DJobSystem& jobSystem)
+{
+	if (nodeCount() < PARALLEL_NODE_THRESHOLD || jobSystem.threadCount() == 1)
+	{
+		update();
+		return;
+	}
+
+	if (topologyDirty)
+	{
+		rebuildOrder();
+	}
+
+	updateCount++;
+
+	//Roots own contiguous, independent ranges, so batches of whole roots can be propagated concurrently.
+	const uint32_t count = static_cast<uint32_t>(nodeCount());
+	const uint32_t nodesPerBatch = std::max(PARALLEL_NODE_THRESHOLD / 4, count / (jobSystem.threadCount() * 4));
+
+	auto batches = jobSystem.createCounter();
+	uint32_t batchBegin = 0;
+
+	for (uint32_t root : rootIndices)
+	{
+		uint32_t rootEnd = subtreeEnds[root];
+
+		if (rootEnd - batchBegin >= nodesPerBatch || rootEnd == count)
+		{
+			jobSystem.run([this, batchBegin, rootEnd]() { updateRange(batchBegin, rootEnd); }, "Scene graph update", batches);
+			batchBegin = rootEnd;
+		}
+	}
+
+	jobSystem.wait(batches);
+}
+
+void B3DSceneGraph::markDirty(uint32_t index)
+{
+	flags[index] |= LOCAL_DIRTY;
+
+	//A rebuild recomputes every node, so ancestors only need flagging while the order is valid.
+	if (topologyDirty) return;
+
+	for (uint32_t parent = parentIndices[index]; parent != INVALID_INDEX && !(flags[parent] & SUBTREE_DIRTY); parent = parentIndices[parent])
+	{
+		flags[parent] |= SUBTREE_DIRTY;
+	}
+}
+
+void B3DSceneGraph::rebuildOrder()
+{
+	const size_t handleCount = handleToIndex.size();
+
+	std::vector<node_t> firstChild(handleCount, INVALID_NODE);
+	std::vector<node_t> nextSibling(handleCount, INVALID_NODE);
+	std::vector<node_t> roots;
+
+	for (size_t i = handleCount; i-- > 0;)
+	{
+		node_t handle = static_cast<node_t>(i);
+
+		if (handleToIndex[handle] == INVALID_INDEX) continue;
+
+		node_t parent = handleParents[handle];
+
+		if (parent == INVALID_NODE)
+		{
+			roots.push_back(handle);
+		}
+		else
+		{
+			nextSibling[handle] = firstChild[parent];
+			firstChild[parent] = handle;
+		}
+	}
+
+	std::vector<node_t> order;
+	order.reserve(handleCount);
+
+	std::vector<node_t> stack(roots.begin(), roots.end());
+
+	while (!stack.empty())
+	{
+		node_t handle = stack.back();
+		stack.pop_back();
+		order.push_back(handle);
+
+		size_t firstPushed = stack.size();
+		for (node_t child = firstChild[handle]; child != INVALID_NODE; child = nextSibling[child])
+		{
+			stack.push_back(child);
+		}
+		std::reverse(stack.begin() + firstPushed, stack.end());
+	}
+
+	const uint32_t count = static_cast<uint32_t>(order.size());
+
+	std::vector<uint32_t> newParentIndices(count);
+	std::vector<uint32_t> newSubtreeEnds(count);
+	std::vector<uint32_t> newUpdatedOn(count);
+	std::vector<TransformComponent> newLocalTransforms(count);
+	std::vector<glm::mat4> newWorldMatrices(count);
+	std::vector<glm::mat3> newNormalMatrices(count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t oldIndex = handleToIndex[order[i]];
+
+		newUpdatedOn[i] = updatedOn[oldIndex];
+		newLocalTransforms[i] = localTransforms[oldIndex];
+		newWorldMatrices[i] = worldMatrices[oldIndex];
+		newNormalMatrices[i] = normalMatrices[oldIndex];
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		handleToIndex[order[i]] = i;
+	}
+
+	rootIndices.clear();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		node_t parent = handleParents[order[i]];
+		newParentIndices[i] = parent == INVALID_NODE ? INVALID_INDEX : handleToIndex[parent];
+		newSubtreeEnds[i] = i + 1;
+
+		if (parent == INVALID_NODE)
+		{
+			rootIndices.push_back(i);
+		}
+	}
+
+	//Children always sit after their parent, so walking backwards folds every subtree end into its parent.
+	for (uint32_t i = count; i-- > 0;)
+	{
+		if (newParentIndices[i] != INVALID_INDEX)
+		{
+			newSubtreeEnds[newParentIndices[i]] = std::max(newSubtreeEnds[newParentIndices[i]], newSubtreeEnds[i]);
+		}
+	}
+
+	indexToHandle = std::move(order);
+	parentIndices = std::move(newParentIndices);
+	subtreeEnds = std::move(newSubtreeEnds);
+	updatedOn = std::move(newUpdatedOn);
+	localTransforms = std::move(newLocalTransforms);
+	worldMatrices = std::move(newWorldMatrices);
+	normalMatrices = std::move(newNormalMatrices);
+	flags.assign(count, LOCAL_DIRTY);
+
+	topologyDirty = false;
+}
+
+void B3DSceneGraph::updateRange(uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end;)
+	{
+		const uint32_t parent = parentIndices[i];
+		const bool parentUpdated = parent != INVALID_INDEX && updatedOn[parent] == updateCount;
+
+		if (!parentUpdated && (flags[i] & (LOCAL_DIRTY | SUBTREE_DIRTY)) == 0)
+		{
+			i = subtreeEnds[i];
+			continue;
+		}
+
+		if (parentUpdated || (flags[i] & LOCAL_DIRTY))
+		{
+			const TransformComponent& local = localTransforms[i];
+
+			if (parent == INVALID_INDEX)
+			{
+				worldMatrices[i] = local.mat4();
+				normalMatrices[i] = local.normalMatrix();
+			}
+			else
+			{
+				worldMatrices[i] = worldMatrices[parent] * local.mat4();
+				normalMatrices[i] = normalMatrices[parent] * local.normalMatrix();
+			}
+
+			updatedOn[i] = updateCount;
+		}
+
+		flags[i] = 0;
+		i++;
+	}
+}
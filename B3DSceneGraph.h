@@ -0,0 +1,90 @@
+#pragma once
+
+//Local
+#include "B3DTransform.h"
+#include "B3DJobSystem.h"
+
+//STD
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+//Parent/child transform hierarchy for Based 3D.
+//Nodes are kept in depth-first order so every parent comes before its children and every subtree is a contiguous range.
+//World matrices are propagated in one linear pass that skips subtrees with nothing dirty in them.
+class B3DSceneGraph
+{
+	public:
+
+		using node_t = uint32_t;
+
+		static constexpr node_t INVALID_NODE = std::numeric_limits<node_t>::max();
+		static constexpr uint32_t PARALLEL_NODE_THRESHOLD = 4096;
+
+		B3DSceneGraph() = default;
+		~B3DSceneGraph() = default;
+
+		B3DSceneGraph(const B3DSceneGraph&) = delete;
+		B3DSceneGraph& operator=(const B3DSceneGraph&) = delete;
+
+		node_t createNode(node_t parent = INVALID_NODE);
+		void destroyNode(node_t node);
+		void setParent(node_t node, node_t parent);
+
+		bool isValid(node_t node) const { return node < handleToIndex.size() && handleToIndex[node] != INVALID_INDEX; }
+		node_t getParent(node_t node) const { return handleParents[node]; }
+		size_t nodeCount() const { return indexToHandle.size(); }
+
+		const TransformComponent& getLocalTransform(node_t node) const { return localTransforms[indexOf(node)]; }
+		TransformComponent& editLocalTransform(node_t node);
+		void setLocalTransform(node_t node, const TransformComponent& transform) { editLocalTransform(node) = transform; }
+
+		const glm::mat4& getWorldMatrix(node_t node) const { return worldMatrices[indexOf(node)]; }
+		const glm::mat3& getNormalMatrix(node_t node) const { return normalMatrices[indexOf(node)]; }
+		bool wasUpdated(node_t node) const { return updatedOn[indexOf(node)] == updateCount; }
+
+		void update();
+		void update(B3DJobSystem& jobSystem);
+
+	private:
+
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		enum NodeFlags : uint8_t
+		{
+			LOCAL_DIRTY = 1 << 0,
+			SUBTREE_DIRTY = 1 << 1,
+		};
+
+		//Indexed by handle
+		std::vector<uint32_t> handleToIndex;
+		std::vector<node_t> handleParents;
+		std::vector<node_t> freeHandles;
+
+		//Indexed by depth-first position
+		std::vector<node_t> indexToHandle;
+		std::vector<uint32_t> parentIndices;
+		std::vector<uint32_t> subtreeEnds;
+		std::vector<uint8_t> flags;
+		std::vector<uint32_t> updatedOn;
+		std::vector<TransformComponent> localTransforms;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat3> normalMatrices;
+
+		std::vector<uint32_t> rootIndices;
+
+		uint32_t updateCount = 0;
+		bool topologyDirty = false;
+
+		uint32_t indexOf(node_t node) const
+		{
+			assert(isValid(node) && "Scene graph node does not exist!");
+			return handleToIndex[node];
+		}
+
+		void markDirty(uint32_t index);
+		void rebuildOrder();
+		void updateRange(uint32_t begin, uint32_t end);
+};
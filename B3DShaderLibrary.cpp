@@ -0,0 +1,275 @@
+#include "B3DShaderLibrary.h"
+
+//STD
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+namespace
+{
+	//Bump whenever compile options change so stale cache entries stop matching
+	constexpr uint64_t SHADER_CACHE_VERSION = 1;
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	//FNV-1a, unlike std::hash it gives the same value on every build so cache file names stay valid between launches
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+
+	uint64_t fnv1a(uint64_t hash, const std::string& text)
+	{
+		//Hash the terminator too so "ab" + "c" and "a" + "bc" differ
+		return fnv1a(hash, text.c_str(), text.size() + 1);
+	}
+}
+
+B3DShaderLibrary::B3DShaderLibrary()
+{
+	if (!compiler.IsValid())
+	{
+		throw std::runtime_error("Failed to initialise the shader compiler!");
+	}
+}
+
+std::vector<char> B3DShaderLibrary::getSpirv(const ShaderVariant& variant)
+{
+	std::string source;
+
+	if (!readSource(variant.sourcePath, source))
+	{
+		return loadPrecompiled(variant);
+	}
+
+	const uint64_t hash = hashVariant(variant, source);
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		auto cached = memoryCache.find(hash);
+		if (cached != memoryCache.end())
+		{
+			return cached->second;
+		}
+	}
+
+	std::vector<char> spirv;
+
+	//Two threads asking for the same new variant may both compile it, which is wasted work but still correct
+	if (!readCache(hash, spirv))
+	{
+		spirv = compile(variant, source);
+		writeCache(hash, spirv);
+	}
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	memoryCache.emplace(hash, spirv);
+
+	return spirv;
+}
+
+uint64_t B3DShaderLibrary::hashVariant(const ShaderVariant& variant) const
+{
+	//Precompiled fallbacks never change at runtime, so without a source the variant description alone identifies them
+	std::string source;
+	readSource(variant.sourcePath, source);
+
+	return hashVariant(variant, source);
+}
+
+bool B3DShaderLibrary::readSource(const std::string& sourcePath, std::string& source) const
+{
+	std::ifstream file{ sourcePath, std::ios::binary };
+
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	source = buffer.str();
+
+	return true;
+}
+
+uint64_t B3DShaderLibrary::hashVariant(const ShaderVariant& variant, const std::string& source) const
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	hash = fnv1a(hash, &SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+	hash = fnv1a(hash, variant.sourcePath);
+	hash = fnv1a(hash, source);
+
+	for (const auto& [name, value] : variant.defines)
+	{
+		hash = fnv1a(hash, name);
+		hash = fnv1a(hash, value);
+	}
+
+#ifdef NDEBUG
+	hash = fnv1a(hash, "release");
+#else
+	hash = fnv1a(hash, "debug");
+#endif
+
+	return hash;
+}
+
+std::vector<char> B3DShaderLibrary::compile(const ShaderVariant& variant, const std::string& source)
+{
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+
+#ifdef NDEBUG
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+#else
+	options.SetOptimizationLevel(shaderc_optimization_level_zero);
+	options.SetGenerateDebugInfo();
+#endif
+
+	for (const auto& [name, value] : variant.defines)
+	{
+		options.AddMacroDefinition(name, value);
+	}
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, shaderKind(variant.sourcePath), variant.sourcePath.c_str(), options);
+
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		throw std::runtime_error("Failed to compile shader " + variant.sourcePath + ":\n" + result.GetErrorMessage());
+	}
+
+	std::vector<char> spirv(static_cast<size_t>(result.cend() - result.cbegin()) * sizeof(uint32_t));
+	std::memcpy(spirv.data(), result.cbegin(), spirv.size());
+
+	float compileTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+	PLOGI << "Compiled shader variant " << variant.sourcePath << " (" << variant.defines.size() << " defines) in " << compileTime << " ms";
+
+	return spirv;
+}
+
+std::vector<char> B3DShaderLibrary::loadPrecompiled(const ShaderVariant& variant)
+{
+	//Without the source all we can offer is what ShaderCompile.bat produced, which knows nothing about defines
+	if (!variant.defines.empty())
+	{
+		PLOGW << "Shader source " << variant.sourcePath << " not found, falling back to the precompiled SPIR-V without its defines";
+	}
+
+	const std::string spirvPath = variant.sourcePath + ".spv";
+	std::ifstream file{ spirvPath, std::ios::ate | std::ios::binary };
+
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open shader source or precompiled SPIR-V for: " + variant.sourcePath);
+	}
+
+	std::vector<char> spirv(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(spirv.data(), spirv.size());
+
+	return spirv;
+}
+
+std::string B3DShaderLibrary::cachePath(uint64_t hash) const
+{
+	std::ostringstream path;
+	path << SHADER_CACHE_DIRECTORY << '/' << std::hex << hash << ".spv";
+
+	return path.str();
+}
+
+bool B3DShaderLibrary::readCache(uint64_t hash, std::vector<char>& spirv) const
+{
+	std::ifstream file{ cachePath(hash), std::ios::ate | std::ios::binary };
+
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::vector<char> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(data.data(), data.size());
+
+	uint32_t magic = 0;
+	if (!file.good() || data.size() < sizeof(magic) || data.size() % sizeof(uint32_t) != 0)
+	{
+		return false;
+	}
+
+	std::memcpy(&magic, data.data(), sizeof(magic));
+	if (magic != SPIRV_MAGIC)
+	{
+		return false;
+	}
+
+	spirv = std::move(data);
+	return true;
+}
+
+void B3DShaderLibrary::writeCache(uint64_t hash, const std::vector<char>& spirv) const
+{
+	std::error_code error;
+	std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+
+	if (error)
+	{
+		PLOGW << "Failed to create shader cache directory: " << error.message();
+		return;
+	}
+
+	//Same write-then-rename as the pipeline cache so a crash never leaves a truncated module behind
+	const std::string path = cachePath(hash);
+	const std::string tempPath = path + ".tmp";
+
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		file.write(spirv.data(), spirv.size());
+
+		if (!file.good())
+		{
+			PLOGW << "Failed to write shader cache entry " << tempPath;
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+
+	if (error)
+	{
+		PLOGW << "Failed to store shader cache entry: " << error.message();
+	}
+}
+
+shaderc_shader_kind B3DShaderLibrary::shaderKind(const std::string& sourcePath)
+{
+	const std::string extension = std::filesystem::path(sourcePath).extension().string();
+
+	if (extension == ".vert") return shaderc_vertex_shader;
+	if (extension == ".frag") return shaderc_fragment_shader;
+	if (extension == ".comp") return shaderc_compute_shader;
+	if (extension == ".geom") return shaderc_geometry_shader;
+	if (extension == ".tesc") return shaderc_tess_control_shader;
+	if (extension == ".tese") return shaderc_tess_evaluation_shader;
+
+	//Let a #pragma shader_stage in the source decide
+	return shaderc_glsl_infer_from_source;
+}
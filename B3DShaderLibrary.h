@@ -0,0 +1,65 @@
+#pragma once
+
+//Shaderc
+#include <shaderc/shaderc.hpp>
+
+//STD
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//On demand GLSL to SPIR-V compilation for Based 3D.
+//A variant is a shader source plus a set of #defines, compiled through the embedded shaderc compiler the first time it is requested.
+//Results are cached in memory and on disk under the content hash of the source and defines, so later launches skip the compiler.
+//Feature switches that don't change the interface should prefer specialization constants, see B3DPipeline::setSpecializationConstant.
+class B3DShaderLibrary
+{
+	public:
+
+		static constexpr const char* SHADER_CACHE_DIRECTORY = "shader_cache";
+
+		struct ShaderVariant
+		{
+			std::string sourcePath;
+			std::vector<std::pair<std::string, std::string>> defines;
+
+			ShaderVariant& define(const std::string& name, const std::string& value = "1")
+			{
+				defines.emplace_back(name, value);
+				return *this;
+			}
+
+			bool operator==(const ShaderVariant& other) const { return sourcePath == other.sourcePath && defines == other.defines; }
+		};
+
+		B3DShaderLibrary();
+		~B3DShaderLibrary() = default;
+
+		B3DShaderLibrary(const B3DShaderLibrary&) = delete;
+		B3DShaderLibrary& operator=(const B3DShaderLibrary&) = delete;
+
+		//Safe to call from any thread
+		std::vector<char> getSpirv(const ShaderVariant& variant);
+		uint64_t hashVariant(const ShaderVariant& variant) const;
+
+	private:
+
+		shaderc::Compiler compiler;
+
+		std::mutex cacheMutex;
+		std::unordered_map<uint64_t, std::vector<char>> memoryCache;
+
+		bool readSource(const std::string& sourcePath, std::string& source) const;
+		uint64_t hashVariant(const ShaderVariant& variant, const std::string& source) const;
+		std::vector<char> compile(const ShaderVariant& variant, const std::string& source);
+		std::vector<char> loadPrecompiled(const ShaderVariant& variant);
+
+		std::string cachePath(uint64_t hash) const;
+		bool readCache(uint64_t hash, std::vector<char>& spirv) const;
+		void writeCache(uint64_t hash, const std::vector<char>& spirv) const;
+
+		static shaderc_shader_kind shaderKind(const std::string& sourcePath);
+};
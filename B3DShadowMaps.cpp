@@ -0,0 +1,334 @@
+#include "B3DShadowMaps.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+B3DShadowMaps::B3DShadowMaps(B3DDevice& device, B3DJobSystem& jobSystem) : shadowDevice{ device }, shadowJobSystem{ jobSystem }
+{
+	shadowFormat = shadowDevice.findSupportedFormat({ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+	createImage(staticCache, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	createImage(atlas, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	createSampler();
+
+	atlasInfo.sampler = shadowSampler;
+	atlasInfo.imageView = atlas.view;
+	atlasInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+B3DShadowMaps::~B3DShadowMaps()
+{
+	vkDestroySampler(shadowDevice.device(), shadowSampler, nullptr);
+	destroyImage(atlas);
+	destroyImage(staticCache);
+}
+
+void B3DShadowMaps::addLayoutBindings(B3DDescriptorSetLayout::Builder& builder)
+{
+	builder.addBinding(SHADOW_MAP_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+}
+
+B3DShadowMaps::ShadowUniforms B3DShadowMaps::update(const B3DCamera& camera, const glm::vec3& directionToLight, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects)
+{
+	B3D_PROFILE_FUNCTION();
+
+	const glm::vec3 lightDirection = glm::normalize(directionToLight);
+	if (lightDirection != cachedDirection)
+	{
+		invalidateStaticCache();
+		cachedDirection = lightDirection;
+	}
+
+	//Rotation only, so light space positions don't depend on where the camera is
+	const glm::mat4 lightView = lightViewMatrix(lightDirection);
+	const glm::mat4 viewToLight = lightView * glm::inverse(camera.getView());
+
+	const glm::mat4& projection = camera.getProjection();
+	const float nearPlane = std::max(camera.getNear(), MIN_CASCADE_NEAR);
+	const float farPlane = std::max(std::min(camera.getFar(), MAX_SHADOW_DISTANCE), nearPlane * 2.f);
+
+	//Squared slope of the frustum's corner edges, the corners at depth d lie d * sqrt(cornerSlope) off the view axis
+	const float cornerSlope = 1.f / (projection[0][0] * projection[0][0]) + 1.f / (projection[1][1] * projection[1][1]);
+
+	ShadowUniforms uniforms{};
+	float sliceNear = nearPlane;
+
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+	{
+		const float progress = static_cast<float>(cascade + 1) / static_cast<float>(CASCADE_COUNT);
+		const float logSplit = nearPlane * std::pow(farPlane / nearPlane, progress);
+		const float evenSplit = nearPlane + (farPlane - nearPlane) * progress;
+		const float sliceFar = CASCADE_SPLIT_LAMBDA * logSplit + (1.f - CASCADE_SPLIT_LAMBDA) * evenSplit;
+
+		//The smallest sphere around the slice sits on the view axis and only depends on the projection
+		const float centerDepth = std::min((sliceNear + sliceFar) * 0.5f * (1.f + cornerSlope), sliceFar);
+		const float radius = std::sqrt(sliceFar * sliceFar * cornerSlope + (sliceFar - centerDepth) * (sliceFar - centerDepth));
+
+		//The cascade moves in whole texels, in steps no bigger than the margin so the sphere always stays inside it
+		const float halfSize = radius * (1.f + CACHE_MARGIN);
+		const float texelSize = 2.f * halfSize / static_cast<float>(CASCADE_RESOLUTION);
+		const float step = texelSize * std::max(1.f, std::floor(radius * CACHE_MARGIN / texelSize));
+
+		const glm::vec3 center{ viewToLight * glm::vec4{ 0.f, 0.f, centerDepth, 1.f } };
+		const glm::vec3 snappedCenter = glm::floor(center / step + 0.5f) * step;
+
+		cascadeKeys[cascade] = CascadeKey{ snappedCenter, halfSize };
+		if (!(cascadeKeys[cascade] == cachedKeys[cascade]))
+		{
+			cascadeCached[cascade] = false;
+		}
+
+		B3DCamera lightCamera{};
+		lightCamera.setOrthoGraphicProjection(snappedCenter.x - halfSize, snappedCenter.x + halfSize, snappedCenter.y - halfSize, snappedCenter.y + halfSize,
+			snappedCenter.z - halfSize - CASTER_DISTANCE, snappedCenter.z + halfSize);
+
+		uniforms.lightViewProjections[cascade] = lightCamera.getProjection() * lightView;
+		uniforms.cascadeSplits[cascade] = sliceFar;
+
+		sliceNear = sliceFar;
+	}
+
+	uniforms.atlasParams = { static_cast<float>(ATLAS_COLUMNS), 1.f / static_cast<float>(ATLAS_COLUMNS), 1.f / static_cast<float>(ATLAS_SIZE), atlasDrawn ? 1.f : 0.f };
+
+	bool staticMoved = false;
+	cullCasters(lightView, sceneGraph, gameObjects, staticMoved);
+
+	const size_t staticCount = static_cast<size_t>(std::count_if(gameObjects.begin(), gameObjects.end(), [](const B3DGameObj& obj) { return obj.isStatic; }));
+	if (staticMoved || staticCount != cachedStaticCount)
+	{
+		invalidateStaticCache();
+		cachedStaticCount = staticCount;
+	}
+
+	//Static casters are only gathered for the cascades about to be redrawn
+	shadowJobSystem.parallelFor(0, CASCADE_COUNT, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t cascade = begin; cascade < end; cascade++)
+		{
+			cullCascade(static_cast<uint32_t>(cascade), false);
+
+			if (!cascadeCached[cascade])
+			{
+				cullCascade(static_cast<uint32_t>(cascade), true);
+			}
+		}
+	}, "Cull shadow cascades");
+
+	return uniforms;
+}
+
+void B3DShadowMaps::markStaticCacheRendered()
+{
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+	{
+		if (cascadeCached[cascade]) continue;
+
+		cachedKeys[cascade] = cascadeKeys[cascade];
+		cascadeCached[cascade] = true;
+		staticRedrawCount++;
+	}
+
+	atlasDrawn = true;
+	B3D_PROFILE_COUNTER("Static shadow redraws", staticRedrawCount);
+}
+
+VkRect2D B3DShadowMaps::getCascadeRect(uint32_t cascade) const
+{
+	VkRect2D rect{};
+	rect.offset = { static_cast<int32_t>((cascade % ATLAS_COLUMNS) * CASCADE_RESOLUTION), static_cast<int32_t>((cascade / ATLAS_COLUMNS) * CASCADE_RESOLUTION) };
+	rect.extent = { CASCADE_RESOLUTION, CASCADE_RESOLUTION };
+	return rect;
+}
+
+B3DRenderGraph::ImportedImage B3DShadowMaps::importStaticCache()
+{
+	B3DRenderGraph::ImportedImage image{};
+	image.image = staticCache.image;
+	image.view = staticCache.view;
+	image.format = shadowFormat;
+	image.extent = { ATLAS_SIZE, ATLAS_SIZE };
+	image.initialLayout = staticCacheLayout;
+	image.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	//The graph hands every import back in its final layout, so from the next frame on the cache starts in it
+	staticCacheLayout = image.finalLayout;
+
+	return image;
+}
+
+B3DRenderGraph::ImportedImage B3DShadowMaps::importAtlas() const
+{
+	//Nothing is kept, the atlas is overwritten by the cache copy every frame
+	B3DRenderGraph::ImportedImage image{};
+	image.image = atlas.image;
+	image.view = atlas.view;
+	image.format = shadowFormat;
+	image.extent = { ATLAS_SIZE, ATLAS_SIZE };
+	image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	return image;
+}
+
+void B3DShadowMaps::recordCacheCopy(VkCommandBuffer commandBuffer, VkImage staticCacheImage, VkImage atlasImage) const
+{
+	VkImageCopy region{};
+	region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+	region.extent = { ATLAS_SIZE, ATLAS_SIZE, 1 };
+
+	vkCmdCopyImage(commandBuffer, staticCacheImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void B3DShadowMaps::writeDescriptors(B3DDescriptorWriter& writer)
+{
+	writer.writeImage(SHADOW_MAP_BINDING, &atlasInfo);
+}
+
+void B3DShadowMaps::createImage(ShadowImage& shadowImage, VkImageUsageFlags usage)
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = ATLAS_SIZE;
+	imageInfo.extent.height = ATLAS_SIZE;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = shadowFormat;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	shadowDevice.createImageWidthInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowImage.image, shadowImage.memory);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = shadowImage.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = shadowFormat;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(shadowDevice.device(), &viewInfo, nullptr, &shadowImage.view) != VK_SUCCESS)
+	{
+		destroyImage(shadowImage);
+		throw std::runtime_error("Failed to create shadow map image view!");
+	}
+}
+
+void B3DShadowMaps::destroyImage(ShadowImage& shadowImage)
+{
+	vkDestroyImageView(shadowDevice.device(), shadowImage.view, nullptr);
+	vkDestroyImage(shadowDevice.device(), shadowImage.image, nullptr);
+	vkFreeMemory(shadowDevice.device(), shadowImage.memory, nullptr);
+
+	shadowImage = ShadowImage{};
+}
+
+void B3DShadowMaps::createSampler()
+{
+	//Compares against the stored depth, linear filtering then blends the four nearest results
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1.f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = 0.f;
+
+	if (vkCreateSampler(shadowDevice.device(), &samplerInfo, nullptr, &shadowSampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shadow map sampler!");
+	}
+}
+
+glm::mat4 B3DShadowMaps::lightViewMatrix(const glm::vec3& directionToLight) const
+{
+	//-Y is up, which can't be used when the light shines straight down it
+	const glm::vec3 forward = -directionToLight;
+	const glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3{ 1.f, 0.f, 0.f } : glm::vec3{ 0.f, -1.f, 0.f };
+
+	B3DCamera lightCamera{};
+	lightCamera.setViewDirection(glm::vec3{ 0.f }, forward, up);
+	return lightCamera.getView();
+}
+
+void B3DShadowMaps::cullCasters(const glm::mat4& lightView, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects, bool& staticMoved)
+{
+	casterBounds.resize(gameObjects.size());
+
+	std::atomic<bool> moved{ false };
+
+	shadowJobSystem.parallelFor(0, gameObjects.size(), MIN_OBJECTS_PER_CULL_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const B3DGameObj& obj = gameObjects[i];
+			CasterBounds& bounds = casterBounds[i];
+
+			bounds.drawn = obj.model != nullptr;
+			bounds.isStatic = obj.isStatic;
+
+			if (!bounds.drawn) continue;
+
+			const bool hasNode = obj.sceneNode != B3DSceneGraph::INVALID_NODE;
+			const glm::mat4 world = hasNode ? sceneGraph.getWorldMatrix(obj.sceneNode) : obj.transform.mat4();
+
+			if (obj.isStatic && hasNode && sceneGraph.wasUpdated(obj.sceneNode))
+			{
+				moved.store(true, std::memory_order_relaxed);
+			}
+
+			const float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+
+			bounds.center = glm::vec3{ lightView * world * glm::vec4{ obj.model->getBoundingCenter(), 1.f } };
+			bounds.radius = obj.model->getBoundingRadius() * scale;
+		}
+	}, "Bound shadow casters");
+
+	staticMoved = moved.load(std::memory_order_relaxed);
+}
+
+void B3DShadowMaps::cullCascade(uint32_t cascade, bool staticCasters)
+{
+	std::vector<uint32_t>& casters = staticCasters ? staticCasterLists[cascade] : dynamicCasterLists[cascade];
+	casters.clear();
+
+	const CascadeKey& key = cascadeKeys[cascade];
+	const float nearDepth = key.center.z - key.halfSize - CASTER_DISTANCE;
+	const float farDepth = key.center.z + key.halfSize;
+
+	//Kept in object order, so runs of objects sharing a model still draw as one instanced call
+	for (uint32_t i = 0; i < casterBounds.size(); i++)
+	{
+		const CasterBounds& bounds = casterBounds[i];
+
+		if (!bounds.drawn || bounds.isStatic != staticCasters) continue;
+		if (std::abs(bounds.center.x - key.center.x) > key.halfSize + bounds.radius) continue;
+		if (std::abs(bounds.center.y - key.center.y) > key.halfSize + bounds.radius) continue;
+		if (bounds.center.z + bounds.radius < nearDepth || bounds.center.z - bounds.radius > farDepth) continue;
+
+		casters.push_back(i);
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DCamera.h"
+#include "B3DDescriptors.h"
+#include "B3DGameObj.h"
+#include "B3DJobSystem.h"
+#include "B3DRenderGraph.h"
+#include "B3DSceneGraph.h"
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//Vulkan
+#include <vulkan/vulkan.h>
+
+//STD
+#include <array>
+#include <cstdint>
+#include <vector>
+
+//Cascaded shadow maps for the directional light in Based 3D.
+//The view frustum is split into CASCADE_COUNT slices, each fitted with a bounding sphere so its size never changes as the
+//camera turns, and the light's view of each sphere is snapped to a grid of whole texels so shadow edges don't shimmer.
+//Static casters are kept in a cache atlas that is only redrawn for cascades whose light view moved, or when the light or the
+//static set changes. Every frame the cache is copied into the sampled atlas and dynamic casters are drawn on top.
+class B3DShadowMaps
+{
+	public:
+
+		static constexpr uint32_t CASCADE_COUNT = 4;
+		static constexpr uint32_t ATLAS_COLUMNS = 2;
+		static constexpr uint32_t CASCADE_RESOLUTION = 1024;
+		static constexpr uint32_t ATLAS_SIZE = CASCADE_RESOLUTION * ATLAS_COLUMNS;
+
+		//Blend between logarithmic and even cascade splits, 1 is fully logarithmic
+		static constexpr float CASCADE_SPLIT_LAMBDA = 0.75f;
+		static constexpr float MAX_SHADOW_DISTANCE = 50.f;
+
+		//Cascades cover this much more than their sphere and only move in steps of it, so the camera can wander inside the
+		//margin without the cached static shadows going stale
+		static constexpr float CACHE_MARGIN = 0.25f;
+
+		//How far towards the light from a cascade casters are still drawn
+		static constexpr float CASTER_DISTANCE = 20.f;
+
+		static constexpr uint32_t MIN_OBJECTS_PER_CULL_JOB = 1024;
+
+		//Cascade splits are spaced logarithmically, so the near plane can't be 0
+		static constexpr float MIN_CASCADE_NEAR = 0.01f;
+
+		//Binding the atlas takes in the global set
+		static constexpr uint32_t SHADOW_MAP_BINDING = 4;
+
+		//Matches the shadow fields of the global UBO in simple_shader.vert and simple_shader.frag under std140
+		struct ShadowUniforms
+		{
+			glm::mat4 lightViewProjections[CASCADE_COUNT];
+
+			//View depth each cascade ends at
+			glm::vec4 cascadeSplits{ 0.f };
+
+			//Cascades per atlas row, the UV size of one cascade, the UV size of one texel, then 1 once the atlas has been drawn
+			glm::vec4 atlasParams{ 0.f };
+		};
+
+		B3DShadowMaps(B3DDevice& device, B3DJobSystem& jobSystem);
+		~B3DShadowMaps();
+
+		B3DShadowMaps(const B3DShadowMaps&) = delete;
+		B3DShadowMaps& operator=(const B3DShadowMaps&) = delete;
+
+		static void addLayoutBindings(B3DDescriptorSetLayout::Builder& builder);
+
+		VkFormat getFormat() const { return shadowFormat; }
+
+		//Fits the cascades to the camera, culls casters into them and works out which cascades of the cache are stale.
+		//Call once per frame after the scene graph update
+		ShadowUniforms update(const B3DCamera& camera, const glm::vec3& directionToLight, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects);
+
+		//For static objects changed outside the scene graph, which update can't see
+		void invalidateStaticCache() { cascadeCached.fill(false); }
+
+		bool isCascadeStale(uint32_t cascade) const { return !cascadeCached[cascade]; }
+
+		//Call once the stale cascades have been recorded, so the next update trusts the cache
+		void markStaticCacheRendered();
+
+		const std::vector<uint32_t>& getCasters(uint32_t cascade, bool staticCasters) const { return staticCasters ? staticCasterLists[cascade] : dynamicCasterLists[cascade]; }
+		VkRect2D getCascadeRect(uint32_t cascade) const;
+
+		//Both are imported every frame, the cache keeps its contents between frames and the atlas is rebuilt from it
+		B3DRenderGraph::ImportedImage importStaticCache();
+		B3DRenderGraph::ImportedImage importAtlas() const;
+
+		void recordCacheCopy(VkCommandBuffer commandBuffer, VkImage staticCache, VkImage atlas) const;
+		void writeDescriptors(B3DDescriptorWriter& writer);
+
+		//Cascades redrawn into the cache since startup
+		uint64_t getStaticRedrawCount() const { return staticRedrawCount; }
+
+	private:
+
+		struct ShadowImage
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+		};
+
+		//A cascade's light view, snapped so that equal keys cover exactly the same texels
+		struct CascadeKey
+		{
+			glm::vec3 center{ 0.f };
+			float halfSize = 0.f;
+
+			bool operator==(const CascadeKey& other) const { return center == other.center && halfSize == other.halfSize; }
+		};
+
+		//A caster's bounding sphere in light view space
+		struct CasterBounds
+		{
+			glm::vec3 center;
+			float radius;
+			bool drawn;
+			bool isStatic;
+		};
+
+		B3DDevice& shadowDevice;
+		B3DJobSystem& shadowJobSystem;
+
+		VkFormat shadowFormat;
+		ShadowImage staticCache;
+		ShadowImage atlas;
+		VkSampler shadowSampler = VK_NULL_HANDLE;
+		VkDescriptorImageInfo atlasInfo{};
+		VkImageLayout staticCacheLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		std::array<CascadeKey, CASCADE_COUNT> cascadeKeys{};
+		std::array<CascadeKey, CASCADE_COUNT> cachedKeys{};
+		std::array<bool, CASCADE_COUNT> cascadeCached{};
+		glm::vec3 cachedDirection{ 0.f };
+		size_t cachedStaticCount = 0;
+		bool atlasDrawn = false;
+		uint64_t staticRedrawCount = 0;
+
+		std::vector<CasterBounds> casterBounds;
+		std::array<std::vector<uint32_t>, CASCADE_COUNT> staticCasterLists;
+		std::array<std::vector<uint32_t>, CASCADE_COUNT> dynamicCasterLists;
+
+		void createImage(ShadowImage& shadowImage, VkImageUsageFlags usage);
+		void destroyImage(ShadowImage& shadowImage);
+		void createSampler();
+
+		glm::mat4 lightViewMatrix(const glm::vec3& directionToLight) const;
+		void cullCasters(const glm::mat4& lightView, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects, bool& staticMoved);
+		void cullCascade(uint32_t cascade, bool staticCasters);
+};
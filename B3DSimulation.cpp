@@ -0,0 +1,113 @@
+#include "B3DSimulation.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//GLM
+#include <glm/gtc/constants.hpp>
+
+//STD
+#include <algorithm>
+#include <cassert>
+
+B3DSimulation::B3DSimulation(float tickRate, std::vector<TransformComponent> initialTransforms, TickFunction tick) : tickInterval{ 1.f / tickRate },
+	tickFunction{ std::move(tick) }, simulationState{ std::move(initialTransforms) }
+{
+	assert(tickRate > 0.f && "Simulation must tick at least once a second");
+
+	//Both snapshots start out the same, so the first frames see the initial state whatever the blend
+	const clock::time_point start = clock::now();
+	for (auto& snapshot : snapshots)
+	{
+		snapshot.transforms = simulationState;
+		snapshot.time = start;
+	}
+
+	simulationThread = std::thread(&B3DSimulation::simulationLoop, this);
+}
+
+B3DSimulation::~B3DSimulation()
+{
+	running.store(false, std::memory_order_release);
+	simulationThread.join();
+}
+
+void B3DSimulation::interpolate(std::vector<TransformComponent>& transforms) const
+{
+	B3D_PROFILE_FUNCTION();
+
+	const clock::time_point renderTime = clock::now() - std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(tickInterval));
+
+	std::lock_guard<std::mutex> lock(snapshotMutex);
+
+	const Snapshot& newest = snapshots[newestSnapshot];
+	const Snapshot& previous = snapshots[1 - newestSnapshot];
+
+	//Dropped ticks leave a wider gap than one interval, so the blend is over the real span between the two
+	const float span = std::chrono::duration<float>(newest.time - previous.time).count();
+	const float alpha = span > 0.f ? std::clamp(std::chrono::duration<float>(renderTime - previous.time).count() / span, 0.f, 1.f) : 1.f;
+
+	transforms.resize(newest.transforms.size());
+	for (size_t i = 0; i < transforms.size(); i++)
+	{
+		transforms[i] = blend(previous.transforms[i], newest.transforms[i], alpha);
+	}
+}
+
+void B3DSimulation::simulationLoop()
+{
+	B3DProfiler::setThreadName("Simulation");
+
+	const clock::duration interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(tickInterval));
+	clock::time_point nextTick = snapshots[newestSnapshot].time + interval;
+
+	while (running.load(std::memory_order_acquire))
+	{
+		std::this_thread::sleep_until(nextTick);
+
+		uint32_t ticksRun = 0;
+		while (nextTick <= clock::now() && ticksRun < MAX_CATCH_UP_TICKS)
+		{
+			{
+				B3D_PROFILE_SCOPE("Simulation tick");
+				tickFunction(tickInterval, simulationState);
+			}
+
+			publish(nextTick);
+			nextTick += interval;
+			ticksRun++;
+		}
+
+		//Too far behind to catch up, the missed time is skipped rather than simulated
+		if (nextTick <= clock::now())
+		{
+			nextTick = clock::now() + interval;
+		}
+	}
+}
+
+void B3DSimulation::publish(clock::time_point time)
+{
+	std::lock_guard<std::mutex> lock(snapshotMutex);
+
+	//The older buffer is overwritten, the render thread only ever reads both under the lock
+	newestSnapshot = 1 - newestSnapshot;
+	snapshots[newestSnapshot].transforms = simulationState;
+	snapshots[newestSnapshot].time = time;
+
+	tickCount.fetch_add(1, std::memory_order_release);
+}
+
+TransformComponent B3DSimulation::blend(const TransformComponent& from, const TransformComponent& to, float alpha)
+{
+	TransformComponent result{};
+	result.translation = glm::mix(from.translation, to.translation, alpha);
+	result.scale = glm::mix(from.scale, to.scale, alpha);
+
+	//Angles wrap, so turn the short way round, a yaw crossing 2pi would otherwise spin back through the whole circle
+	glm::vec3 turn = to.rotation - from.rotation;
+	turn -= glm::two_pi<float>() * glm::floor((turn + glm::pi<float>()) / glm::two_pi<float>());
+	result.rotation = from.rotation + turn * alpha;
+
+	return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+//Local
+#include "B3DTransform.h"
+
+//STD
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Fixed rate simulation for Based 3D.
+//A thread of its own advances a set of transforms in steps of exactly one tick, however long frames take to render, and
+//publishes a snapshot after every tick over the older of two buffers. The render thread blends the two, drawing the world one
+//tick in the past so there is always a newer snapshot to move towards, which keeps motion smooth at any refresh rate.
+class B3DSimulation
+{
+	public:
+
+		using clock = std::chrono::steady_clock;
+
+		//Advances the transforms by one tick of dt seconds, only ever called on the simulation thread
+		using TickFunction = std::function<void(float dt, std::vector<TransformComponent>& transforms)>;
+
+		//Ticks run back to back after a stall before the rest are dropped, so a long hitch doesn't keep the thread catching up
+		static constexpr uint32_t MAX_CATCH_UP_TICKS = 5;
+
+		//The thread starts ticking straight away
+		B3DSimulation(float tickRate, std::vector<TransformComponent> initialTransforms, TickFunction tick);
+		~B3DSimulation();
+
+		B3DSimulation(const B3DSimulation&) = delete;
+		B3DSimulation& operator=(const B3DSimulation&) = delete;
+
+		//Called on the render thread, fills transforms with the state one tick before now
+		void interpolate(std::vector<TransformComponent>& transforms) const;
+
+		uint64_t getTickCount() const { return tickCount.load(std::memory_order_acquire); }
+		float getTickInterval() const { return tickInterval; }
+
+	private:
+
+		struct Snapshot
+		{
+			std::vector<TransformComponent> transforms;
+
+			//When the tick that produced it was due
+			clock::time_point time;
+		};
+
+		float tickInterval;
+		TickFunction tickFunction;
+
+		//Only touched by the simulation thread
+		std::vector<TransformComponent> simulationState;
+
+		mutable std::mutex snapshotMutex;
+		std::array<Snapshot, 2> snapshots;
+		uint32_t newestSnapshot = 0;
+
+		std::atomic<uint64_t> tickCount{ 0 };
+		std::atomic<bool> running{ true };
+		std::thread simulationThread;
+
+		void simulationLoop();
+		void publish(clock::time_point time);
+
+		static TransformComponent blend(const TransformComponent& from, const TransformComponent& to, float alpha);
+};
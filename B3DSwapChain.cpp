@@ -1,11 +1,13 @@
 #include "B3DSwapChain.h"
 
-B3DSwapChain::B3DSwapChain(B3DDevice& deviceRef, VkExtent2D extent) : device{deviceRef}, windowExtent{extent}
+B3DSwapChain::B3DSwapChain(B3DDevice& deviceRef, VkExtent2D extent, const FramePacingPolicy& policy) : device{deviceRef}, windowExtent{extent}, presentModePriority{policy.presentModes},
+	framesInFlight{std::clamp<uint32_t>(policy.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT)}
 {
 	init();
 }
 
-B3DSwapChain::B3DSwapChain(B3DDevice& deviceRef, VkExtent2D extent, std::shared_ptr<B3DSwapChain> previous) : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{previous}
+B3DSwapChain::B3DSwapChain(B3DDevice& deviceRef, VkExtent2D extent, const FramePacingPolicy& policy, std::shared_ptr<B3DSwapChain> previous) : device{ deviceRef }, windowExtent{ extent },
+	presentModePriority{policy.presentModes}, framesInFlight{std::clamp<uint32_t>(policy.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT)}, oldSwapChain{previous}
 {
 	init();
 
@@ -26,25 +28,17 @@ B3DSwapChain::~B3DSwapChain()
 		swapChain = nullptr;
 	}
 
-	for (int i = 0; i < depthImages.size(); i++)
+	for (size_t i = 0; i < offscreenImageMemorys.size(); i++)
 	{
-		vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-		vkDestroyImage(device.device(), depthImages[i], nullptr);
-		vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+		vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+		vkFreeMemory(device.device(), offscreenImageMemorys[i], nullptr);
 	}
 
-	for (auto frameBuffer : swapChainFrameBuffers)
-	{
-		vkDestroyFramebuffer(device.device(), frameBuffer, nullptr);
-	}
-
-	vkDestroyRenderPass(device.device(), renderPass, nullptr);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	//Empty if a newer swap chain took them over
+	for (size_t i = 0; i < imageAvailableSemaphores.size(); i++)
 	{
 		vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(device.device(), inFlightFences[i], nullptr);
 	}
 }
 
@@ -55,45 +49,58 @@ VkFormat B3DSwapChain::findDepthFormat()
 
 VkResult B3DSwapChain::acquireNextImage(uint32_t* imageIndex)
 {
-	vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	device.getGraphicsTimeline().wait(frameValues[currentFrame]);
+
+	//Offscreen images belong to a frame slot, so the wait above is all the synchronisation they need
+	if (isHeadless())
+	{
+		*imageIndex = static_cast<uint32_t>(currentFrame);
+		return VK_SUCCESS;
+	}
 
 	VkResult result = vkAcquireNextImageKHR(device.device(), swapChain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, imageIndex);
 
 	return result;
 }
 
-VkResult B3DSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
+void B3DSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
 {
-	if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-	{
-		vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-	}
-
-	imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+	//No per-image wait is needed, an image is only acquired again after its last present, which waited on the render to it
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = buffers;
 
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	//Without acquire and present there is nothing to wait on or signal
+	if (!isHeadless())
+	{
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = waitSemaphores;
+		submitInfo.pWaitDstStageMask = waitStages;
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+	}
 
-	vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+	frameValues[currentFrame] = device.getGraphicsTimeline().submitFrame(submitInfo);
+}
 
-	if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+VkResult B3DSwapChain::presentImage(uint32_t* imageIndex)
+{
+	if (isHeadless())
 	{
-		throw std::runtime_error("Failed to submit draw command buffer!");
+		currentFrame = (currentFrame + 1) % framesInFlight;
+		return VK_SUCCESS;
 	}
 
+	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -108,20 +115,32 @@ VkResult B3DSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint
 
 	auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % framesInFlight;
 
 	return result;
 }
 
 void B3DSwapChain::createSwapChain()
 {
+	if (isHeadless())
+	{
+		createOffscreenImages();
+		return;
+	}
+
 	SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+	presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	//One image per frame in flight plus the one on screen, mailbox needs a spare on top to always have one to replace
+	uint32_t imageCount = std::max(swapChainSupport.capabilities.minImageCount, framesInFlight + 1);
+
+	if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+	{
+		imageCount = std::max(imageCount, 3u);
+	}
 
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 	{
@@ -139,6 +158,13 @@ void B3DSwapChain::createSwapChain()
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	//Frame capture copies out of the swap chain images, which surfaces don't have to allow
+	readbackSupported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+	if (readbackSupported)
+	{
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
 	QueueFamilyInices indices = device.findPhysicalQueueFamilies();
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
 
@@ -176,41 +202,16 @@ void B3DSwapChain::createSwapChain()
 	swapChainExtent = extent;
 }
 
-void B3DSwapChain::createImageViews()
-{
-	swapChainImageViews.resize(swapChainImages.size());
-
-	for (size_t i = 0; i < swapChainImages.size(); i++)
-	{
-		VkImageViewCreateInfo viewInfo{};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = swapChainImages[i];
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = swapChainImageFormat;
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
-
-		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create texture image views!");
-		}
-	}
-}
-
-void B3DSwapChain::createDepthResources()
+void B3DSwapChain::createOffscreenImages()
 {
-	VkFormat depthFormat = findDepthFormat();
-	swapChainDepthFormat = depthFormat;
-	VkExtent2D swapChainExtent = getSwapChainExtent();
+	swapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	swapChainExtent = windowExtent;
+	readbackSupported = true;
 
-	depthImages.resize(imageCount());
-	depthImageMemorys.resize(imageCount());
-	depthImageViews.resize(imageCount());
+	swapChainImages.resize(framesInFlight);
+	offscreenImageMemorys.resize(framesInFlight);
 
-	for (int i = 0; i < depthImages.size(); i++)
+	for (uint32_t i = 0; i < framesInFlight; i++)
 	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -220,151 +221,89 @@ void B3DSwapChain::createDepthResources()
 		imageInfo.extent.depth = 1;
 		imageInfo.mipLevels = 1;
 		imageInfo.arrayLayers = 1;
-		imageInfo.format = depthFormat;
+		imageInfo.format = swapChainImageFormat;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.flags = 0;
 
-		device.createImageWidthInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i], depthImageMemorys[i]);
+		device.createImageWidthInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImageMemorys[i]);
+	}
+
+	PLOGI << "Headless render target: " << swapChainExtent.width << "x" << swapChainExtent.height << ", frames in flight: " << framesInFlight;
+}
+
+void B3DSwapChain::createImageViews()
+{
+	swapChainImageViews.resize(swapChainImages.size());
 
+	for (size_t i = 0; i < swapChainImages.size(); i++)
+	{
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = depthImages[i];
+		viewInfo.image = swapChainImages[i];
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = depthFormat;
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		viewInfo.format = swapChainImageFormat;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
 		viewInfo.subresourceRange.levelCount = 1;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &depthImageViews[i]) != VK_SUCCESS)
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create texture image view!");
+			throw std::runtime_error("Failed to create texture image views!");
 		}
 	}
 }
 
-void B3DSwapChain::createRenderPass()
+void B3DSwapChain::createSyncObjects()
 {
-	VkAttachmentDescription depthAttachment{};
-	depthAttachment.format = findDepthFormat();
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference depthAttachmentRef{};
-	depthAttachmentRef.attachment = 1;
-	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = getSwapChainImageFormat();
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-	subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-	VkSubpassDependency dependency = {};
-	dependency.dstSubpass = 0;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.srcAccessMask = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-
-	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-	renderPassInfo.pAttachments = attachments.data();
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create render pass!");
-	}
-}
+	if (adoptSyncObjects()) return;
 
-void B3DSwapChain::createFrameBuffers()
-{
-	swapChainFrameBuffers.resize(imageCount());
+	imageAvailableSemaphores.resize(framesInFlight);
+	renderFinishedSemaphores.resize(framesInFlight);
+	frameValues.assign(framesInFlight, 0);
 
-	for (size_t i = 0; i < imageCount(); i++)
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (size_t i = 0; i < framesInFlight; i++)
 	{
-		std::array<VkImageView, 2> attachments = { swapChainImageViews[i], depthImageViews[i] };
-
-		VkExtent2D swapChainExtent = getSwapChainExtent();
-		VkFramebufferCreateInfo frameBufferInfo = {};
-		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		frameBufferInfo.renderPass = renderPass;
-		frameBufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		frameBufferInfo.pAttachments = attachments.data();
-		frameBufferInfo.width = swapChainExtent.width;
-		frameBufferInfo.height = swapChainExtent.height;
-		frameBufferInfo.layers = 1;
-
-		if (vkCreateFramebuffer(device.device(), &frameBufferInfo, nullptr, &swapChainFrameBuffers[i]) != VK_SUCCESS)
+		if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS || vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("Failed to create frame buffer!");
+			throw std::runtime_error("Failed to create sync objects for a frame!");
 		}
 	}
 }
 
-void B3DSwapChain::createSyncObjects()
+bool B3DSwapChain::adoptSyncObjects()
 {
-	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+	if (oldSwapChain == nullptr || oldSwapChain->framesInFlight != framesInFlight) return false;
 
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	//The slot values still guard the frames submitted on the old swap chain, and carrying on from its slot keeps them lined
+	//up with the renderer's per-frame resources
+	imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+	renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+	frameValues = oldSwapChain->frameValues;
+	currentFrame = oldSwapChain->currentFrame;
 
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	oldSwapChain->imageAvailableSemaphores.clear();
+	oldSwapChain->renderFinishedSemaphores.clear();
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS || vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS || vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create sync objects for a frame!");
-		}
-	}
+	return true;
 }
 
 void B3DSwapChain::init()
 {
 	createSwapChain();
 	createImageViews();
-	createRenderPass();
-	createDepthResources();
-	createFrameBuffers();
 	createSyncObjects();
+
+	//The depth buffer belongs to the render graph now, the format is kept so a recreated swap chain can be checked against it
+	swapChainDepthFormat = findDepthFormat();
 }
 
 VkSurfaceFormatKHR B3DSwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
@@ -382,34 +321,24 @@ VkSurfaceFormatKHR B3DSwapChain::chooseSwapSurfaceFormat(const std::vector<VkSur
 
 VkPresentModeKHR B3DSwapChain::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-	for (const auto& availablePresentMode : availablePresentModes)
+	VkPresentModeKHR chosenMode = VK_PRESENT_MODE_FIFO_KHR;
+
+	for (VkPresentModeKHR preferredMode : presentModePriority)
 	{
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredMode) != availablePresentModes.end())
 		{
-			PLOGI << "Present mode: Mailbox";
-			if (logSwapChain)
-			{
-				std::cout << "Present mode: Mailbox" << std::endl;
-			}
-			
-			return availablePresentMode;
+			chosenMode = preferredMode;
+			break;
 		}
 	}
 
-	// for (const auto &availablePresentMode : availablePresentModes) {
-	//   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-	//     std::cout << "Present mode: Immediate" << std::endl;
-	//     return availablePresentMode;
-	//   }
-	// }
-
-	PLOGI << "Present mode: V-Sync";
+	PLOGI << "Present mode: " << B3DFramePacer::presentModeName(chosenMode) << ", frames in flight: " << framesInFlight;
 	if (logSwapChain)
 	{
-		std::cout << "Present mode: V-Sync" << std::endl;
+		std::cout << "Present mode: " << B3DFramePacer::presentModeName(chosenMode) << std::endl;
 	}
 
-	return VK_PRESENT_MODE_FIFO_KHR;
+	return chosenMode;
 }
 
 VkExtent2D B3DSwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
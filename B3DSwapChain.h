@@ -1,11 +1,13 @@
 #pragma once
 
 #include "B3DDevice.h"
+#include "B3DFramePacing.h"
 
 //Vulkan
 #include <vulkan/vulkan.h>
 
 //STD
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -21,34 +23,49 @@
 #include <plog/Log.h>
 
 //Swap chain for Based 3D
+//On a headless device it renders into images it owns instead, one per frame in flight.
+//Render passes, framebuffers and the depth buffer are built by B3DRenderGraph around the images handed out here.
+//Each frame slot remembers the graphics timeline value its last submit signals and waits on it before being reused.
+//A swap chain made from a previous one with the same frames in flight takes over those values and its semaphores, so frames
+//submitted on the old one are still waited on and it can be destroyed once they finish instead of after a device idle.
 class B3DSwapChain
 {
 	public:
 
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		//Upper bound for per-frame resources, the policy decides how many are actually cycled through
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
-		B3DSwapChain(B3DDevice &deviceRef, VkExtent2D windowExtent);
-		B3DSwapChain(B3DDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<B3DSwapChain> previous);
+		B3DSwapChain(B3DDevice &deviceRef, VkExtent2D windowExtent, const FramePacingPolicy& policy);
+		B3DSwapChain(B3DDevice& deviceRef, VkExtent2D windowExtent, const FramePacingPolicy& policy, std::shared_ptr<B3DSwapChain> previous);
 		~B3DSwapChain();
 
 		B3DSwapChain(const B3DSwapChain&) = delete;
 		B3DSwapChain& operator=(const B3DSwapChain&) = delete;
 
-		VkFramebuffer getFrameBuffer(int index) { return swapChainFrameBuffers[index]; }
-		VkRenderPass getRenderPass() { return renderPass; }
 		VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+		VkImage getImage(int index) { return swapChainImages[index]; }
+		bool isHeadless() const { return device.isHeadless(); }
+
+		//Whether images can be copied out after rendering, and the layout they are left in for that
+		bool supportsReadback() const { return readbackSupported; }
+		VkImageLayout getFinalLayout() const { return isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
 		size_t imageCount() { return swapChainImages.size(); }
 		VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
+		VkFormat getDepthFormat() const { return swapChainDepthFormat; }
 		VkExtent2D getSwapChainExtent() { return swapChainExtent; }
 		uint32_t width() { return swapChainExtent.width; }
 		uint32_t hieght() { return swapChainExtent.height; }
 
+		uint32_t getFramesInFlight() const { return framesInFlight; }
+		VkPresentModeKHR getPresentMode() const { return presentMode; }
+
 		float extentAspectRatio() { return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height); }
 
 		VkFormat findDepthFormat();
 
 		VkResult acquireNextImage(uint32_t* imageIndex);
-		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		void submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		VkResult presentImage(uint32_t* imageIndex);
 
 		bool compareSwapFormats(const B3DSwapChain& swapChain) const { return swapChain.swapChainDepthFormat == swapChainDepthFormat && swapChain.swapChainImageFormat == swapChainImageFormat; }
 
@@ -69,32 +86,34 @@ class B3DSwapChain
 		VkExtent2D swapChainExtent;
 		VkExtent2D windowExtent;
 
-		std::vector<VkFramebuffer> swapChainFrameBuffers;
-		VkRenderPass renderPass;
+		const std::vector<VkPresentModeKHR> presentModePriority;
+		const uint32_t framesInFlight;
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
-		std::vector<VkImage> depthImages;
-		std::vector<VkDeviceMemory> depthImageMemorys;
-		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
+		std::vector<VkDeviceMemory> offscreenImageMemorys;
 
-		VkSwapchainKHR swapChain;
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+		bool readbackSupported = false;
 
+		//Acquire and present only take binary semaphores
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
-		std::vector<VkFence> imagesInFlight;
 
+		//Graphics timeline value of each slot's last submit, 0 if it has none
+		std::vector<uint64_t> frameValues;
+
+		//Only set while init runs
 		std::shared_ptr<B3DSwapChain> oldSwapChain;
 
 		size_t currentFrame = 0;
 
 		void createSwapChain();
+		void createOffscreenImages();
 		void createImageViews();
-		void createDepthResources();
-		void createRenderPass();
-		void createFrameBuffers();
 		void createSyncObjects();
+		bool adoptSyncObjects();
 
 		void init();
 
@@ -0,0 +1,136 @@
+#include "B3DTexture.h"
+
+//STD
+#include <stdexcept>
+
+namespace
+{
+	VkImageCreateInfo imageCreateInfo(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		return imageInfo;
+	}
+}
+
+B3DTexture::B3DTexture(B3DDevice& device, B3DBindlessHeap& heap, std::shared_ptr<RetireQueue> retireQueue) : textureDevice{ device }, textureHeap{ heap },
+	textureRetireQueue{ std::move(retireQueue) }
+{
+
+}
+
+B3DTexture::~B3DTexture()
+{
+	//Frames in flight may still sample the image through the bindless slot, so both are released later
+	textureHeap.removeTexture(bindlessIndex);
+	textureRetireQueue->retire(textureImage);
+}
+
+B3DTexture::RetireQueue::~RetireQueue()
+{
+	for (auto& retired : retiredImages)
+	{
+		destroyGpuImage(queueDevice, retired.image);
+	}
+}
+
+void B3DTexture::RetireQueue::retire(const GpuImage& image)
+{
+	if (image.image == VK_NULL_HANDLE && image.view == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	retiredImages.push_back({ image, queueDevice.getGraphicsTimeline().getFrameValue() });
+}
+
+void B3DTexture::RetireQueue::release()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+
+	B3DTimeline& timeline = queueDevice.getGraphicsTimeline();
+
+	//Retired in frame order, so the oldest are always at the front
+	while (!retiredImages.empty() && timeline.isComplete(retiredImages.front().releaseValue))
+	{
+		destroyGpuImage(queueDevice, retiredImages.front().image);
+		retiredImages.pop_front();
+	}
+}
+
+B3DTexture::GpuImage B3DTexture::createGpuImage(B3DDevice& device, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage)
+{
+	GpuImage gpuImage{};
+
+	VkImageCreateInfo imageInfo = imageCreateInfo(width, height, mipLevels, format, usage);
+
+	device.createImageWidthInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpuImage.image, gpuImage.memory);
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device.device(), gpuImage.image, &memoryRequirements);
+	gpuImage.size = memoryRequirements.size;
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = gpuImage.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device.device(), &viewInfo, nullptr, &gpuImage.view) != VK_SUCCESS)
+	{
+		destroyGpuImage(device, gpuImage);
+		throw std::runtime_error("Failed to create texture image view!");
+	}
+
+	return gpuImage;
+}
+
+VkDeviceSize B3DTexture::queryImageSize(B3DDevice& device, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage)
+{
+	//Creating an image without memory is cheap, and the only way to learn its size before Vulkan 1.3
+	VkImageCreateInfo imageInfo = imageCreateInfo(width, height, mipLevels, format, usage);
+
+	VkImage image;
+	if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture image!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device.device(), image, &memoryRequirements);
+	vkDestroyImage(device.device(), image, nullptr);
+
+	return memoryRequirements.size;
+}
+
+void B3DTexture::destroyGpuImage(B3DDevice& device, GpuImage& image)
+{
+	if (image.view != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device.device(), image.view, nullptr);
+	}
+
+	if (image.image != VK_NULL_HANDLE)
+	{
+		vkDestroyImage(device.device(), image.image, nullptr);
+		vkFreeMemory(device.device(), image.memory, nullptr);
+	}
+
+	image = GpuImage{};
+}
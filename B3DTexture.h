@@ -0,0 +1,130 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DBindless.h"
+#include "B3DTextureProcessing.h"
+
+//STD
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Sampled 2D texture for Based 3D.
+//Handed out by B3DTextureLibrary before its pixels exist. It joins the bindless heap once its upload has been recorded, until then
+//the bindless index is INVALID_INDEX. B3DMaterialLibrary watches for that, so a material can be given a texture straight away.
+//A streamed texture holds only part of its mip chain, the library rebuilds its image as mips come and go and the bindless index
+//changes each time.
+class B3DTexture
+{
+	public:
+
+		//The image, its memory and view travel together, a streamed texture swaps in a new set whenever its mips change
+		struct GpuImage
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+		};
+
+		//Images no longer sampled wait here until the graphics timeline passes the last frame that could read them. Shared by
+		//the library and its textures, so a texture outliving the library still has somewhere to hand its image back
+		class RetireQueue
+		{
+			public:
+
+				explicit RetireQueue(B3DDevice& device) : queueDevice{ device } {}
+
+				//Destroys whatever is left, the device must be idle by then
+				~RetireQueue();
+
+				RetireQueue(const RetireQueue&) = delete;
+				RetireQueue& operator=(const RetireQueue&) = delete;
+
+				//Safe to call from any thread
+				void retire(const GpuImage& image);
+
+				//Destroys the images every frame is done with, call once per frame
+				void release();
+
+			private:
+
+				struct RetiredImage
+				{
+					GpuImage image;
+					uint64_t releaseValue;
+				};
+
+				B3DDevice& queueDevice;
+
+				std::mutex queueMutex;
+				std::deque<RetiredImage> retiredImages;
+		};
+
+		B3DTexture(B3DDevice& device, B3DBindlessHeap& heap, std::shared_ptr<RetireQueue> retireQueue);
+		~B3DTexture();
+
+		B3DTexture(const B3DTexture&) = delete;
+		B3DTexture& operator=(const B3DTexture&) = delete;
+
+		uint32_t getBindlessIndex() const { return bindlessIndex; }
+		bool isReady() const { return ready.load(std::memory_order_acquire); }
+
+		VkImage getImage() const { return textureImage.image; }
+		VkImageView getImageView() const { return textureImage.view; }
+		VkFormat getFormat() const { return textureFormat; }
+		VkDeviceSize getMemorySize() const { return textureImage.size; }
+
+		//Size of mip 0 of the full chain, whether or not it is resident
+		uint32_t getWidth() const { return textureWidth; }
+		uint32_t getHeight() const { return textureHeight; }
+
+		//Levels in the image, which start at getResidentMip of the full chain
+		uint32_t getMipLevels() const { return textureMipLevels; }
+		uint32_t getResidentMip() const { return residentMip; }
+		uint32_t getMipCount() const { return residentMip + textureMipLevels; }
+
+		bool isStreamed() const { return streamed; }
+
+	private:
+
+		B3DDevice& textureDevice;
+		B3DBindlessHeap& textureHeap;
+		std::shared_ptr<RetireQueue> textureRetireQueue;
+		uint32_t bindlessIndex = B3DBindlessHeap::INVALID_INDEX;
+
+		GpuImage textureImage{};
+		VkFormat textureFormat = VK_FORMAT_UNDEFINED;
+		uint32_t textureWidth = 0;
+		uint32_t textureHeight = 0;
+		uint32_t textureMipLevels = 0;
+		uint32_t residentMip = 0;
+
+		std::atomic<bool> ready{ false };
+
+		//Streaming state, only touched by the library on the render thread
+		bool streamed = false;
+		bool streamPending = false;
+		std::string streamPath;
+		uint64_t streamHash = 0;
+		std::vector<B3DTextureProcessing::MipLevel> mipChain;
+		uint32_t floorMip = 0;
+		uint32_t requestedMip = 0;
+		uint64_t lastNeededFrame = 0;
+
+		//Allocation size of the image holding the chain from each mip down, 0 until first asked for
+		std::vector<VkDeviceSize> allocationSizes;
+
+		static GpuImage createGpuImage(B3DDevice& device, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage);
+		static void destroyGpuImage(B3DDevice& device, GpuImage& image);
+
+		//What createGpuImage would allocate for the same image
+		static VkDeviceSize queryImageSize(B3DDevice& device, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage);
+
+		friend class B3DTextureLibrary;
+};
@@ -0,0 +1,683 @@
+#include "B3DTextureLibrary.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+//Plog
+#include <plog/Log.h>
+
+//STB
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+namespace
+{
+	//Streamed images are copied from when their mips change
+	constexpr VkImageUsageFlags STREAMED_IMAGE_USAGE = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	//FNV-1a, unlike std::hash it gives the same value on every build so cache file names stay valid between launches
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+
+	VkImageMemoryBarrier imageBarrier(VkImage image, uint32_t baseMip, uint32_t mipCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseMip;
+		barrier.subresourceRange.levelCount = mipCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		return barrier;
+	}
+}
+
+B3DTextureLibrary::B3DTextureLibrary(B3DDevice& device, B3DJobSystem& jobSystem, B3DBindlessHeap& heap) : libraryDevice{ device }, libraryJobs{ jobSystem }, libraryHeap{ heap },
+	retireQueue{ std::make_shared<B3DTexture::RetireQueue>(device) }, loadCounter{ jobSystem.createCounter() }
+{
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	gpuMipsUnorm = libraryDevice.supportsFormatFeatures(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, blitFeatures);
+	gpuMipsSrgb = libraryDevice.supportsFormatFeatures(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, blitFeatures);
+
+	createSampler();
+}
+
+B3DTextureLibrary::~B3DTextureLibrary()
+{
+	libraryJobs.wait(loadCounter);
+
+	pendingUploads.clear();
+	pendingStreams.clear();
+	streamedTextures.clear();
+	loadedTextures.clear();
+
+	vkDestroySampler(libraryDevice.device(), textureSampler, nullptr);
+}
+
+std::shared_ptr<B3DTexture> B3DTextureLibrary::load(const std::string& path, const TextureLoadOptions& options)
+{
+	std::ostringstream key;
+	key << path << '|' << options.srgb << options.generateMips << options.compress << options.stream;
+
+	std::lock_guard<std::mutex> lock(libraryMutex);
+
+	auto loaded = loadedTextures.find(key.str());
+	if (loaded != loadedTextures.end())
+	{
+		return loaded->second;
+	}
+
+	auto texture = std::make_shared<B3DTexture>(libraryDevice, libraryHeap, retireQueue);
+	loadedTextures.emplace(key.str(), texture);
+
+	libraryJobs.run([this, path, options, texture]() { loadTexture(path, options, texture); }, "Load texture", loadCounter);
+
+	return texture;
+}
+
+void B3DTextureLibrary::beginFrame()
+{
+	B3DTimeline& timeline = libraryDevice.getGraphicsTimeline();
+
+	frameCounter++;
+
+	//Queued in frame order, so the oldest are always at the front
+	while (!stagingBuffers.empty() && timeline.isComplete(stagingBuffers.front().releaseValue))
+	{
+		stagingBuffers.pop_front();
+	}
+
+	retireQueue->release();
+}
+
+void B3DTextureLibrary::recordUploads(VkCommandBuffer commandBuffer)
+{
+	std::deque<PendingUpload> uploads;
+	std::deque<PendingUpload> streams;
+	VkDeviceSize budget = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(libraryMutex);
+
+		while (!pendingUploads.empty() && (uploads.empty() || budget + pendingUploads.front().data.bytes.size() <= UPLOAD_BUDGET_PER_FRAME))
+		{
+			budget += pendingUploads.front().data.bytes.size();
+			uploads.push_back(std::move(pendingUploads.front()));
+			pendingUploads.pop_front();
+		}
+
+		while (!pendingStreams.empty() && ((uploads.empty() && streams.empty()) || budget + pendingStreams.front().data.bytes.size() <= UPLOAD_BUDGET_PER_FRAME))
+		{
+			budget += pendingStreams.front().data.bytes.size();
+			streams.push_back(std::move(pendingStreams.front()));
+			pendingStreams.pop_front();
+		}
+	}
+
+	if (uploads.empty() && streams.empty() && streamedTextures.empty()) return;
+
+	B3D_PROFILE_SCOPE("Record texture uploads");
+
+	for (auto& upload : uploads)
+	{
+		recordUpload(commandBuffer, upload);
+	}
+
+	for (auto& stream : streams)
+	{
+		B3DTexture& texture = *stream.texture;
+		const auto& data = stream.data;
+		texture.streamPending = false;
+
+		if (data.loadedMips == 0)
+		{
+			//The cache file went away or was replaced, the texture keeps what it has
+			texture.streamed = false;
+			continue;
+		}
+
+		//Room was made when the read was scheduled, but other textures may have taken it since
+		if (data.baseMip + data.loadedMips != texture.residentMip || !makeRoom(commandBuffer, growthBytes(texture, data.baseMip), &texture))
+		{
+			continue;
+		}
+
+		recordResidencyChange(commandBuffer, texture, data.baseMip, &data);
+	}
+
+	updateResidency(commandBuffer);
+}
+
+void B3DTextureLibrary::requestMip(B3DTexture& texture, uint32_t mip)
+{
+	if (!texture.streamed) return;
+
+	mip = std::min(mip, static_cast<uint32_t>(texture.mipChain.size() - 1));
+
+	if (texture.lastNeededFrame != frameCounter)
+	{
+		texture.requestedMip = mip;
+		texture.lastNeededFrame = frameCounter;
+	}
+	else
+	{
+		texture.requestedMip = std::min(texture.requestedMip, mip);
+	}
+}
+
+VkDeviceSize B3DTextureLibrary::streamingMemory() const
+{
+	VkDeviceSize total = 0;
+
+	for (const auto& texture : streamedTextures)
+	{
+		total += texture->getMemorySize();
+	}
+
+	return total;
+}
+
+size_t B3DTextureLibrary::pendingUploadCount() const
+{
+	std::lock_guard<std::mutex> lock(libraryMutex);
+	return pendingUploads.size();
+}
+
+void B3DTextureLibrary::createSampler()
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.maxAnisotropy = libraryDevice.properties.limits.maxSamplerAnisotropy;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(libraryDevice.device(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture sampler!");
+	}
+}
+
+void B3DTextureLibrary::loadTexture(const std::string& path, const TextureLoadOptions& options, std::shared_ptr<B3DTexture> texture)
+{
+	B3D_PROFILE_SCOPE("Load texture");
+
+	std::error_code error;
+	if (!std::filesystem::exists(path, error))
+	{
+		PLOGW << "Texture " << path << " not found";
+		return;
+	}
+
+	const uint64_t hash = hashSource(path, options);
+	const std::string cacheFile = cachePath(hash);
+
+	PendingUpload upload{ texture, {} };
+
+	//The level list comes first, a cached texture then reads only the levels it uploads
+	bool cached = B3DTextureProcessing::readContainer(cacheFile, hash, upload.data, 0, 0);
+
+	if (!cached)
+	{
+		upload.data = B3DTextureProcessing::TextureData{};
+
+		if (!decodeTexture(path, options, upload.data))
+		{
+			PLOGW << "Failed to decode texture " << path << ": " << stbi_failure_reason();
+			return;
+		}
+
+		cached = B3DTextureProcessing::writeContainer(cacheFile, hash, upload.data);
+
+		if (!cached)
+		{
+			PLOGW << "Failed to write texture cache " << cacheFile;
+		}
+	}
+
+	//Streaming reads finer levels back from the cache, so a texture it could not store is uploaded whole
+	uint32_t firstMip = 0;
+	if (options.stream && options.generateMips && cached)
+	{
+		firstMip = B3DTextureProcessing::firstMipWithin(upload.data, STREAMING_RESIDENT_SIZE);
+	}
+
+	if (upload.data.loadedMips == 0)
+	{
+		if (!B3DTextureProcessing::readContainer(cacheFile, hash, upload.data, firstMip))
+		{
+			PLOGW << "Failed to read texture cache " << cacheFile;
+			return;
+		}
+	}
+	else if (firstMip > 0)
+	{
+		B3DTextureProcessing::keepMips(upload.data, firstMip);
+	}
+
+	if (firstMip > 0)
+	{
+		upload.streamPath = cacheFile;
+		upload.streamHash = hash;
+	}
+
+	std::lock_guard<std::mutex> lock(libraryMutex);
+	pendingUploads.push_back(std::move(upload));
+}
+
+bool B3DTextureLibrary::decodeTexture(const std::string& path, const TextureLoadOptions& options, B3DTextureProcessing::TextureData& data) const
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+
+	stbi_uc* pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels) return false;
+
+	data.width = static_cast<uint32_t>(width);
+	data.height = static_cast<uint32_t>(height);
+	data.format = options.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	data.mips.push_back({ data.width, data.height, 0, static_cast<uint64_t>(width) * height * 4 });
+	data.loadedMips = 1;
+	data.bytes.assign(pixels, pixels + data.mips[0].size);
+
+	stbi_image_free(pixels);
+
+	const bool compress = options.compress && libraryDevice.supportsBCCompression();
+	const bool gpuMips = options.srgb ? gpuMipsSrgb : gpuMipsUnorm;
+
+	if (options.generateMips)
+	{
+		//Compression and streaming need every level on the CPU, otherwise the GPU makes them from mip 0
+		if (!compress && !options.stream && gpuMips)
+		{
+			data.gpuMips = true;
+			data.gpuMipLevels = B3DTextureProcessing::mipLevelCount(data.width, data.height);
+		}
+		else
+		{
+			B3DTextureProcessing::generateMips(data, options.srgb);
+		}
+	}
+
+	if (compress)
+	{
+		B3DTextureProcessing::compressBC1(data, options.srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+	}
+
+	return true;
+}
+
+uint64_t B3DTextureLibrary::hashSource(const std::string& path, const TextureLoadOptions& options) const
+{
+	std::error_code error;
+	const uint64_t fileSize = std::filesystem::file_size(path, error);
+	const int64_t writeTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+	//What the device can do changes what gets stored, so it is part of the key too
+	const uint8_t flags[] = { options.srgb, options.generateMips, options.compress, options.stream, libraryDevice.supportsBCCompression(), gpuMipsUnorm, gpuMipsSrgb };
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = fnv1a(hash, &TEXTURE_CACHE_VERSION, sizeof(TEXTURE_CACHE_VERSION));
+	hash = fnv1a(hash, path.c_str(), path.size() + 1);
+	hash = fnv1a(hash, &fileSize, sizeof(fileSize));
+	hash = fnv1a(hash, &writeTime, sizeof(writeTime));
+	hash = fnv1a(hash, flags, sizeof(flags));
+
+	return hash;
+}
+
+std::string B3DTextureLibrary::cachePath(uint64_t hash) const
+{
+	std::ostringstream path;
+	path << TEXTURE_CACHE_DIRECTORY << '/' << std::hex << hash << ".b3dtex";
+
+	return path.str();
+}
+
+std::unique_ptr<B3DBuffer> B3DTextureLibrary::createStaging(const B3DTextureProcessing::TextureData& data)
+{
+	auto staging = std::make_unique<B3DBuffer>(libraryDevice, data.bytes.size(), 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	staging->map();
+	staging->writeToBuffer(data.bytes.data());
+
+	return staging;
+}
+
+void B3DTextureLibrary::recordUpload(VkCommandBuffer commandBuffer, PendingUpload& upload)
+{
+	B3DTexture& texture = *upload.texture;
+	auto& data = upload.data;
+
+	assert(texture.getImage() == VK_NULL_HANDLE && "Texture image already created!");
+
+	const bool streamed = !upload.streamPath.empty();
+	const auto& top = data.mips[data.baseMip];
+	const uint32_t mipLevels = data.gpuMips ? data.gpuMipLevels : static_cast<uint32_t>(data.mips.size()) - data.baseMip;
+
+	//Streamed images are copied from when their mips change
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (data.gpuMips || streamed)
+	{
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	texture.textureImage = B3DTexture::createGpuImage(libraryDevice, top.width, top.height, mipLevels, static_cast<VkFormat>(data.format), usage);
+	texture.textureFormat = static_cast<VkFormat>(data.format);
+	texture.textureWidth = data.width;
+	texture.textureHeight = data.height;
+	texture.textureMipLevels = mipLevels;
+	texture.residentMip = data.baseMip;
+
+	auto staging = createStaging(data);
+
+	VkImageMemoryBarrier toTransfer = imageBarrier(texture.getImage(), 0, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	std::vector<VkBufferImageCopy> regions{};
+	for (uint32_t level = data.baseMip; level < data.baseMip + data.loadedMips; level++)
+	{
+		const auto& mip = data.mips[level];
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = mip.offset - data.bytesOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level - data.baseMip;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { mip.width, mip.height, 1 };
+		regions.push_back(region);
+	}
+
+	vkCmdCopyBufferToImage(commandBuffer, staging->getBuffer(), texture.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+	if (data.gpuMips)
+	{
+		recordGpuMips(commandBuffer, texture);
+	}
+	else
+	{
+		VkImageMemoryBarrier toShader = imageBarrier(texture.getImage(), 0, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShader);
+	}
+
+	//A fresh slot nothing in flight can be reading, so it can be written while earlier frames are still on the GPU
+	texture.bindlessIndex = libraryHeap.addTexture(texture.getImageView(), textureSampler);
+	texture.ready.store(texture.bindlessIndex != B3DBindlessHeap::INVALID_INDEX, std::memory_order_release);
+
+	stagingBuffers.push_back({ std::move(staging), libraryDevice.getGraphicsTimeline().getFrameValue() });
+
+	if (streamed)
+	{
+		texture.streamed = true;
+		texture.streamPath = std::move(upload.streamPath);
+		texture.streamHash = upload.streamHash;
+		texture.mipChain = data.mips;
+		texture.floorMip = data.baseMip;
+		texture.requestedMip = data.baseMip;
+		texture.lastNeededFrame = frameCounter;
+
+		streamedTextures.push_back(upload.texture);
+	}
+}
+
+void B3DTextureLibrary::recordGpuMips(VkCommandBuffer commandBuffer, B3DTexture& texture)
+{
+	int32_t mipWidth = static_cast<int32_t>(texture.getWidth());
+	int32_t mipHeight = static_cast<int32_t>(texture.getHeight());
+
+	//Each level is blitted from the one above it, which is moved to a transfer source and then on to shader reads once used
+	for (uint32_t level = 1; level < texture.getMipLevels(); level++)
+	{
+		VkImageMemoryBarrier toSource = imageBarrier(texture.getImage(), level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSource);
+
+		VkImageBlit blit{};
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[1] = { std::max(1, mipWidth / 2), std::max(1, mipHeight / 2), 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, texture.getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		VkImageMemoryBarrier toShader = imageBarrier(texture.getImage(), level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShader);
+
+		mipWidth = std::max(1, mipWidth / 2);
+		mipHeight = std::max(1, mipHeight / 2);
+	}
+
+	VkImageMemoryBarrier lastToShader = imageBarrier(texture.getImage(), texture.getMipLevels() - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &lastToShader);
+}
+
+void B3DTextureLibrary::updateResidency(VkCommandBuffer commandBuffer)
+{
+	//Textures whose cache went missing keep their current image and drop out of streaming
+	streamedTextures.erase(std::remove_if(streamedTextures.begin(), streamedTextures.end(), [](const std::shared_ptr<B3DTexture>& texture) { return !texture->streamed; }), streamedTextures.end());
+
+	for (const auto& texture : streamedTextures)
+	{
+		if (texture->streamPending || texture->lastNeededFrame != frameCounter || texture->requestedMip >= texture->residentMip) continue;
+
+		//Space is made before the read so the levels have somewhere to go when they arrive
+		if (makeRoom(commandBuffer, growthBytes(*texture, texture->requestedMip), texture.get()))
+		{
+			streamIn(texture, texture->requestedMip);
+		}
+	}
+
+	//Catches a budget that was lowered since the last frame
+	makeRoom(commandBuffer, 0, nullptr);
+}
+
+void B3DTextureLibrary::streamIn(const std::shared_ptr<B3DTexture>& texture, uint32_t firstMip)
+{
+	texture->streamPending = true;
+
+	const uint32_t mipCount = texture->residentMip - firstMip;
+
+	libraryJobs.run([this, texture, path = texture->streamPath, hash = texture->streamHash, firstMip, mipCount]()
+	{
+		B3D_PROFILE_SCOPE("Stream texture mips");
+
+		PendingUpload stream{ texture, {} };
+
+		if (!B3DTextureProcessing::readContainer(path, hash, stream.data, firstMip, mipCount))
+		{
+			PLOGW << "Failed to stream mips from " << path << ", the texture stays at mip " << firstMip + mipCount;
+			stream.data = B3DTextureProcessing::TextureData{};
+		}
+
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		pendingStreams.push_back(std::move(stream));
+	}, "Stream texture", loadCounter);
+}
+
+bool B3DTextureLibrary::makeRoom(VkCommandBuffer commandBuffer, VkDeviceSize bytes, const B3DTexture* keep)
+{
+	VkDeviceSize used = streamingMemory();
+	if (used + bytes <= streamingBudget) return true;
+
+	//Nothing is evicted for a request that could not be met anyway
+	VkDeviceSize evictable = 0;
+	for (const auto& texture : streamedTextures)
+	{
+		if (texture.get() == keep || texture->streamPending || texture->residentMip >= evictLimit(*texture)) continue;
+		evictable += texture->getMemorySize() - std::min(texture->getMemorySize(), allocationBytes(*texture, evictLimit(*texture)));
+	}
+
+	if (used + bytes > streamingBudget + evictable) return false;
+
+	while (used + bytes > streamingBudget)
+	{
+		//Least recently needed first, and never a level something asked for this frame
+		B3DTexture* victim = nullptr;
+
+		for (const auto& texture : streamedTextures)
+		{
+			if (texture.get() == keep || texture->streamPending || texture->residentMip >= evictLimit(*texture)) continue;
+
+			if (!victim || texture->lastNeededFrame < victim->lastNeededFrame)
+			{
+				victim = texture.get();
+			}
+		}
+
+		if (!victim) return false;
+
+		//The victim gives up its finest levels until enough is freed, then is rebuilt once
+		const uint32_t limit = evictLimit(*victim);
+		const VkDeviceSize before = victim->getMemorySize();
+		uint32_t firstMip = victim->residentMip;
+		VkDeviceSize freed = 0;
+
+		while (firstMip < limit && used - freed + bytes > streamingBudget)
+		{
+			firstMip++;
+			freed = before - std::min(before, allocationBytes(*victim, firstMip));
+		}
+
+		recordResidencyChange(commandBuffer, *victim, firstMip, nullptr);
+		used = used - before + victim->getMemorySize();
+	}
+
+	return true;
+}
+
+uint32_t B3DTextureLibrary::evictLimit(const B3DTexture& texture) const
+{
+	return texture.lastNeededFrame == frameCounter ? std::min(texture.requestedMip, texture.floorMip) : texture.floorMip;
+}
+
+VkDeviceSize B3DTextureLibrary::allocationBytes(B3DTexture& texture, uint32_t firstMip)
+{
+	texture.allocationSizes.resize(texture.mipChain.size(), 0);
+
+	VkDeviceSize& size = texture.allocationSizes[firstMip];
+	if (size == 0)
+	{
+		const auto& top = texture.mipChain[firstMip];
+		size = B3DTexture::queryImageSize(libraryDevice, top.width, top.height, static_cast<uint32_t>(texture.mipChain.size()) - firstMip, texture.textureFormat, STREAMED_IMAGE_USAGE);
+	}
+
+	return size;
+}
+
+VkDeviceSize B3DTextureLibrary::growthBytes(B3DTexture& texture, uint32_t firstMip)
+{
+	const VkDeviceSize size = allocationBytes(texture, firstMip);
+	return size > texture.getMemorySize() ? size - texture.getMemorySize() : 0;
+}
+
+void B3DTextureLibrary::recordResidencyChange(VkCommandBuffer commandBuffer, B3DTexture& texture, uint32_t firstMip, const B3DTextureProcessing::TextureData* data)
+{
+	const uint32_t oldFirstMip = texture.residentMip;
+	const uint32_t oldMipLevels = texture.textureMipLevels;
+	const uint32_t mipLevels = static_cast<uint32_t>(texture.mipChain.size()) - firstMip;
+	const auto& top = texture.mipChain[firstMip];
+
+	B3DTexture::GpuImage oldImage = texture.textureImage;
+	B3DTexture::GpuImage newImage = B3DTexture::createGpuImage(libraryDevice, top.width, top.height, mipLevels, texture.textureFormat, STREAMED_IMAGE_USAGE);
+
+	VkImageMemoryBarrier toTransfer[] =
+	{
+		imageBarrier(newImage.image, 0, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT),
+		imageBarrier(oldImage.image, 0, oldMipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT)
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, toTransfer);
+
+	//Levels both images hold move across on the GPU
+	std::vector<VkImageCopy> copies{};
+	for (uint32_t level = std::max(firstMip, oldFirstMip); level < texture.mipChain.size(); level++)
+	{
+		VkImageCopy copy{};
+		copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - oldFirstMip, 0, 1 };
+		copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - firstMip, 0, 1 };
+		copy.extent = { texture.mipChain[level].width, texture.mipChain[level].height, 1 };
+		copies.push_back(copy);
+	}
+
+	vkCmdCopyImage(commandBuffer, oldImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+	//Finer levels come from the cache
+	if (data)
+	{
+		auto staging = createStaging(*data);
+
+		std::vector<VkBufferImageCopy> regions{};
+		for (uint32_t level = firstMip; level < oldFirstMip; level++)
+		{
+			const auto& mip = data->mips[level];
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = mip.offset - data->bytesOffset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level - firstMip;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { mip.width, mip.height, 1 };
+			regions.push_back(region);
+		}
+
+		vkCmdCopyBufferToImage(commandBuffer, staging->getBuffer(), newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+		stagingBuffers.push_back({ std::move(staging), libraryDevice.getGraphicsTimeline().getFrameValue() });
+	}
+
+	//The old slot stays live until the heap lets it go, so the old image goes back to the layout it was registered with
+	VkImageMemoryBarrier toShader[] =
+	{
+		imageBarrier(newImage.image, 0, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		imageBarrier(oldImage.image, 0, oldMipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT)
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, toShader);
+
+	texture.textureImage = newImage;
+	texture.textureMipLevels = mipLevels;
+	texture.residentMip = firstMip;
+
+	//Frames in flight may still sample the old image through the old slot
+	retireQueue->retire(oldImage);
+	libraryHeap.removeTexture(texture.bindlessIndex);
+
+	texture.bindlessIndex = libraryHeap.addTexture(newImage.view, textureSampler);
+	texture.ready.store(texture.bindlessIndex != B3DBindlessHeap::INVALID_INDEX, std::memory_order_release);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+//Local
+#include "B3DDevice.h"
+#include "B3DBuffer.h"
+#include "B3DBindless.h"
+#include "B3DJobSystem.h"
+#include "B3DSwapChain.h"
+#include "B3DTexture.h"
+#include "B3DTextureProcessing.h"
+
+//STD
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TextureLoadOptions
+{
+	//Color textures are sRGB, data textures such as normal maps are not
+	bool srgb = true;
+	bool generateMips = true;
+
+	//BC1 on devices that support it, the result is cached so only the first load pays for it
+	bool compress = false;
+
+	//Only the coarse mips are uploaded at first, finer ones are read from the cache as B3DTextureStreamer asks for them.
+	//Needs generateMips, and the mips are then made on the CPU so the cache holds every level
+	bool stream = false;
+};
+
+//Texture loading for Based 3D.
+//Files are decoded and processed on the job system and the result is stored in TEXTURE_CACHE_DIRECTORY, so later runs upload
+//straight from the cache. Uploads are recorded into the frame's command buffer and their staging memory is recycled when the
+//frame's slot comes around again, the render loop never waits on a texture.
+//Streamed textures keep the levels asked for through requestMip resident, and give up their finest levels, least recently needed
+//first, when they would go over the memory budget.
+//Requires B3DDevice::supportsBindless.
+class B3DTextureLibrary
+{
+	public:
+
+		static constexpr const char* TEXTURE_CACHE_DIRECTORY = "texture_cache";
+		static constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+
+		//Textures past this are left for the next frame, at least one texture is always uploaded
+		static constexpr VkDeviceSize UPLOAD_BUDGET_PER_FRAME = 64ull * 1024 * 1024;
+
+		//Levels this size and smaller are uploaded with a streamed texture and never evicted
+		static constexpr uint32_t STREAMING_RESIDENT_SIZE = 64;
+		static constexpr VkDeviceSize DEFAULT_STREAMING_BUDGET = 256ull * 1024 * 1024;
+
+		B3DTextureLibrary(B3DDevice& device, B3DJobSystem& jobSystem, B3DBindlessHeap& heap);
+		~B3DTextureLibrary();
+
+		B3DTextureLibrary(const B3DTextureLibrary&) = delete;
+		B3DTextureLibrary& operator=(const B3DTextureLibrary&) = delete;
+
+		//Returns at once, loading the same file with the same options again returns the same texture
+		std::shared_ptr<B3DTexture> load(const std::string& path, const TextureLoadOptions& options = TextureLoadOptions{});
+
+		//Call after B3DRenderer::beginFrame
+		void beginFrame();
+
+		//Call before the frame's first render pass, also records this frame's streaming changes
+		void recordUploads(VkCommandBuffer commandBuffer);
+
+		//The finest level a streamed texture needs this frame, calls for the same texture keep the finest. Render thread only
+		void requestMip(B3DTexture& texture, uint32_t mip);
+
+		//Device memory all streamed textures together may use, their always-resident coarse levels are allowed past it
+		void setStreamingBudget(VkDeviceSize bytes) { streamingBudget = bytes; }
+		VkDeviceSize getStreamingBudget() const { return streamingBudget; }
+		VkDeviceSize streamingMemory() const;
+
+		VkSampler getSampler() const { return textureSampler; }
+		size_t pendingUploadCount() const;
+
+	private:
+
+		struct PendingUpload
+		{
+			std::shared_ptr<B3DTexture> texture;
+			B3DTextureProcessing::TextureData data;
+
+			//Set when the texture streams, finer levels are read back from this container
+			std::string streamPath;
+			uint64_t streamHash = 0;
+		};
+
+		//Released once the graphics timeline passes the frame that last used it
+		struct RetiredStaging
+		{
+			std::unique_ptr<B3DBuffer> buffer;
+			uint64_t releaseValue;
+		};
+
+		B3DDevice& libraryDevice;
+		B3DJobSystem& libraryJobs;
+		B3DBindlessHeap& libraryHeap;
+
+		//Old images of streamed textures and those of destroyed textures wait here for the frames sampling them
+		std::shared_ptr<B3DTexture::RetireQueue> retireQueue;
+
+		VkSampler textureSampler = VK_NULL_HANDLE;
+
+		//Mips are blitted on the GPU when the format allows it and nothing needs them on the CPU
+		bool gpuMipsUnorm = false;
+		bool gpuMipsSrgb = false;
+
+		mutable std::mutex libraryMutex;
+		std::unordered_map<std::string, std::shared_ptr<B3DTexture>> loadedTextures;
+		std::deque<PendingUpload> pendingUploads;
+		std::deque<PendingUpload> pendingStreams;
+		B3DJobSystem::JobHandle loadCounter;
+
+		uint64_t frameCounter = 0;
+		std::deque<RetiredStaging> stagingBuffers;
+
+		//Render thread only
+		std::vector<std::shared_ptr<B3DTexture>> streamedTextures;
+		VkDeviceSize streamingBudget = DEFAULT_STREAMING_BUDGET;
+
+		void createSampler();
+
+		void loadTexture(const std::string& path, const TextureLoadOptions& options, std::shared_ptr<B3DTexture> texture);
+		bool decodeTexture(const std::string& path, const TextureLoadOptions& options, B3DTextureProcessing::TextureData& data) const;
+		uint64_t hashSource(const std::string& path, const TextureLoadOptions& options) const;
+		std::string cachePath(uint64_t hash) const;
+
+		std::unique_ptr<B3DBuffer> createStaging(const B3DTextureProcessing::TextureData& data);
+
+		void recordUpload(VkCommandBuffer commandBuffer, PendingUpload& upload);
+		void recordGpuMips(VkCommandBuffer commandBuffer, B3DTexture& texture);
+
+		void updateResidency(VkCommandBuffer commandBuffer);
+		void streamIn(const std::shared_ptr<B3DTexture>& texture, uint32_t firstMip);
+		bool makeRoom(VkCommandBuffer commandBuffer, VkDeviceSize bytes, const B3DTexture* keep);
+		uint32_t evictLimit(const B3DTexture& texture) const;
+
+		//Budgets are kept in allocation sizes, the same measure B3DTexture::getMemorySize uses, not in raw level bytes
+		VkDeviceSize allocationBytes(B3DTexture& texture, uint32_t firstMip);
+		VkDeviceSize growthBytes(B3DTexture& texture, uint32_t firstMip);
+
+		//Rebuilds the image to hold levels firstMip onwards of the full chain. Levels already resident are copied across,
+		//finer ones come from data. The texture moves to a new bindless slot and the old image is retired
+		void recordResidencyChange(VkCommandBuffer commandBuffer, B3DTexture& texture, uint32_t firstMip, const B3DTextureProcessing::TextureData* data);
+};
@@ -0,0 +1,454 @@
+#include "B3DTextureProcessing.h"
+
+//STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define B3D_TEXTURE_SSE2 1
+#endif
+
+namespace
+{
+	constexpr uint32_t CONTAINER_MAGIC = 0x54443342; //"B3DT"
+	constexpr uint32_t CONTAINER_VERSION = 1;
+
+	//sRGB is decoded through a table and encoded through a finer one, 4096 steps keep the round trip exact for every 8 bit value
+	constexpr uint32_t LINEAR_TO_SRGB_STEPS = 4096;
+
+	struct SrgbTables
+	{
+		std::array<float, 256> toLinear;
+		std::array<uint8_t, LINEAR_TO_SRGB_STEPS + 1> toSrgb;
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = i / 255.f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (uint32_t i = 0; i <= LINEAR_TO_SRGB_STEPS; i++)
+			{
+				float l = static_cast<float>(i) / LINEAR_TO_SRGB_STEPS;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+				toSrgb[i] = static_cast<uint8_t>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables()
+	{
+		static const SrgbTables tables{};
+		return tables;
+	}
+
+	void downsampleSrgb(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		const SrgbTables& tables = srgbTables();
+
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				const size_t x0 = static_cast<size_t>(std::min(2 * x, srcWidth - 1)) * 4;
+				const size_t x1 = static_cast<size_t>(std::min(2 * x + 1, srcWidth - 1)) * 4;
+				uint8_t* out = dst + (static_cast<size_t>(y) * dstWidth + x) * 4;
+
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+					out[c] = tables.toSrgb[static_cast<uint32_t>(sum * 0.25f * LINEAR_TO_SRGB_STEPS + 0.5f)];
+				}
+
+				out[3] = static_cast<uint8_t>((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+			}
+		}
+	}
+
+	void downsampleUnorm(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+			uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+			uint32_t x = 0;
+
+#ifdef B3D_TEXTURE_SSE2
+			//Two output texels per step, each the rounded average of a 2x2 footprint widened to 16 bits
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i two = _mm_set1_epi16(2);
+
+			for (; 2 * x + 3 < srcWidth && x + 1 < dstWidth; x += 2)
+			{
+				__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + static_cast<size_t>(x) * 8));
+				__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + static_cast<size_t>(x) * 8));
+
+				__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+				right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+				__m128i sum = _mm_unpacklo_epi64(left, right);
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + static_cast<size_t>(x) * 4), _mm_packus_epi16(sum, zero));
+			}
+#endif
+
+			for (; x < dstWidth; x++)
+			{
+				const size_t x0 = static_cast<size_t>(std::min(2 * x, srcWidth - 1)) * 4;
+				const size_t x1 = static_cast<size_t>(std::min(2 * x + 1, srcWidth - 1)) * 4;
+
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+				}
+			}
+		}
+	}
+
+	uint16_t packRgb565(int r, int g, int b)
+	{
+		return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+	}
+
+	void unpackRgb565(uint16_t color, int rgb[3])
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	//Bounding box endpoints inset by a sixteenth of the range, then every texel snaps to the nearest of the four palette entries
+	void encodeBC1Block(const uint8_t texels[16][4], uint8_t block[8])
+	{
+		int minColor[3] = { 255, 255, 255 };
+		int maxColor[3] = { 0, 0, 0 };
+
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				minColor[c] = std::min<int>(minColor[c], texels[i][c]);
+				maxColor[c] = std::max<int>(maxColor[c], texels[i][c]);
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			int inset = (maxColor[c] - minColor[c]) / 16;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		uint16_t color0 = packRgb565(maxColor[0], maxColor[1], maxColor[2]);
+		uint16_t color1 = packRgb565(minColor[0], minColor[1], minColor[2]);
+
+		//color0 > color1 selects the four color mode
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		uint32_t indices = 0;
+
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			unpackRgb565(color0, palette[0]);
+			unpackRgb565(color1, palette[1]);
+
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				int bestDistance = INT32_MAX;
+
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					int dr = texels[i][0] - palette[p][0];
+					int dg = texels[i][1] - palette[p][1];
+					int db = texels[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+
+				indices |= best << (2 * i);
+			}
+		}
+
+		block[0] = static_cast<uint8_t>(color0 & 0xFF);
+		block[1] = static_cast<uint8_t>(color0 >> 8);
+		block[2] = static_cast<uint8_t>(color1 & 0xFF);
+		block[3] = static_cast<uint8_t>(color1 >> 8);
+		block[4] = static_cast<uint8_t>(indices & 0xFF);
+		block[5] = static_cast<uint8_t>((indices >> 8) & 0xFF);
+		block[6] = static_cast<uint8_t>((indices >> 16) & 0xFF);
+		block[7] = static_cast<uint8_t>(indices >> 24);
+	}
+
+	template<typename T>
+	void writeValue(std::ofstream& file, T value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool readValue(std::ifstream& file, T& value)
+	{
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+uint32_t B3DTextureProcessing::mipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+
+	while (size > 1)
+	{
+		size /= 2;
+		levels++;
+	}
+
+	return levels;
+}
+
+void B3DTextureProcessing::generateMips(TextureData& data, bool srgb)
+{
+	if (data.mips.empty()) return;
+
+	const uint32_t levelCount = mipLevelCount(data.width, data.height);
+
+	while (data.mips.size() < levelCount)
+	{
+		const MipLevel source = data.mips.back();
+
+		MipLevel level{};
+		level.width = std::max(1u, source.width / 2);
+		level.height = std::max(1u, source.height / 2);
+		level.offset = data.bytes.size();
+		level.size = static_cast<uint64_t>(level.width) * level.height * 4;
+
+		data.bytes.resize(data.bytes.size() + level.size);
+
+		const uint8_t* src = data.bytes.data() + source.offset;
+		uint8_t* dst = data.bytes.data() + level.offset;
+
+		if (srgb)
+		{
+			downsampleSrgb(src, source.width, source.height, dst, level.width, level.height);
+		}
+		else
+		{
+			downsampleUnorm(src, source.width, source.height, dst, level.width, level.height);
+		}
+
+		data.mips.push_back(level);
+	}
+
+	data.loadedMips = static_cast<uint32_t>(data.mips.size());
+}
+
+void B3DTextureProcessing::compressBC1(TextureData& data, uint32_t bc1Format)
+{
+	std::vector<MipLevel> compressedMips;
+	std::vector<uint8_t> compressedBytes;
+
+	for (const auto& level : data.mips)
+	{
+		const uint32_t blocksX = (level.width + 3) / 4;
+		const uint32_t blocksY = (level.height + 3) / 4;
+		const uint8_t* texels = data.bytes.data() + level.offset;
+
+		MipLevel compressed{ level.width, level.height, compressedBytes.size(), static_cast<uint64_t>(blocksX) * blocksY * 8 };
+		compressedBytes.resize(compressedBytes.size() + compressed.size);
+
+		uint8_t* out = compressedBytes.data() + compressed.offset;
+
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				//Levels smaller than a block repeat their edge texels to fill it
+				uint8_t block[16][4];
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t x = std::min(bx * 4 + i % 4, level.width - 1);
+					uint32_t y = std::min(by * 4 + i / 4, level.height - 1);
+					std::memcpy(block[i], texels + (static_cast<size_t>(y) * level.width + x) * 4, 4);
+				}
+
+				encodeBC1Block(block, out);
+				out += 8;
+			}
+		}
+
+		compressedMips.push_back(compressed);
+	}
+
+	data.mips = std::move(compressedMips);
+	data.bytes = std::move(compressedBytes);
+	data.loadedMips = static_cast<uint32_t>(data.mips.size());
+	data.format = bc1Format;
+}
+
+uint32_t B3DTextureProcessing::firstMipWithin(const TextureData& data, uint32_t maxSize)
+{
+	for (uint32_t level = 0; level < data.mips.size(); level++)
+	{
+		if (std::max(data.mips[level].width, data.mips[level].height) <= maxSize) return level;
+	}
+
+	return data.mips.empty() ? 0 : static_cast<uint32_t>(data.mips.size() - 1);
+}
+
+void B3DTextureProcessing::keepMips(TextureData& data, uint32_t firstMip, uint32_t mipCount)
+{
+	const uint32_t loadedEnd = data.baseMip + data.loadedMips;
+	const uint32_t keepEnd = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(firstMip) + mipCount, loadedEnd));
+	firstMip = std::max(firstMip, data.baseMip);
+
+	if (firstMip >= keepEnd)
+	{
+		data.bytes.clear();
+		data.bytes.shrink_to_fit();
+		data.loadedMips = 0;
+		return;
+	}
+
+	const uint64_t begin = data.mips[firstMip].offset - data.bytesOffset;
+	const uint64_t end = data.mips[keepEnd - 1].offset + data.mips[keepEnd - 1].size - data.bytesOffset;
+
+	std::vector<uint8_t> kept(data.bytes.begin() + begin, data.bytes.begin() + end);
+	data.bytes = std::move(kept);
+	data.bytesOffset = data.mips[firstMip].offset;
+	data.baseMip = firstMip;
+	data.loadedMips = keepEnd - firstMip;
+}
+
+bool B3DTextureProcessing::writeContainer(const std::string& path, uint64_t sourceHash, const TextureData& data)
+{
+	if (data.baseMip != 0 || data.loadedMips != data.mips.size()) return false;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+	//Written beside the real file and renamed over it, so a reader never sees half a container
+	const std::string temporaryPath = path + ".tmp";
+
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+
+		if (!file.is_open()) return false;
+
+		writeValue(file, CONTAINER_MAGIC);
+		writeValue(file, CONTAINER_VERSION);
+		writeValue(file, sourceHash);
+		writeValue(file, data.width);
+		writeValue(file, data.height);
+		writeValue(file, data.format);
+		writeValue(file, static_cast<uint32_t>(data.gpuMips));
+		writeValue(file, data.gpuMipLevels);
+		writeValue(file, static_cast<uint32_t>(data.mips.size()));
+		writeValue(file, static_cast<uint64_t>(data.bytes.size()));
+
+		for (const auto& level : data.mips)
+		{
+			writeValue(file, level.width);
+			writeValue(file, level.height);
+			writeValue(file, level.offset);
+			writeValue(file, level.size);
+		}
+
+		file.write(reinterpret_cast<const char*>(data.bytes.data()), data.bytes.size());
+
+		if (!file) return false;
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
+
+bool B3DTextureProcessing::readContainer(const std::string& path, uint64_t sourceHash, TextureData& data, uint32_t firstMip, uint32_t mipCount)
+{
+	std::ifstream file{ path, std::ios::binary };
+
+	if (!file.is_open()) return false;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t storedHash = 0;
+
+	if (!readValue(file, magic) || !readValue(file, version) || !readValue(file, storedHash)) return false;
+	if (magic != CONTAINER_MAGIC || version != CONTAINER_VERSION || storedHash != sourceHash) return false;
+
+	uint32_t gpuMips = 0;
+	uint32_t levelCount = 0;
+	uint64_t byteCount = 0;
+
+	if (!readValue(file, data.width) || !readValue(file, data.height) || !readValue(file, data.format) || !readValue(file, gpuMips) ||
+		!readValue(file, data.gpuMipLevels) || !readValue(file, levelCount) || !readValue(file, byteCount))
+	{
+		return false;
+	}
+
+	data.gpuMips = gpuMips != 0;
+	data.mips.resize(levelCount);
+
+	for (auto& level : data.mips)
+	{
+		if (!readValue(file, level.width) || !readValue(file, level.height) || !readValue(file, level.offset) || !readValue(file, level.size)) return false;
+		if (level.offset + level.size > byteCount) return false;
+	}
+
+	data.baseMip = 0;
+	data.loadedMips = 0;
+	data.bytesOffset = 0;
+	data.bytes.clear();
+
+	if (mipCount == 0) return true;
+	if (firstMip >= levelCount) return false;
+
+	//Levels are stored finest first, so any run of them is one contiguous read
+	const uint32_t lastMip = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(firstMip) + mipCount, levelCount)) - 1;
+	const uint64_t begin = data.mips[firstMip].offset;
+	const uint64_t end = data.mips[lastMip].offset + data.mips[lastMip].size;
+
+	file.seekg(static_cast<std::streamoff>(begin), std::ios::cur);
+
+	data.baseMip = firstMip;
+	data.loadedMips = lastMip - firstMip + 1;
+	data.bytesOffset = begin;
+	data.bytes.resize(end - begin);
+
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(data.bytes.data()), data.bytes.size()));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//STD
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//CPU side texture work for Based 3D: mip generation, BC1 block compression and the GPU-ready cache container.
+//Nothing here touches Vulkan so it can run on any worker thread.
+namespace B3DTextureProcessing
+{
+	//One mip level inside a TextureData blob
+	struct MipLevel
+	{
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	//Everything needed to upload a texture, whether it came from an image file or the cache
+	struct TextureData
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		//The VkFormat the blob is laid out for
+		uint32_t format = 0;
+
+		//Only mip 0 is stored, the rest are blitted on the GPU after upload
+		bool gpuMips = false;
+		uint32_t gpuMipLevels = 1;
+
+		//Every level of the full chain. Only levels baseMip to baseMip + loadedMips - 1 are held in bytes,
+		//which starts at bytesOffset within the full chain's blob
+		std::vector<MipLevel> mips;
+		uint32_t baseMip = 0;
+		uint32_t loadedMips = 0;
+		uint64_t bytesOffset = 0;
+		std::vector<uint8_t> bytes;
+
+		const uint8_t* levelData(uint32_t level) const { return bytes.data() + (mips[level].offset - bytesOffset); }
+	};
+
+	uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+	//Appends every level below the last one in data, which must hold the whole RGBA8 chain.
+	//sRGB levels are averaged in linear space, UNORM levels take a SIMD box filter where the CPU has SSE2
+	void generateMips(TextureData& data, bool srgb);
+
+	//Replaces the RGBA8 levels with BC1 blocks, alpha is dropped
+	void compressBC1(TextureData& data, uint32_t bc1Format);
+
+	//The finest level no larger than maxSize on either side, or the last level if none are
+	uint32_t firstMipWithin(const TextureData& data, uint32_t maxSize);
+
+	//Keeps levels firstMip to firstMip + mipCount - 1 and frees the rest, the level list itself stays whole
+	void keepMips(TextureData& data, uint32_t firstMip, uint32_t mipCount = UINT32_MAX);
+
+	//Writes the whole chain, data must hold every level
+	bool writeContainer(const std::string& path, uint64_t sourceHash, const TextureData& data);
+
+	//Reads only the requested levels, a mipCount of 0 reads just the level list. Fails if the file is missing, damaged or was written for a different source
+	bool readContainer(const std::string& path, uint64_t sourceHash, TextureData& data, uint32_t firstMip = 0, uint32_t mipCount = UINT32_MAX);
+};
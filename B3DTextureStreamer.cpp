@@ -0,0 +1,89 @@
+#include "B3DTextureStreamer.h"
+
+//Local
+#include "B3DProfiler.h"
+
+//STD
+#include <algorithm>
+#include <cmath>
+
+B3DTextureStreamer::B3DTextureStreamer(B3DTextureLibrary& textureLibrary, B3DMaterialLibrary& materialLibrary) : streamerTextures{ textureLibrary }, streamerMaterials{ materialLibrary }
+{
+
+}
+
+void B3DTextureStreamer::update(const B3DCamera& camera, VkExtent2D extent, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects)
+{
+	B3D_PROFILE_FUNCTION();
+
+	const glm::mat4& projection = camera.getProjection();
+	const glm::mat4& view = camera.getView();
+	const auto planes = extractFrustumPlanes(projection * view);
+
+	//Screen pixels covered by one world unit at a view depth of 1
+	const float pixelsPerUnit = std::abs(projection[1][1]) * extent.height * 0.5f;
+
+	materialTextures.assign(streamerMaterials.materialCount(), nullptr);
+	materialLooked.assign(materialTextures.size(), false);
+
+	for (const auto& obj : gameObjects)
+	{
+		if (!obj.model || obj.model->getUvDensity() <= 0.f || obj.materialId >= materialTextures.size()) continue;
+
+		if (!materialLooked[obj.materialId])
+		{
+			auto texture = streamerMaterials.getAlbedoTexture(obj.materialId);
+			materialTextures[obj.materialId] = texture && texture->isStreamed() ? texture : nullptr;
+			materialLooked[obj.materialId] = true;
+		}
+
+		B3DTexture* texture = materialTextures[obj.materialId].get();
+		if (!texture) continue;
+
+		const glm::mat4 world = obj.sceneNode != B3DSceneGraph::INVALID_NODE ? sceneGraph.getWorldMatrix(obj.sceneNode) : obj.transform.mat4();
+		const float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+		if (scale <= 0.f) continue;
+
+		const glm::vec4 center = world * glm::vec4(obj.model->getBoundingCenter(), 1.f);
+		const float radius = obj.model->getBoundingRadius() * scale;
+
+		bool visible = true;
+		for (const auto& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), glm::vec3(center)) + plane.w < -radius)
+			{
+				visible = false;
+				break;
+			}
+		}
+
+		if (!visible) continue;
+
+		const float depth = std::max((view * center).z - radius, MIN_STREAMING_DEPTH);
+
+		//Texels per pixel at mip 0, each halving of it is one mip coarser
+		const float texelsPerUnit = std::sqrt(static_cast<float>(texture->getWidth()) * texture->getHeight()) * obj.model->getUvDensity() / scale;
+		const float texelsPerPixel = texelsPerUnit * depth / pixelsPerUnit;
+
+		const uint32_t mip = texelsPerPixel > 1.f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+		streamerTextures.requestMip(*texture, mip);
+	}
+}
+
+std::array<glm::vec4, 6> B3DTextureStreamer::extractFrustumPlanes(const glm::mat4& projectionView)
+{
+	//Gribb-Hartmann on the rows of the matrix, with the zero to one depth range the projection uses
+	const glm::vec4 row0{ projectionView[0][0], projectionView[1][0], projectionView[2][0], projectionView[3][0] };
+	const glm::vec4 row1{ projectionView[0][1], projectionView[1][1], projectionView[2][1], projectionView[3][1] };
+	const glm::vec4 row2{ projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2] };
+	const glm::vec4 row3{ projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3] };
+
+	std::array<glm::vec4, 6> planes{ row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+
+	for (auto& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return planes;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+//Local
+#include "B3DCamera.h"
+#include "B3DGameObj.h"
+#include "B3DMaterialLibrary.h"
+#include "B3DSceneGraph.h"
+#include "B3DTextureLibrary.h"
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+//STD
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//Picks the mip each streamed texture needs from what is on screen.
+//Every visible object asks for the level whose texels land closest to one per pixel, judged from its bounding sphere's nearest
+//point and its model's UV density. B3DTextureLibrary does the streaming and eviction.
+class B3DTextureStreamer
+{
+	public:
+
+		//Keeps a camera inside a bounding sphere from asking for a level past mip 0
+		static constexpr float MIN_STREAMING_DEPTH = 0.01f;
+
+		B3DTextureStreamer(B3DTextureLibrary& textureLibrary, B3DMaterialLibrary& materialLibrary);
+
+		B3DTextureStreamer(const B3DTextureStreamer&) = delete;
+		B3DTextureStreamer& operator=(const B3DTextureStreamer&) = delete;
+
+		//Call after B3DTextureLibrary::beginFrame and the scene graph update, before recordUploads
+		void update(const B3DCamera& camera, VkExtent2D extent, const B3DSceneGraph& sceneGraph, const std::vector<B3DGameObj>& gameObjects);
+
+	private:
+
+		B3DTextureLibrary& streamerTextures;
+		B3DMaterialLibrary& streamerMaterials;
+
+		//Looked up once per material per update
+		std::vector<std::shared_ptr<B3DTexture>> materialTextures;
+		std::vector<bool> materialLooked;
+
+		static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& projectionView);
+};
@@ -0,0 +1,141 @@
+#include "B3DTimeline.h"
+
+//STD
+#include <array>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+B3DTimeline::B3DTimeline(VkDevice device, VkQueue queue, bool useExtension) : timelineDevice{ device }, timelineQueue{ queue }
+{
+	waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(device, useExtension ? "vkWaitSemaphoresKHR" : "vkWaitSemaphores"));
+	getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(vkGetDeviceProcAddr(device, useExtension ? "vkGetSemaphoreCounterValueKHR" : "vkGetSemaphoreCounterValue"));
+
+	if (waitSemaphores == nullptr || getSemaphoreCounterValue == nullptr)
+	{
+		throw std::runtime_error("Failed to load timeline semaphore functions!");
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+}
+
+B3DTimeline::~B3DTimeline()
+{
+	vkDestroySemaphore(timelineDevice, semaphore, nullptr);
+}
+
+uint64_t B3DTimeline::submit(VkSubmitInfo submitInfo)
+{
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	const uint64_t value = submittedValue.load(std::memory_order_relaxed) + 1;
+	if (value >= frameValue.load(std::memory_order_relaxed))
+	{
+		throw std::runtime_error("Too many submits between two frames!");
+	}
+
+	submitLocked(submitInfo, value);
+	return value;
+}
+
+uint64_t B3DTimeline::submitFrame(VkSubmitInfo submitInfo)
+{
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	const uint64_t value = frameValue.load(std::memory_order_relaxed);
+	submitLocked(submitInfo, value);
+
+	frameValue.store(value + FRAME_VALUE_STRIDE, std::memory_order_release);
+	return value;
+}
+
+void B3DTimeline::submitLocked(VkSubmitInfo submitInfo, uint64_t value)
+{
+	assert(submitInfo.signalSemaphoreCount < MAX_SIGNAL_SEMAPHORES && "Too many semaphores signaled alongside the timeline!");
+
+	//Binary semaphores ignore their value, but every signal needs one once a timeline is in the batch
+	std::array<VkSemaphore, MAX_SIGNAL_SEMAPHORES> signalSemaphores{};
+	std::array<uint64_t, MAX_SIGNAL_SEMAPHORES> signalValues{};
+
+	for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++)
+	{
+		signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+	}
+
+	signalSemaphores[submitInfo.signalSemaphoreCount] = semaphore;
+	signalValues[submitInfo.signalSemaphoreCount] = value;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext = submitInfo.pNext;
+	timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount + 1;
+	timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.signalSemaphoreCount++;
+	submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+	if (vkQueueSubmit(timelineQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit command buffers!");
+	}
+
+	submittedValue.store(value, std::memory_order_release);
+}
+
+uint64_t B3DTimeline::getCompletedValue()
+{
+	uint64_t value = 0;
+	if (getSemaphoreCounterValue(timelineDevice, semaphore, &value) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to read timeline semaphore!");
+	}
+
+	markCompleted(value);
+	return value;
+}
+
+bool B3DTimeline::isComplete(uint64_t value)
+{
+	return value <= completedValue.load(std::memory_order_acquire) || value <= getCompletedValue();
+}
+
+void B3DTimeline::wait(uint64_t value)
+{
+	if (isComplete(value)) return;
+
+	assert(value <= getSubmittedValue() && "Waiting on a timeline value nothing will signal!");
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	if (waitSemaphores(timelineDevice, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to wait on timeline semaphore!");
+	}
+
+	markCompleted(value);
+}
+
+void B3DTimeline::markCompleted(uint64_t value)
+{
+	uint64_t known = completedValue.load(std::memory_order_relaxed);
+	while (value > known && !completedValue.compare_exchange_weak(known, value, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
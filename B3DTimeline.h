@@ -0,0 +1,72 @@
+#pragma once
+
+//Vulkan
+#include <vulkan/vulkan.h>
+
+//STD
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+//Queue timeline for Based 3D.
+//Every batch submitted through it signals a timeline semaphore with the next value of a counter, so one number says how far
+//the queue has got. The CPU can poll or wait on any value, and anything that must outlive GPU work, like readbacks and
+//resources waiting to be destroyed, just remembers the value that covers it instead of owning a fence.
+//Frames signal values reserved FRAME_VALUE_STRIDE apart, and other submits take the values in between, so work retired while a
+//frame records can key on that frame's value even if a one-off submit reaches the queue first.
+class B3DTimeline
+{
+	public:
+
+		//Binary semaphores a single submit can signal alongside the timeline
+		static constexpr uint32_t MAX_SIGNAL_SEMAPHORES = 4;
+
+		//Room left between two frames' values for other submits
+		static constexpr uint64_t FRAME_VALUE_STRIDE = 1ull << 20;
+
+		//useExtension loads the VK_KHR_timeline_semaphore entry points for devices older than Vulkan 1.2
+		B3DTimeline(VkDevice device, VkQueue queue, bool useExtension);
+		~B3DTimeline();
+
+		B3DTimeline(const B3DTimeline&) = delete;
+		B3DTimeline& operator=(const B3DTimeline&) = delete;
+
+		//Submits one batch that also signals the next value below the frame's, and returns that value
+		uint64_t submit(VkSubmitInfo submitInfo);
+
+		//Submits the frame's batch, which signals the reserved frame value, then reserves the next frame's
+		uint64_t submitFrame(VkSubmitInfo submitInfo);
+
+		//The value signaled by the last submit
+		uint64_t getSubmittedValue() const { return submittedValue.load(std::memory_order_acquire); }
+
+		//The value the frame being recorded signals when it submits, which covers anything recorded or retired now.
+		//framesAhead counts frames after that one
+		uint64_t getFrameValue(uint32_t framesAhead = 0) const { return frameValue.load(std::memory_order_acquire) + framesAhead * FRAME_VALUE_STRIDE; }
+
+		//Polls the semaphore, never waits
+		uint64_t getCompletedValue();
+		bool isComplete(uint64_t value);
+
+		void wait(uint64_t value);
+
+	private:
+
+		VkDevice timelineDevice;
+		VkQueue timelineQueue;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+
+		PFN_vkWaitSemaphores waitSemaphores = nullptr;
+		PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+
+		//The queue must be externally synchronised, so submits are serialised here
+		std::mutex submitMutex;
+		std::atomic<uint64_t> submittedValue{ 0 };
+		std::atomic<uint64_t> frameValue{ FRAME_VALUE_STRIDE };
+
+		//Last value seen complete, so values already known to be done are answered without a call into the driver
+		std::atomic<uint64_t> completedValue{ 0 };
+
+		void markCompleted(uint64_t value);
+		void submitLocked(VkSubmitInfo submitInfo, uint64_t value);
+};
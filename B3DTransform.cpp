@@ -1,6 +1,6 @@
-#include "B3DGameObj.h"
+#include "B3DTransform.h"
 
-glm::mat4 TransformComponent::mat4()
+glm::mat4 TransformComponent::mat4() const
 {
 	const float c3 = glm::cos(rotation.z);
 	const float s3 = glm::sin(rotation.z);
@@ -12,7 +12,7 @@ glm::mat4 TransformComponent::mat4()
 	return glm::mat4{ {scale.x * (c1 * c3 + s1 * s2 * s3), scale.x * (c2 * s3), scale.x * (c1 * s2 * s3 - c3 * s1), 0.0f,}, {scale.y * (c3 * s1 * s2 - c1 * s3), scale.y * (c2 * c3), scale.y * (c1 * c3 * s2 + s1 * s3), 0.0f,}, {scale.z * (c2 * s1), scale.z * (-s2), scale.z * (c1 * c2), 0.0f, }, {translation.x, translation.y, translation.z, 1.0f} };
 }
 
-glm::mat3 TransformComponent::normalMatrix()
+glm::mat3 TransformComponent::normalMatrix() const
 {
 	const float c3 = glm::cos(rotation.z);
 	const float s3 = glm::sin(rotation.z);
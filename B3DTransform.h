@@ -0,0 +1,17 @@
+#pragma once
+
+//GLM
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+struct TransformComponent
+{
+	glm::vec3 translation{};
+	glm::vec3 scale{1.f, 1.f, 1.f};
+	glm::vec3 rotation{};
+
+	glm::mat4 mat4() const;
+	glm::mat3 normalMatrix() const;
+};
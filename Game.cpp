@@ -1,16 +1,81 @@
 #include "Game.h"
 #include <iostream>
+#include <random>
 
 struct GlobalUbo
 {
     glm::mat4 projectionView{ 1.f };
-    glm::vec3 lightDirection = glm::normalize(glm::vec3{ 1.f, -3.f, -1.f });
+    glm::mat4 view{ 1.f };
+    alignas(16) glm::vec3 lightDirection = glm::normalize(glm::vec3{ 1.f, -3.f, -1.f });
+
+    //std140 starts a struct on a 16 byte boundary
+    alignas(16) B3DClusteredLighting::ClusterUniforms clusters{};
+    alignas(16) B3DShadowMaps::ShadowUniforms shadows{};
 };
 
-Game::Game()
+Game::Game(const GameOptions& options) : gameOptions{ resolveOptions(options) }, gameWindow{ gameOptions.headless ? nullptr : std::make_unique<B3DWindow>(gameOptions.width, gameOptions.height, "Based Engine 3D") }
 {
-    globalPool = B3DDescriptorPool::Builder(gameDevice).setMaxSets(B3DSwapChain::MAX_FRAMES_IN_FLIGHT).addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, B3DSwapChain::MAX_FRAMES_IN_FLIGHT).build();
+    if (gameOptions.headless)
+    {
+        PLOGI << "Running headless at " << gameOptions.width << "x" << gameOptions.height << " for " << gameOptions.frameCount << " frames";
+    }
+
+    if (gameOptions.benchmark)
+    {
+        benchmark = std::make_unique<B3DBenchmark>(gameOptions.benchmarkSettings);
+
+        //Timings should show what the engine can do, not the display's refresh rate
+        FramePacingPolicy policy{};
+        policy.presentModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+        gameRenderer.setFramePacingPolicy(policy);
+    }
+
+    if (gameDevice.supportsBindless())
+    {
+        bindlessHeap = std::make_unique<B3DBindlessHeap>(gameDevice);
+        materialLibrary = std::make_unique<B3DMaterialLibrary>(gameDevice, *bindlessHeap);
+        textureLibrary = std::make_unique<B3DTextureLibrary>(gameDevice, gameJobs, *bindlessHeap);
+        textureStreamer = std::make_unique<B3DTextureStreamer>(*textureLibrary, *materialLibrary);
+
+        if (gameOptions.textureBudget != 0)
+        {
+            textureLibrary->setStreamingBudget(static_cast<VkDeviceSize>(gameOptions.textureBudget) * 1024 * 1024);
+        }
+    }
+    else
+    {
+        PLOGW << "Descriptor indexing is not supported, materials are disabled";
+    }
+
 	loadGameObjects();
+
+    if (gameOptions.lightCount != 0)
+    {
+        createLights();
+    }
+
+    if (!gameOptions.albedoTexture.empty())
+    {
+        if (textureLibrary)
+        {
+            TextureLoadOptions textureOptions{};
+            textureOptions.compress = gameOptions.compressTextures;
+            textureOptions.stream = gameOptions.streamTextures;
+
+            //The material samples nothing until the texture has been decoded and uploaded
+            uint32_t texturedMaterial = materialLibrary->createMaterial(MaterialData{});
+            materialLibrary->setAlbedoTexture(texturedMaterial, textureLibrary->load(gameOptions.albedoTexture, textureOptions));
+
+            for (auto& obj : gameObjects)
+            {
+                obj.materialId = texturedMaterial;
+            }
+        }
+        else
+        {
+            PLOGW << "Ignoring " << gameOptions.albedoTexture << ", textures need descriptor indexing";
+        }
+    }
 }
 
 Game::~Game()
@@ -27,74 +92,481 @@ void Game::run()
         ubobuffers[i]->map();
     }
 
-    auto globalSetLayout = B3DDescriptorSetLayout::Builder(gameDevice).addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT).build();
+    B3DDescriptorSetLayout::Builder globalSetLayoutBuilder{ gameDevice };
+    globalSetLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+    B3DClusteredLighting::addLayoutBindings(globalSetLayoutBuilder);
+    B3DShadowMaps::addLayoutBindings(globalSetLayoutBuilder);
+    auto globalSetLayout = globalSetLayoutBuilder.build();
 
-    std::vector<VkDescriptorSet> globalDescriptorSets(B3DSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++)
-    {
-        auto bufferInfo = ubobuffers[i]->descriptorInfo();
-        B3DDescriptorWriter(*globalSetLayout, *globalPool).writeBuffer(0, &bufferInfo).build(globalDescriptorSets[i]);
-    }
+	VkRenderPass mainRenderPass = renderGraph.getCompatibleRenderPass({ gameRenderer.getSwapChainImageFormat() }, gameRenderer.getDepthFormat());
+	VkRenderPass depthPrepassRenderPass = gameOptions.depthPrepass ? renderGraph.getCompatibleRenderPass({}, gameRenderer.getDepthFormat()) : VK_NULL_HANDLE;
+	VkRenderPass shadowRenderPass = renderGraph.getCompatibleRenderPass({}, shadowMaps.getFormat());
+	SimpleRenderSystem simpleRenderSystem{ gameDevice, gameRenderer, gameJobs, pipelineRegistry, mainRenderPass, globalSetLayout->getDescriptorSetLayout(), materialLibrary.get(), depthPrepassRenderPass, shadowRenderPass };
+
+	//Null at native resolution, the main pass then draws straight into the swap chain
+	std::unique_ptr<B3DDynamicResolution> dynamicResolution;
+	if (gameOptions.dynamicResolution)
+	{
+		VkRenderPass upscaleRenderPass = renderGraph.getCompatibleRenderPass({ gameRenderer.getSwapChainImageFormat() }, VK_FORMAT_UNDEFINED);
+		dynamicResolution = std::make_unique<B3DDynamicResolution>(gameDevice, pipelineRegistry, upscaleRenderPass, gameOptions.gpuBudget);
+	}
 
-	SimpleRenderSystem simpleRenderSystem{ gameDevice, gameRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
     B3DCamera camera{};
     camera.setViewTarget(glm::vec3(-1.f, -2.f, 2.f), glm::vec3(0.f, 0.f, 2.5f));
 
     auto viewerObject = B3DGameObj::createGameObject();
     keyboardMovementController cameraController{};
 
+    //Keys are read here on the main thread and picked up by the next tick
+    std::mutex inputMutex;
+    keyboardMovementController::MovementInput latestInput{};
+
+    //Real time runs move the camera on the simulation thread, fixed timestep runs keep stepping it once a frame so they stay repeatable
+    std::unique_ptr<B3DSimulation> simulation;
+    std::vector<TransformComponent> simulatedTransforms;
+    if (gameWindow && gameOptions.fixedTimestep <= 0.f)
+    {
+        simulation = std::make_unique<B3DSimulation>(gameOptions.tickRate, std::vector<TransformComponent>{ viewerObject.transform }, [&](float dt, std::vector<TransformComponent>& transforms)
+        {
+            keyboardMovementController::MovementInput input{};
+            {
+                std::lock_guard<std::mutex> lock(inputMutex);
+                input = latestInput;
+            }
+
+            cameraController.applyInput(input, dt, transforms.front());
+        });
+    }
+
     auto currentTime = std::chrono::high_resolution_clock::now();
 
+    //Shader compiles would otherwise land inside the measured frames
+    if (benchmark)
+    {
+        pipelineRegistry.waitForAll();
+    }
+
+    B3DProfiler::setThreadName("Main thread");
+    bool captureKeyWasDown = false;
+    bool screenshotKeyWasDown = false;
+    uint32_t screenshotCount = 0;
+    uint32_t framesRendered = 0;
+
+    if (!gameOptions.captureDirectory.empty())
+    {
+        frameCapture.startSequence(gameOptions.captureDirectory, gameOptions.captureFrames, gameOptions.captureRaw ? B3DFrameCapture::Format::RAW : B3DFrameCapture::Format::PNG);
+    }
+
     PLOGI << "Game loop started";
 
-	while (!gameWindow.shouldClose())
+    B3DFramePacer& framePacer = gameRenderer.getFramePacer();
+
+	while (shouldKeepRunning(framesRendered))
 	{
-		glfwPollEvents();
+		framePacer.limitFrameRate();
+
+		if (gameWindow)
+		{
+			glfwPollEvents();
+		}
+		framePacer.markInputSampled();
+		gameJobs.runMainThreadJobs();
+
+		if (gameWindow)
+		{
+			bool captureKeyDown = glfwGetKey(gameWindow->getGLFWwindow(), PROFILE_CAPTURE_KEY) == GLFW_PRESS;
+			if (captureKeyDown && !captureKeyWasDown)
+			{
+				B3DProfiler::captureFrames(PROFILE_CAPTURE_FRAMES, "profile_capture.json");
+			}
+			captureKeyWasDown = captureKeyDown;
+
+			bool screenshotKeyDown = glfwGetKey(gameWindow->getGLFWwindow(), SCREENSHOT_KEY) == GLFW_PRESS;
+			if (screenshotKeyDown && !screenshotKeyWasDown)
+			{
+				frameCapture.captureFrame("screenshot_" + std::to_string(screenshotCount++) + ".png");
+			}
+			screenshotKeyWasDown = screenshotKeyDown;
+		}
 
         auto newTime = std::chrono::high_resolution_clock::now();
         float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
         currentTime = newTime;
 
-        frameTime = fmin(frameTime, MAX_FRAME_TIME);
-
-        cameraController.moveInPlaneXZ(gameWindow.getGLFWwindow(), frameTime, viewerObject);
-        camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+        frameTime = gameOptions.fixedTimestep > 0.f ? gameOptions.fixedTimestep : fmin(frameTime, MAX_FRAME_TIME);
 
         float aspect = gameRenderer.getAspectRatio();
-        camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
-		
-		if (auto commandBuffer = gameRenderer.beginFrame())
+
+        if (benchmark)
+        {
+            benchmark->updateCamera(camera, aspect, framesRendered);
+        }
+        else
+        {
+            if (simulation)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(inputMutex);
+                    latestInput = cameraController.sampleInput(gameWindow->getGLFWwindow());
+                }
+
+                simulation->interpolate(simulatedTransforms);
+                viewerObject.transform = simulatedTransforms.front();
+            }
+            else if (gameWindow)
+            {
+                cameraController.moveInPlaneXZ(gameWindow->getGLFWwindow(), frameTime, viewerObject);
+            }
+            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+            camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
+        }
+
+		VkCommandBuffer commandBuffer;
+		{
+			B3DBenchmark::StageTimer acquireTimer{ benchmark.get(), B3DBenchmark::Stage::ACQUIRE };
+			commandBuffer = gameRenderer.beginFrame();
+		}
+
+		if (commandBuffer)
 		{
             int frameIndex = gameRenderer.getFrameIndex();
-            FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSets[frameIndex]};
+            gpuProfiler.beginFrame(commandBuffer, frameIndex);
+            frameCapture.beginFrame();
+            descriptorCache.beginFrame(frameIndex);
+
+            //The scale follows the newest GPU time read back, which lags this frame by the frames in flight
+            VkExtent2D renderExtent = gameRenderer.getSwapChainExtent();
+            if (dynamicResolution)
+            {
+                dynamicResolution->update(gpuProfiler.getLastFrameTime());
+                renderExtent = dynamicResolution->getRenderExtent(renderExtent);
+            }
+
+            //Binned before the set is fetched, growing the light buffer replaces this slot's set
+            B3DClusteredLighting::ClusterUniforms clusterUniforms = clusteredLighting.update(frameIndex, camera, renderExtent, descriptorCache);
+
+            //Written the first time this slot is seen, every later frame gets the same set back from the cache
+            auto bufferInfo = ubobuffers[frameIndex]->descriptorInfo();
+            B3DDescriptorWriter globalWriter{ *globalSetLayout };
+            globalWriter.writeBuffer(0, &bufferInfo);
+            clusteredLighting.writeDescriptors(globalWriter, frameIndex);
+            shadowMaps.writeDescriptors(globalWriter);
+            VkDescriptorSet globalDescriptorSet = descriptorCache.getSet(globalWriter);
+
+            FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSet, sceneGraph, gpuProfiler, descriptorCache, renderExtent };
+
+            if (bindlessHeap)
+            {
+                bindlessHeap->beginFrame();
+                textureLibrary->beginFrame();
+            }
 
             //Update
+            if (benchmark)
+            {
+                B3D_PROFILE_SCOPE("Benchmark animate");
+                B3DBenchmark::StageTimer animateTimer{ benchmark.get(), B3DBenchmark::Stage::ANIMATE };
+                benchmark->animate(sceneGraph, framesRendered, frameTime);
+            }
+
+            {
+                B3D_PROFILE_SCOPE("Scene graph update");
+                B3DBenchmark::StageTimer updateTimer{ benchmark.get(), B3DBenchmark::Stage::SCENE_UPDATE };
+                sceneGraph.update(gameJobs);
+            }
+
             GlobalUbo ubo{};
             ubo.projectionView = camera.getProjection() * camera.getView();
+            ubo.view = camera.getView();
+            ubo.clusters = clusterUniforms;
+            ubo.shadows = shadowMaps.update(camera, ubo.lightDirection, sceneGraph, gameObjects);
             ubobuffers[frameIndex]->writeToBuffer(&ubo);
             ubobuffers[frameIndex]->flush();
 
+            if (textureLibrary)
+            {
+                textureStreamer->update(camera, renderExtent, sceneGraph, gameObjects);
+
+                B3DGpuProfiler::Scope uploadZone{ gpuProfiler, commandBuffer, "Texture uploads" };
+                textureLibrary->recordUploads(commandBuffer);
+            }
+
             //Render
-			gameRenderer.beginSwapChainRenderPass(commandBuffer);
-			simpleRenderSystem.renderGameObjects(frameInfo, gameObjects);
-			gameRenderer.endSwapChainRenderPass(commandBuffer);
-			gameRenderer.endFrame();
+			{
+				B3DBenchmark::StageTimer recordTimer{ benchmark.get(), B3DBenchmark::Stage::RECORD };
+
+				const VkExtent2D extent = gameRenderer.getSwapChainExtent();
+				renderGraph.beginFrame(extent);
+
+				B3DRenderGraph::ImportedImage backbufferImage{};
+				backbufferImage.image = gameRenderer.getCurrentSwapChainImage();
+				backbufferImage.view = gameRenderer.getCurrentSwapChainImageView();
+				backbufferImage.format = gameRenderer.getSwapChainImageFormat();
+				backbufferImage.extent = extent;
+				backbufferImage.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				backbufferImage.finalLayout = gameRenderer.getSwapChainFinalLayout();
+				backbufferImage.generation = gameRenderer.getSwapChainGeneration();
+
+				auto backbuffer = renderGraph.importImage("Backbuffer", backbufferImage);
+				auto depth = B3DRenderGraph::INVALID_HANDLE;
+
+				VkClearColorValue clearColor{ { 0.01f, 0.01f, 0.01f, 1.0f } };
+				VkClearDepthStencilValue clearDepth{ 1.0f, 0 };
+
+				simpleRenderSystem.prepareFrame(frameInfo, gameObjects);
+
+				auto staticShadows = renderGraph.importImage("Static shadow cache", shadowMaps.importStaticCache());
+				auto shadowAtlas = renderGraph.importImage("Shadow atlas", shadowMaps.importAtlas());
+
+				//Always declared so the graph stays the same from frame to frame, it draws nothing while the cache is current
+				renderGraph.addPass("Static shadows", [&](B3DRenderGraph::PassBuilder& builder)
+				{
+					builder.writeDepth(staticShadows);
+					builder.setSubpassContents(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				},
+				[&](const B3DRenderGraph::PassContext& pass)
+				{
+					if (simpleRenderSystem.renderShadowCasters(frameInfo, pass, gameObjects, shadowMaps, true))
+					{
+						shadowMaps.markStaticCacheRendered();
+					}
+				});
+
+				renderGraph.addPass("Shadow cache copy", [&](B3DRenderGraph::PassBuilder& builder)
+				{
+					builder.copyFrom(staticShadows);
+					builder.copyTo(shadowAtlas);
+				},
+				[&](const B3DRenderGraph::PassContext& pass)
+				{
+					shadowMaps.recordCacheCopy(pass.commandBuffer, pass.graph.getImage(staticShadows), pass.graph.getImage(shadowAtlas));
+				});
+
+				renderGraph.addPass("Dynamic shadows", [&](B3DRenderGraph::PassBuilder& builder)
+				{
+					builder.writeDepth(shadowAtlas);
+					builder.setSubpassContents(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				},
+				[&](const B3DRenderGraph::PassContext& pass)
+				{
+					simpleRenderSystem.renderShadowCasters(frameInfo, pass, gameObjects, shadowMaps, false);
+				});
+
+				if (simpleRenderSystem.usesDepthPrepass())
+				{
+					renderGraph.addPass("Depth prepass", [&](B3DRenderGraph::PassBuilder& builder)
+					{
+						depth = builder.createImage("Depth", { gameRenderer.getDepthFormat() });
+						builder.writeDepth(depth, &clearDepth);
+						builder.setSubpassContents(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					},
+					[&](const B3DRenderGraph::PassContext& pass)
+					{
+						simpleRenderSystem.renderDepthPrepass(frameInfo, pass, gameObjects);
+					});
+				}
+
+				//Under dynamic resolution the scene goes to a target of the full size and only its corner is upscaled, so a
+				//new scale changes the viewport and nothing else
+				auto sceneColor = backbuffer;
+
+				renderGraph.addPass("Main pass", [&](B3DRenderGraph::PassBuilder& builder)
+				{
+					if (dynamicResolution)
+					{
+						sceneColor = builder.createImage("Scene color", { gameRenderer.getSwapChainImageFormat() });
+					}
+
+					builder.writeColor(sceneColor, &clearColor);
+					builder.sampleImage(shadowAtlas);
+
+					if (depth == B3DRenderGraph::INVALID_HANDLE)
+					{
+						depth = builder.createImage("Depth", { gameRenderer.getDepthFormat() });
+						builder.writeDepth(depth, &clearDepth);
+					}
+					else
+					{
+						builder.readDepth(depth);
+					}
+
+					builder.setSubpassContents(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				},
+				[&](const B3DRenderGraph::PassContext& pass)
+				{
+					simpleRenderSystem.renderGameObjects(frameInfo, pass, gameObjects);
+				});
+
+				if (dynamicResolution)
+				{
+					renderGraph.addPass("Upscale", [&](B3DRenderGraph::PassBuilder& builder)
+					{
+						builder.writeColor(backbuffer, &clearColor);
+						builder.sampleImage(sceneColor);
+					},
+					[&](const B3DRenderGraph::PassContext& pass)
+					{
+						dynamicResolution->recordUpscale(pass.commandBuffer, descriptorCache, pass.graph.getImageView(sceneColor), renderExtent, extent);
+					});
+				}
+
+				renderGraph.execute(commandBuffer, &gpuProfiler);
+			}
+
+			frameCapture.recordCopy(gameRenderer, commandBuffer);
+
+			{
+				B3DBenchmark::StageTimer submitTimer{ benchmark.get(), B3DBenchmark::Stage::SUBMIT };
+				gameRenderer.endFrame();
+			}
+
+			if (benchmark)
+			{
+				benchmark->endFrame(simpleRenderSystem.getDrawCallCount());
+			}
+			framesRendered++;
 		}
 	}
 
 	vkDeviceWaitIdle(gameDevice.device());
+	frameCapture.flush();
+
+	PLOGI << "Game loop finished after " << framesRendered << " frames";
+
+	if (benchmark)
+	{
+		runPassed = benchmark->finish(gpuProfiler.getZoneStats(), gameRenderer.getSwapChainExtent(), gameOptions.headless);
+	}
+}
+
+GameOptions Game::resolveOptions(const GameOptions& options)
+{
+	GameOptions resolved = options;
+
+	if (resolved.width == 0 || resolved.height == 0)
+	{
+		throw std::runtime_error("Render resolution must be at least 1x1!");
+	}
+
+	if (resolved.tickRate <= 0.f)
+	{
+		throw std::runtime_error("Tick rate must be above 0 Hz!");
+	}
+
+	if (resolved.dynamicResolution && resolved.gpuBudget <= 0.f)
+	{
+		throw std::runtime_error("GPU budget must be above 0 ms!");
+	}
+
+	if (resolved.benchmark)
+	{
+		if (resolved.frameCount != 0) resolved.benchmarkSettings.frameCount = resolved.frameCount;
+		if (resolved.fixedTimestep <= 0.f) resolved.fixedTimestep = HEADLESS_TIMESTEP;
+
+		resolved.frameCount = resolved.benchmarkSettings.warmupFrames + resolved.benchmarkSettings.frameCount;
+	}
+
+	if (resolved.headless)
+	{
+		if (resolved.frameCount == 0) resolved.frameCount = HEADLESS_DEFAULT_FRAMES;
+		if (resolved.fixedTimestep <= 0.f) resolved.fixedTimestep = HEADLESS_TIMESTEP;
+	}
+
+	return resolved;
+}
+
+bool Game::shouldKeepRunning(uint32_t framesRendered) const
+{
+	if (gameOptions.frameCount != 0 && framesRendered >= gameOptions.frameCount) return false;
+
+	return !gameWindow || !gameWindow->shouldClose();
 }
 
 void Game::loadGameObjects()
 {
+    if (benchmark)
+    {
+        benchmark->generateScene(gameDevice, sceneGraph, gameObjects);
+        return;
+    }
+
     PLOGI << "Loading 3D models";
 
     std::shared_ptr<B3DModel> smoothSphereModel = B3DModel::createModelFromFile(gameDevice, "smooth_sphere.wobj");
 
     auto smoothSphere = B3DGameObj::createGameObject();
     smoothSphere.model = smoothSphereModel;
-    smoothSphere.transform.translation = {.0f, .0f, 2.5f};
-    smoothSphere.transform.scale = { .5f, .5f, .5f };
+    smoothSphere.sceneNode = sceneGraph.createNode();
+
+    auto& sphereTransform = sceneGraph.editLocalTransform(smoothSphere.sceneNode);
+    sphereTransform.translation = {.0f, .0f, 2.5f};
+    sphereTransform.scale = { .5f, .5f, .5f };
 
     gameObjects.push_back(std::move(smoothSphere));
+
+    //A thin slab under the sphere to catch its shadow, it never moves so its own shadows stay cached
+    auto floor = B3DGameObj::createGameObject();
+    floor.model = B3DModel::createModelFromFile(gameDevice, "cube.wobj");
+    floor.sceneNode = sceneGraph.createNode();
+    floor.isStatic = true;
+
+    auto& floorTransform = sceneGraph.editLocalTransform(floor.sceneNode);
+    floorTransform.translation = { .0f, .52f, 2.5f };
+    floorTransform.scale = { 2.f, .02f, 2.f };
+
+    gameObjects.push_back(std::move(floor));
+}
+
+void Game::createLights()
+{
+    //World matrices are needed for the scene bounds before the first frame has updated them
+    sceneGraph.update(gameJobs);
+
+    glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+    glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+
+    for (const auto& obj : gameObjects)
+    {
+        glm::vec3 position = glm::vec3{ sceneGraph.getWorldMatrix(obj.sceneNode)[3] };
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+
+    if (gameObjects.empty())
+    {
+        boundsMin = glm::vec3{ 0.f };
+        boundsMax = glm::vec3{ 0.f };
+    }
+
+    boundsMin -= glm::vec3{ LIGHT_SCENE_PADDING };
+    boundsMax += glm::vec3{ LIGHT_SCENE_PADDING };
+
+    //Radii shrink as lights are added so each point is reached by about the same number of them
+    glm::vec3 size = boundsMax - boundsMin;
+    float radius = 2.f * std::cbrt(size.x * size.y * size.z / static_cast<float>(gameOptions.lightCount));
+
+    //Seeded so runs are repeatable
+    std::mt19937 random{ LIGHT_SEED };
+    std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+    for (uint32_t i = 0; i < gameOptions.lightCount; i++)
+    {
+        B3DClusteredLighting::Light light{};
+        light.position = boundsMin + glm::vec3{ unit(random), unit(random), unit(random) } * size;
+        light.radius = radius * (0.5f + unit(random));
+        light.color = glm::vec3{ 0.2f } + 0.8f * glm::vec3{ unit(random), unit(random), unit(random) };
+        light.intensity = 2.f;
+
+        //Every fourth light is a spot pointing down, -y is up
+        if (i % 4 == 3)
+        {
+            light.direction = { 0.f, 1.f, 0.f };
+            light.innerConeAngle = glm::radians(25.f);
+            light.outerConeAngle = glm::radians(40.f);
+        }
+
+        clusteredLighting.addLight(light);
+    }
+
+    PLOGI << "Scattered " << gameOptions.lightCount << " lights with a radius of about " << radius;
 }
\ No newline at end of file
@@ -5,12 +5,28 @@
 #include "B3DDevice.h"
 #include "B3DSwapChain.h"
 #include "B3DGameObj.h"
+#include "B3DSceneGraph.h"
 #include "B3DRenderer.h"
+#include "B3DRenderGraph.h"
 #include "SimpleRenderSystem.h"
 #include "B3DCamera.h"
 #include "keyboardMovementController.h"
 #include "B3DBuffer.h"
 #include "B3DDescriptors.h"
+#include "B3DJobSystem.h"
+#include "B3DPipelineRegistry.h"
+#include "B3DGpuProfiler.h"
+#include "B3DProfiler.h"
+#include "B3DBenchmark.h"
+#include "B3DFrameCapture.h"
+#include "B3DBindless.h"
+#include "B3DMaterialLibrary.h"
+#include "B3DTextureLibrary.h"
+#include "B3DTextureStreamer.h"
+#include "B3DClusteredLighting.h"
+#include "B3DShadowMaps.h"
+#include "B3DDynamicResolution.h"
+#include "B3DSimulation.h"
 
 //GLM
 #define GLM_FORCE_RADIANS
@@ -26,19 +42,72 @@
 #include <chrono>
 #include <cmath>
 #include <numeric>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 
 //Plog
 #include <plog/Log.h>
 
+//Launch settings, filled in from the command line
+struct GameOptions
+{
+	bool headless = false;
+	uint32_t width = 800;
+	uint32_t height = 600;
+
+	//0 runs until the window closes, headless runs need a count
+	uint32_t frameCount = 0;
+
+	//Seconds simulated per frame, 0 uses real elapsed time. Headless runs default to 1/60 so they are repeatable
+	float fixedTimestep = 0.f;
+
+	//Simulation ticks a second when running in real time, on a thread of their own with rendering blending between ticks
+	float tickRate = 60.f;
+
+	//Replaces the game scene with a generated one and drives the camera from a script
+	bool benchmark = false;
+	BenchmarkSettings benchmarkSettings{};
+
+	//Non-empty records frames into this directory, captureFrames of 0 records the whole run
+	std::string captureDirectory;
+	uint32_t captureFrames = 0;
+	bool captureRaw = false;
+
+	//Non-empty textures every object with this image, needs descriptor indexing
+	std::string albedoTexture;
+	bool compressTextures = false;
+
+	//Uploads only the coarse mips of --texture and streams finer ones in as the camera needs them
+	bool streamTextures = false;
+
+	//Device memory streamed textures may use in megabytes, 0 keeps the library's default
+	uint32_t textureBudget = 0;
+
+	//Lays down depth with a position-only pass first, so the main pass shades each pixel once
+	bool depthPrepass = false;
+
+	//Point and spot lights scattered around the scene, shaded through the light clusters
+	uint32_t lightCount = 0;
+
+	//Scales the scene's resolution to keep the GPU frame time inside gpuBudget milliseconds
+	bool dynamicResolution = false;
+	float gpuBudget = 1000.f / 60.f;
+};
 
 class Game
 {
 	public:
-		static constexpr int WIDTH = 800;
-		static constexpr int HEIGHT = 600;
 		static constexpr int MAX_FRAME_TIME = 10;
+		static constexpr float HEADLESS_TIMESTEP = 1.f / 60.f;
+		static constexpr uint32_t HEADLESS_DEFAULT_FRAMES = 600;
+		static constexpr int PROFILE_CAPTURE_KEY = GLFW_KEY_F9;
+		static constexpr uint32_t PROFILE_CAPTURE_FRAMES = 300;
+		static constexpr int SCREENSHOT_KEY = GLFW_KEY_F12;
+		static constexpr float LIGHT_SCENE_PADDING = 2.f;
+		static constexpr uint32_t LIGHT_SEED = 1337;
 
-		Game();
+		Game(const GameOptions& options = GameOptions{});
 		~Game();
 
 		Game(const Game &) = delete;
@@ -46,15 +115,44 @@ class Game
 
 		void run();
 
+		//False if a benchmark run regressed against its baseline
+		bool passed() const { return runPassed; }
+
 
 	private:
 
-		B3DWindow gameWindow{ WIDTH, HEIGHT, "Based Engine 3D" };
-		B3DDevice gameDevice{ gameWindow };
-		B3DRenderer gameRenderer{ gameWindow, gameDevice };
+		B3DJobSystem gameJobs{ 0, B3DProfiler::jobSystemHooks() };
+		GameOptions gameOptions;
+
+		//Null when headless, nothing touches GLFW in that case
+		std::unique_ptr<B3DWindow> gameWindow;
+		B3DDevice gameDevice{ gameWindow.get() };
+		B3DRenderer gameRenderer{ gameWindow.get(), gameDevice, VkExtent2D{ gameOptions.width, gameOptions.height } };
+		B3DRenderGraph renderGraph{ gameDevice };
+		B3DPipelineRegistry pipelineRegistry{ gameDevice, gameJobs };
+		B3DGpuProfiler gpuProfiler{ gameDevice };
+		B3DFrameCapture frameCapture{ gameDevice };
+
+		B3DDescriptorCache descriptorCache{ gameDevice };
 
-		std::unique_ptr<B3DDescriptorPool> globalPool{};
+		//Null on devices without descriptor indexing, objects then keep their plain colors
+		std::unique_ptr<B3DBindlessHeap> bindlessHeap;
+		std::unique_ptr<B3DMaterialLibrary> materialLibrary;
+		std::unique_ptr<B3DTextureLibrary> textureLibrary;
+		std::unique_ptr<B3DTextureStreamer> textureStreamer;
+
+		B3DClusteredLighting clusteredLighting{ gameDevice, gameJobs };
+		B3DShadowMaps shadowMaps{ gameDevice, gameJobs };
+
+		B3DSceneGraph sceneGraph{};
 		std::vector<B3DGameObj> gameObjects;
 
+		std::unique_ptr<B3DBenchmark> benchmark;
+		bool runPassed = true;
+
 		void loadGameObjects();
+		void createLights();
+
+		static GameOptions resolveOptions(const GameOptions& options);
+		bool shouldKeepRunning(uint32_t framesRendered) const;
 };
\ No newline at end of file
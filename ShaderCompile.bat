@@ -1,4 +1,6 @@
 C:\VulkanSDK\1.3.250.0\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
 C:\VulkanSDK\1.3.250.0\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
+C:\VulkanSDK\1.3.250.0\Bin\glslc.exe upscale.vert -o upscale.vert.spv
+C:\VulkanSDK\1.3.250.0\Bin\glslc.exe upscale.frag -o upscale.frag.spv
 
 copy .\*.spv .\x64\Debug
\ No newline at end of file
@@ -1,54 +1,391 @@
 #include "SimpleRenderSystem.h"
 
-struct SimplePushConstantData
+//Specialization constant IDs declared in simple_shader.frag
+static constexpr uint32_t DIRECTIONAL_LIGHT_CONSTANT_ID = 0;
+
+//Matches ObjectData in simple_shader.vert under std430, where each mat3 column is padded to a vec4
+struct ObjectData
 {
 	glm::mat4 modelMatrix{ 1.f };
-	glm::mat4 normalMatrix{ 1.f };
+	glm::vec4 normalMatrix[3]{};
+	glm::vec3 color{ 1.f };
+	uint32_t materialId = 0;
+};
+
+static_assert(sizeof(ObjectData) == 128, "ObjectData must match the std430 layout in simple_shader.vert");
+
+//Matches the push constant block in simple_shader.frag when built with BINDLESS
+struct MaterialPushConstants
+{
+	uint32_t materialBuffer;
 };
 
-SimpleRenderSystem::SimpleRenderSystem(B3DDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : rSysDevice{device}
+//Matches the push constant block in simple_shader.vert when built with SHADOW
+struct ShadowPushConstants
 {
+	uint32_t cascade;
+};
+
+SimpleRenderSystem::SimpleRenderSystem(B3DDevice& device, B3DRenderer& renderer, B3DJobSystem& jobSystem, B3DPipelineRegistry& pipelineRegistry, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+	B3DMaterialLibrary* materialLibrary, VkRenderPass depthPrepassRenderPass, VkRenderPass shadowRenderPass) : rSysDevice{device}, rSysRenderer{renderer}, rSysJobSystem{jobSystem}, rSysPipelineRegistry{pipelineRegistry},
+	depthPrepassEnabled{ depthPrepassRenderPass != VK_NULL_HANDLE }, shadowsEnabled{ shadowRenderPass != VK_NULL_HANDLE }, rSysMaterials{ device.supportsBindless() ? materialLibrary : nullptr }
+{
+	createObjectDescriptors();
 	createPipelineLayout(globalSetLayout);
 	createPipeline(renderPass);
+
+	if (depthPrepassEnabled)
+	{
+		createDepthPipeline(depthPrepassRenderPass);
+	}
+
+	if (shadowsEnabled)
+	{
+		createShadowPipeline(shadowRenderPass);
+	}
 }
 
 SimpleRenderSystem::~SimpleRenderSystem()
 {
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo &frameInfo, std::vector<B3DGameObj>& gameObjects)
+void SimpleRenderSystem::prepareFrame(FrameInfo& frameInfo, std::vector<B3DGameObj>& gameObjects)
+{
+	drawCallCount.store(0, std::memory_order_relaxed);
+
+	if (!pipelinesReady()) return;
+
+	B3D_PROFILE_COUNTER("Game objects", gameObjects.size());
+
+	writeObjectData(frameInfo, gameObjects);
+
+	if (rSysMaterials)
+	{
+		materialBufferIndex = rSysMaterials->prepareFrame(frameInfo.frameIndex);
+	}
+}
+
+void SimpleRenderSystem::renderDepthPrepass(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects)
+{
+	assert(depthPrepassEnabled && "The depth pre-pass was not enabled when the render system was created!");
+
+	if (!pipelinesReady()) return;
+
+	B3D_PROFILE_SCOPE("Render depth prepass");
+	recordPass(frameInfo, pass, *rSysDepthPipeline.get(), gameObjects, true);
+}
+
+void SimpleRenderSystem::renderGameObjects(FrameInfo &frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects)
+{
+	//Nothing is drawn until the background compile lands rather than stalling the frame on it
+	if (!pipelinesReady()) return;
+
+	B3D_PROFILE_SCOPE("Render game objects");
+	recordPass(frameInfo, pass, *rSysPipeline.get(), gameObjects, false);
+}
+
+bool SimpleRenderSystem::renderShadowCasters(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects, const B3DShadowMaps& shadowMaps, bool staticCasters)
+{
+	assert(shadowsEnabled && "Shadows were not enabled when the render system was created!");
+
+	//The object buffer is only written once the main pipelines are ready
+	if (!pipelinesReady() || !rSysShadowPipeline.isReady()) return false;
+
+	B3D_PROFILE_SCOPE("Render shadow casters");
+
+	std::vector<uint32_t> cascades{};
+	for (uint32_t cascade = 0; cascade < B3DShadowMaps::CASCADE_COUNT; cascade++)
+	{
+		if (!staticCasters || shadowMaps.isCascadeStale(cascade))
+		{
+			cascades.push_back(cascade);
+		}
+	}
+
+	if (cascades.empty()) return true;
+
+	const uint32_t chunkCount = std::min(rSysRenderer.getRecordingThreadCount(), static_cast<uint32_t>(cascades.size()));
+	std::vector<VkCommandBuffer> secondaryBuffers(chunkCount);
+
+	//Cascades are independent tiles of the atlas, so each recording job takes whole cascades
+	rSysJobSystem.parallelFor(0, chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd)
+	{
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+		{
+			secondaryBuffers[chunk] = rSysRenderer.beginSecondaryCommandBuffer(static_cast<uint32_t>(chunk), pass.renderPass, pass.framebuffer, pass.extent);
+
+			{
+				B3DGpuProfiler::Scope zone{ frameInfo.gpuProfiler, secondaryBuffers[chunk], staticCasters ? "Static shadow casters" : "Dynamic shadow casters" };
+
+				for (size_t i = chunk; i < cascades.size(); i += chunkCount)
+				{
+					recordShadowCascade(frameInfo, secondaryBuffers[chunk], gameObjects, shadowMaps, cascades[i], staticCasters);
+				}
+			}
+
+			rSysRenderer.endSecondaryCommandBuffer(secondaryBuffers[chunk]);
+		}
+	}, "Record shadow casters");
+
+	rSysRenderer.executeSecondaryCommandBuffers(frameInfo.commandBuffer, secondaryBuffers);
+	return true;
+}
+
+bool SimpleRenderSystem::pipelinesReady() const
+{
+	//With the pre-pass on, the main pipeline only passes fragments the pre-pass wrote, so one is no use without the other
+	return rSysPipeline.isReady() && (!depthPrepassEnabled || rSysDepthPipeline.isReady());
+}
+
+void SimpleRenderSystem::recordPass(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, B3DPipeline& pipeline, std::vector<B3DGameObj>& gameObjects, bool depthOnly)
+{
+	const size_t objectCount = gameObjects.size();
+	const size_t chunksNeeded = (objectCount + MIN_OBJECTS_PER_RECORDING_THREAD - 1) / MIN_OBJECTS_PER_RECORDING_THREAD;
+	const uint32_t chunkCount = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(rSysRenderer.getRecordingThreadCount(), chunksNeeded)));
+	const size_t objectsPerChunk = (objectCount + chunkCount - 1) / chunkCount;
+
+	std::vector<VkCommandBuffer> secondaryBuffers(chunkCount);
+
+	//Each chunk owns one secondary buffer and its pool, so whichever worker picks it up records without locking
+	rSysJobSystem.parallelFor(0, chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd)
+	{
+		for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++)
+		{
+			size_t begin = std::min(objectCount, chunk * objectsPerChunk);
+			size_t end = std::min(objectCount, begin + objectsPerChunk);
+
+			secondaryBuffers[chunk] = rSysRenderer.beginSecondaryCommandBuffer(static_cast<uint32_t>(chunk), pass.renderPass, pass.framebuffer, frameInfo.renderExtent);
+
+			{
+				B3DGpuProfiler::Scope zone{ frameInfo.gpuProfiler, secondaryBuffers[chunk], depthOnly ? "Depth prepass objects" : "Game objects" };
+				recordGameObjects(frameInfo, secondaryBuffers[chunk], pipeline, gameObjects, begin, end, depthOnly);
+			}
+
+			rSysRenderer.endSecondaryCommandBuffer(secondaryBuffers[chunk]);
+		}
+	}, "Record game objects");
+
+	rSysRenderer.executeSecondaryCommandBuffers(frameInfo.commandBuffer, secondaryBuffers);
+}
+
+void SimpleRenderSystem::recordGameObjects(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, B3DPipeline& pipeline, std::vector<B3DGameObj>& gameObjects, size_t begin, size_t end, bool depthOnly)
+{
+	pipeline.bind(commandBuffer);
+
+	VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, objectDescriptorSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rSysPipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+
+	//Materials are looked up by index in the shader, so the heap is bound once and never changes between draws
+	if (rSysMaterials && !depthOnly)
+	{
+		VkDescriptorSet bindlessSet = rSysMaterials->getHeap().getDescriptorSet();
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rSysPipelineLayout, 2, 1, &bindlessSet, 0, nullptr);
+
+		MaterialPushConstants push{ materialBufferIndex };
+		vkCmdPushConstants(commandBuffer, rSysPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialPushConstants), &push);
+	}
+
+	uint32_t drawCalls = 0;
+	B3DModel* boundModel = nullptr;
+
+	//The instance index is the object's slot in the object buffer, so a run of objects sharing a model is one instanced draw
+	for (size_t i = begin; i < end;)
+	{
+		B3DModel* model = gameObjects[i].model.get();
+
+		size_t runEnd = i + 1;
+		while (runEnd < end && gameObjects[runEnd].model.get() == model)
+		{
+			runEnd++;
+		}
+
+		if (model != boundModel)
+		{
+			if (depthOnly)
+			{
+				model->bindPositions(commandBuffer);
+			}
+			else
+			{
+				model->bind(commandBuffer);
+			}
+
+			boundModel = model;
+		}
+
+		model->draw(commandBuffer, static_cast<uint32_t>(runEnd - i), static_cast<uint32_t>(i));
+		drawCalls++;
+
+		i = runEnd;
+	}
+
+	drawCallCount.fetch_add(drawCalls, std::memory_order_relaxed);
+}
+
+void SimpleRenderSystem::recordShadowCascade(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, std::vector<B3DGameObj>& gameObjects, const B3DShadowMaps& shadowMaps, uint32_t cascade, bool staticCasters)
+{
+	const VkRect2D rect = shadowMaps.getCascadeRect(cascade);
+
+	VkViewport viewport{ static_cast<float>(rect.offset.x), static_cast<float>(rect.offset.y), static_cast<float>(rect.extent.width), static_cast<float>(rect.extent.height), 0.f, 1.f };
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &rect);
+
+	//A stale cascade is redrawn from scratch, the rest of the cache keeps what it had
+	if (staticCasters)
+	{
+		VkClearAttachment clear{};
+		clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		clear.clearValue.depthStencil = { 1.f, 0 };
+
+		VkClearRect clearRect{ rect, 0, 1 };
+		vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &clearRect);
+	}
+
+	rSysShadowPipeline.get()->bind(commandBuffer);
+
+	VkDescriptorSet descriptorSets[] = { frameInfo.globalDescriptorSet, objectDescriptorSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rSysPipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+
+	ShadowPushConstants push{ cascade };
+	vkCmdPushConstants(commandBuffer, rSysPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants), &push);
+
+	const std::vector<uint32_t>& casters = shadowMaps.getCasters(cascade, staticCasters);
+
+	uint32_t drawCalls = 0;
+	B3DModel* boundModel = nullptr;
+
+	//Culling leaves gaps, so only casters with consecutive object slots and the same model share a draw
+	for (size_t i = 0; i < casters.size();)
+	{
+		B3DModel* model = gameObjects[casters[i]].model.get();
+
+		size_t runEnd = i + 1;
+		while (runEnd < casters.size() && casters[runEnd] == casters[runEnd - 1] + 1 && gameObjects[casters[runEnd]].model.get() == model)
+		{
+			runEnd++;
+		}
+
+		if (model != boundModel)
+		{
+			model->bindPositions(commandBuffer);
+			boundModel = model;
+		}
+
+		model->draw(commandBuffer, static_cast<uint32_t>(runEnd - i), casters[i]);
+		drawCalls++;
+
+		i = runEnd;
+	}
+
+	drawCallCount.fetch_add(drawCalls, std::memory_order_relaxed);
+}
+
+void SimpleRenderSystem::writeObjectData(FrameInfo& frameInfo, std::vector<B3DGameObj>& gameObjects)
+{
+	B3D_PROFILE_FUNCTION();
+
+	ensureObjectCapacity(frameInfo, gameObjects.size());
+
+	auto bufferInfo = objectBuffers[frameInfo.frameIndex]->descriptorInfo();
+	objectDescriptorSet = frameInfo.descriptorCache.getSet(B3DDescriptorWriter(*objectSetLayout).writeBuffer(0, &bufferInfo));
+
+	//The renderer has waited on this slot's last submit, so the GPU is done reading the buffer
+	ObjectData* objectData = static_cast<ObjectData*>(objectBuffers[frameInfo.frameIndex]->getMappedMemory());
+
+	rSysJobSystem.parallelFor(0, gameObjects.size(), MIN_OBJECTS_PER_UPLOAD_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const auto& obj = gameObjects[i];
+
+			ObjectData data{};
+			glm::mat3 normalMatrix;
+
+			if (obj.sceneNode != B3DSceneGraph::INVALID_NODE)
+			{
+				data.modelMatrix = frameInfo.sceneGraph.getWorldMatrix(obj.sceneNode);
+				normalMatrix = frameInfo.sceneGraph.getNormalMatrix(obj.sceneNode);
+			}
+			else
+			{
+				data.modelMatrix = obj.transform.mat4();
+				normalMatrix = obj.transform.normalMatrix();
+			}
+
+			data.normalMatrix[0] = glm::vec4{ normalMatrix[0], 0.f };
+			data.normalMatrix[1] = glm::vec4{ normalMatrix[1], 0.f };
+			data.normalMatrix[2] = glm::vec4{ normalMatrix[2], 0.f };
+			data.color = obj.color;
+			data.materialId = obj.materialId;
+
+			objectData[i] = data;
+		}
+	}, "Write object data");
+}
+
+void SimpleRenderSystem::ensureObjectCapacity(FrameInfo& frameInfo, size_t objectCount)
 {
-	rSysPipeline->bind(frameInfo.commandBuffer);
+	auto& buffer = objectBuffers[frameInfo.frameIndex];
 
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rSysPipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+	if (buffer && buffer->getInstanceCount() >= objectCount) return;
 
-	for (auto& obj : gameObjects)
+	uint32_t capacity = buffer ? buffer->getInstanceCount() : INITIAL_OBJECT_CAPACITY;
+	while (capacity < objectCount)
 	{
-		SimplePushConstantData push{};
-		push.modelMatrix = obj.transform.mat4();
-		push.normalMatrix = obj.transform.normalMatrix();
+		capacity *= 2;
+	}
+
+	//Nothing in flight reads this frame's buffer, but its cached set has to go before the handle can be reused
+	frameInfo.descriptorCache.releaseResource(buffer->getBuffer());
 
-		vkCmdPushConstants(frameInfo.commandBuffer, rSysPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-		obj.model->bind(frameInfo.commandBuffer);
-		obj.model->draw(frameInfo.commandBuffer);
+	buffer = std::make_unique<B3DBuffer>(rSysDevice, sizeof(ObjectData), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	buffer->map();
+}
+
+void SimpleRenderSystem::createObjectDescriptors()
+{
+	objectSetLayout = B3DDescriptorSetLayout::Builder(rSysDevice).addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT).build();
+
+	//Sets come from the frame's descriptor cache, which writes each one once per buffer
+	for (int i = 0; i < B3DSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		objectBuffers[i] = std::make_unique<B3DBuffer>(rSysDevice, sizeof(ObjectData), INITIAL_OBJECT_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		objectBuffers[i]->map();
 	}
 }
 
 void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(SimplePushConstantData);
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, objectSetLayout->getDescriptorSetLayout() };
+	std::vector<VkPushConstantRange> pushConstantRanges{};
 
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+	if (rSysMaterials)
+	{
+		descriptorSetLayouts.push_back(rSysMaterials->getHeap().getDescriptorSetLayout());
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(MaterialPushConstants);
+		pushConstantRanges.push_back(pushConstantRange);
+	}
+
+	//Ranges may overlap as long as their stages don't, the shadow pipeline has no fragment stage to see the material range
+	if (shadowsEnabled)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ShadowPushConstants);
+		pushConstantRanges.push_back(pushConstantRange);
+	}
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.empty() ? nullptr : pushConstantRanges.data();
 
 	if (vkCreatePipelineLayout(rSysDevice.device(), &pipelineLayoutInfo, nullptr, &rSysPipelineLayout) != VK_SUCCESS)
 	{
@@ -67,5 +404,64 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
 	pipelineConfig.renderPass = renderPass;
 	pipelineConfig.pipelineLayout = rSysPipelineLayout;
 
-	rSysPipeline = std::make_unique<B3DPipeline>(rSysDevice, "simple_shader.vert.spv", "simple_shader.frag.spv", pipelineConfig);
+	B3DPipeline::setSpecializationConstant(pipelineConfig, DIRECTIONAL_LIGHT_CONSTANT_ID, VK_TRUE);
+
+	B3DShaderLibrary::ShaderVariant vertexVariant{ "simple_shader.vert" };
+	B3DShaderLibrary::ShaderVariant fragmentVariant{ "simple_shader.frag" };
+
+	if (rSysMaterials)
+	{
+		vertexVariant.define("BINDLESS");
+		fragmentVariant.define("BINDLESS");
+	}
+
+	//Depth is already resolved by the pre-pass, so only the visible fragment of each pixel gets shaded
+	if (depthPrepassEnabled)
+	{
+		pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+	}
+
+	rSysPipeline = rSysPipelineRegistry.requestPipeline(vertexVariant, fragmentVariant, pipelineConfig);
+}
+
+void SimpleRenderSystem::createDepthPipeline(VkRenderPass renderPass)
+{
+	assert(rSysPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+	PipelineConfigInfo pipelineConfig{};
+
+	B3DPipeline::depthOnlyPipelineConfigInfo(pipelineConfig);
+
+	pipelineConfig.renderPass = renderPass;
+	pipelineConfig.pipelineLayout = rSysPipelineLayout;
+
+	//No fragment stage, the pre-pass only lays down depth
+	B3DShaderLibrary::ShaderVariant vertexVariant{ "simple_shader.vert" };
+	vertexVariant.define("DEPTH_ONLY");
+
+	rSysDepthPipeline = rSysPipelineRegistry.requestPipeline(vertexVariant, B3DShaderLibrary::ShaderVariant{}, pipelineConfig);
+}
+
+void SimpleRenderSystem::createShadowPipeline(VkRenderPass renderPass)
+{
+	assert(rSysPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+	PipelineConfigInfo pipelineConfig{};
+
+	B3DPipeline::depthOnlyPipelineConfigInfo(pipelineConfig);
+
+	pipelineConfig.renderPass = renderPass;
+	pipelineConfig.pipelineLayout = rSysPipelineLayout;
+
+	pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+	pipelineConfig.rasterizationInfo.depthBiasConstantFactor = SHADOW_DEPTH_BIAS_CONSTANT;
+	pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = SHADOW_DEPTH_BIAS_SLOPE;
+
+	//Positions go through the cascade's light matrix instead of the camera's
+	B3DShaderLibrary::ShaderVariant vertexVariant{ "simple_shader.vert" };
+	vertexVariant.define("DEPTH_ONLY");
+	vertexVariant.define("SHADOW");
+
+	rSysShadowPipeline = rSysPipelineRegistry.requestPipeline(vertexVariant, B3DShaderLibrary::ShaderVariant{}, pipelineConfig);
 }
@@ -4,6 +4,9 @@
 #include <memory>
 #include <vector>
 #include <cassert>
+#include <algorithm>
+#include <array>
+#include <atomic>
 
 //GLM
 #define GLM_FORCE_RADIANS
@@ -15,27 +18,92 @@
 #include "B3DDevice.h"
 #include "B3DGameObj.h"
 #include "B3DPipeline.h"
+#include "B3DPipelineRegistry.h"
+#include "B3DRenderer.h"
+#include "B3DRenderGraph.h"
 #include "B3DCamera.h"
 #include "B3DFrameInfo.h"
+#include "B3DJobSystem.h"
+#include "B3DProfiler.h"
+#include "B3DBuffer.h"
+#include "B3DDescriptors.h"
+#include "B3DSwapChain.h"
+#include "B3DMaterialLibrary.h"
+#include "B3DShadowMaps.h"
 
 class SimpleRenderSystem
 {
 	public:
-		SimpleRenderSystem(B3DDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		static constexpr uint32_t MIN_OBJECTS_PER_RECORDING_THREAD = 256;
+		static constexpr uint32_t MIN_OBJECTS_PER_UPLOAD_JOB = 4096;
+		static constexpr uint32_t INITIAL_OBJECT_CAPACITY = 1024;
+
+		//Slope scaled depth bias on shadow casters, keeps lit surfaces from shadowing themselves
+		static constexpr float SHADOW_DEPTH_BIAS_CONSTANT = 1.25f;
+		static constexpr float SHADOW_DEPTH_BIAS_SLOPE = 1.75f;
+
+		//Without a material library, or on devices without descriptor indexing, objects are shaded by their color alone
+		//Render passes only have to be compatible with the passes the objects are drawn in, see B3DRenderGraph::getCompatibleRenderPass.
+		//A depth pre-pass render pass turns the pre-pass on, the main pipeline then only shades fragments matching the pre-pass depth.
+		//A shadow render pass turns on drawing shadow casters into B3DShadowMaps
+		SimpleRenderSystem(B3DDevice &device, B3DRenderer &renderer, B3DJobSystem &jobSystem, B3DPipelineRegistry &pipelineRegistry, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+			B3DMaterialLibrary* materialLibrary = nullptr, VkRenderPass depthPrepassRenderPass = VK_NULL_HANDLE, VkRenderPass shadowRenderPass = VK_NULL_HANDLE);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-		void renderGameObjects( FrameInfo &frameInfo, std::vector<B3DGameObj>& gameObjects);
+		//Writes the frame's object and material data, call once before recording either pass
+		void prepareFrame(FrameInfo& frameInfo, std::vector<B3DGameObj>& gameObjects);
+
+		//Called from render graph passes recorded with secondary command buffer contents
+		void renderDepthPrepass(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects);
+		void renderGameObjects( FrameInfo &frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects);
+
+		//Draws each cascade's static or dynamic casters into its tile of the pass's atlas. Static casters are only drawn for stale
+		//cascades, whose tiles are cleared first. False if nothing could be drawn yet
+		bool renderShadowCasters(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, std::vector<B3DGameObj>& gameObjects, const B3DShadowMaps& shadowMaps, bool staticCasters);
+
+		bool usesDepthPrepass() const { return depthPrepassEnabled; }
+
+		//Draws recorded since the last prepareFrame call, consecutive objects sharing a model are drawn together
+		uint32_t getDrawCallCount() const { return drawCallCount.load(std::memory_order_relaxed); }
 
 	private:
 
 		B3DDevice& rSysDevice;
+		B3DRenderer& rSysRenderer;
+		B3DJobSystem& rSysJobSystem;
+
+		B3DPipelineRegistry& rSysPipelineRegistry;
 
-		std::unique_ptr<B3DPipeline> rSysPipeline;
+		B3DPipelineRegistry::PipelineHandle rSysPipeline;
+		B3DPipelineRegistry::PipelineHandle rSysDepthPipeline;
+		B3DPipelineRegistry::PipelineHandle rSysShadowPipeline;
+		bool depthPrepassEnabled = false;
+		bool shadowsEnabled = false;
 		VkPipelineLayout rSysPipelineLayout;
 
+		//One object buffer per frame in flight, each grows to fit the scene and is rewritten every frame
+		std::unique_ptr<B3DDescriptorSetLayout> objectSetLayout;
+		std::array<std::unique_ptr<B3DBuffer>, B3DSwapChain::MAX_FRAMES_IN_FLIGHT> objectBuffers;
+		VkDescriptorSet objectDescriptorSet = VK_NULL_HANDLE;
+
+		//Set 2 is the bindless heap, the push constant says which of its buffers holds this frame's material table
+		B3DMaterialLibrary* rSysMaterials;
+		uint32_t materialBufferIndex = B3DBindlessHeap::INVALID_INDEX;
+
+		std::atomic<uint32_t> drawCallCount{ 0 };
+
+		void createObjectDescriptors();
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+		void ensureObjectCapacity(FrameInfo& frameInfo, size_t objectCount);
+		void writeObjectData(FrameInfo& frameInfo, std::vector<B3DGameObj>& gameObjects);
 		void createPipeline(VkRenderPass renderPass);
+		void createDepthPipeline(VkRenderPass renderPass);
+		void createShadowPipeline(VkRenderPass renderPass);
+		bool pipelinesReady() const;
+		void recordPass(FrameInfo& frameInfo, const B3DRenderGraph::PassContext& pass, B3DPipeline& pipeline, std::vector<B3DGameObj>& gameObjects, bool depthOnly);
+		void recordGameObjects(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, B3DPipeline& pipeline, std::vector<B3DGameObj>& gameObjects, size_t begin, size_t end, bool depthOnly);
+		void recordShadowCascade(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, std::vector<B3DGameObj>& gameObjects, const B3DShadowMaps& shadowMaps, uint32_t cascade, bool staticCasters);
 };
\ No newline at end of file
@@ -22,12 +22,23 @@ class keyboardMovementController
             int lookDown = GLFW_KEY_DOWN;
 		};
 
+        //Keys held down when sampled, so the movement can be applied on another thread. Move is along the camera's own right, up and forward
+        struct MovementInput
+        {
+            glm::vec3 rotate{ 0.f };
+            glm::vec3 move{ 0.f };
+        };
+
         KeyMappings keys{};
         float moveSpeed{ 3.f };
         float lookSpeed{ 1.5f };
 
         void moveInPlaneXZ(GLFWwindow* window, float dt, B3DGameObj &gameObject);
 
+        //GLFW only answers key queries on the main thread
+        MovementInput sampleInput(GLFWwindow* window) const;
+        void applyInput(const MovementInput& input, float dt, TransformComponent& transform) const;
+
 	private:
 
 };
@@ -2,26 +2,148 @@
 #include "Game.h"
 
 //STD
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 //Plog
 #include <plog/Log.h>
 #include <plog/Initializers/RollingFileInitializer.h>
 
-int main()
+namespace
 {
+	void printUsage()
+	{
+		std::cerr << "Usage: Based3D [--headless] [--frames N] [--width W] [--height H] [--timestep SECONDS] [--tick-rate HZ]" << std::endl;
+		std::cerr << "       [--benchmark] [--objects N] [--mix CUBE,SPHERE,DESK] [--moving RATIO] [--warmup N] [--seed N]" << std::endl;
+		std::cerr << "       [--output PATH] [--baseline PATH] [--threshold RATIO]" << std::endl;
+		std::cerr << "       [--capture-dir DIRECTORY] [--capture-frames N] [--capture-raw]" << std::endl;
+		std::cerr << "       [--texture PATH] [--compress-textures] [--stream-textures] [--texture-budget MB]" << std::endl;
+		std::cerr << "       [--depth-prepass] [--lights N] [--dynamic-resolution] [--gpu-budget MS]" << std::endl;
+	}
+
+	//Returns false if the arguments don't make sense
+	bool parseArguments(int argc, char* argv[], GameOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const char* arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+			try
+			{
+				if (std::strcmp(arg, "--headless") == 0)
+				{
+					options.headless = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--benchmark") == 0)
+				{
+					options.benchmark = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--compress-textures") == 0)
+				{
+					options.compressTextures = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--stream-textures") == 0)
+				{
+					options.streamTextures = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--capture-raw") == 0)
+				{
+					options.captureRaw = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--depth-prepass") == 0)
+				{
+					options.depthPrepass = true;
+					continue;
+				}
+
+				if (std::strcmp(arg, "--dynamic-resolution") == 0)
+				{
+					options.dynamicResolution = true;
+					continue;
+				}
+
+				if (value == nullptr) return false;
+
+				if (std::strcmp(arg, "--frames") == 0) options.frameCount = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--width") == 0) options.width = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--height") == 0) options.height = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--timestep") == 0) options.fixedTimestep = std::stof(value);
+				else if (std::strcmp(arg, "--tick-rate") == 0) options.tickRate = std::stof(value);
+				else if (std::strcmp(arg, "--objects") == 0) options.benchmarkSettings.objectCount = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--moving") == 0) options.benchmarkSettings.movingRatio = std::stof(value);
+				else if (std::strcmp(arg, "--warmup") == 0) options.benchmarkSettings.warmupFrames = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--seed") == 0) options.benchmarkSettings.seed = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--output") == 0) options.benchmarkSettings.outputPath = value;
+				else if (std::strcmp(arg, "--baseline") == 0) options.benchmarkSettings.baselinePath = value;
+				else if (std::strcmp(arg, "--threshold") == 0) options.benchmarkSettings.regressionThreshold = std::stof(value);
+				else if (std::strcmp(arg, "--capture-dir") == 0) options.captureDirectory = value;
+				else if (std::strcmp(arg, "--capture-frames") == 0) options.captureFrames = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--texture") == 0) options.albedoTexture = value;
+				else if (std::strcmp(arg, "--texture-budget") == 0) options.textureBudget = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--lights") == 0) options.lightCount = static_cast<uint32_t>(std::stoul(value));
+				else if (std::strcmp(arg, "--gpu-budget") == 0) options.gpuBudget = std::stof(value);
+				else if (std::strcmp(arg, "--mix") == 0)
+				{
+					float weights[3]{};
+					if (std::sscanf(value, "%f,%f,%f", &weights[0], &weights[1], &weights[2]) != 3) return false;
+
+					options.benchmarkSettings.cubeWeight = weights[0];
+					options.benchmarkSettings.sphereWeight = weights[1];
+					options.benchmarkSettings.deskWeight = weights[2];
+				}
+				else return false;
+
+				i++;
+			}
+			catch (const std::exception&)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	GameOptions options{};
+
+	if (!parseArguments(argc, argv, options))
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
 
 	plog::init(plog::debug, "./logs/runtime_log.log");
 
 	PLOGI << "Starting engine";
 
-	Game game{};
-
 	try 
 	{
+		Game game{ options };
 		game.run();
+
+		if (!game.passed())
+		{
+			std::cerr << "Benchmark regressed against its baseline, see " << options.benchmarkSettings.outputPath << std::endl;
+			return EXIT_FAILURE;
+		}
 	}
 	catch (const std::exception& e)
 	{
@@ -1,16 +1,182 @@
 #version 450
 
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 3) in vec3 fragPositionWorld;
+layout(location = 4) in vec3 fragNormalWorld;
+layout(location = 5) in float fragViewDepth;
 
-layout (location = 0) out vec4 outColor;
+#ifdef BINDLESS
+layout(location = 1) in vec2 fragUv;
+layout(location = 2) flat in uint fragMaterialId;
+
+struct MaterialData {
+	vec4 baseColor;
+	uint albedoTexture;
+};
+
+const uint INVALID_INDEX = 0xFFFFFFFFu;
+
+//The bindless heap, every texture and material table is reached by index through these two arrays
+layout(set = 2, binding = 0) uniform sampler2D bindlessTextures[];
+
+layout(std430, set = 2, binding = 1) readonly buffer MaterialBuffer {
+	MaterialData materials[];
+} bindlessBuffers[];
 
 layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
+	uint materialBuffer;
 } push;
+#endif
+
+//Matches B3DShadowMaps::CASCADE_COUNT
+const uint SHADOW_CASCADE_COUNT = 4;
+
+//Shared with simple_shader.vert, the cluster fields match B3DClusteredLighting::ClusterUniforms and the shadow fields
+//B3DShadowMaps::ShadowUniforms
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionViewMatrix;
+	mat4 viewMatrix;
+	vec3 directionToLight;
+	uvec4 clusterGridSize;
+	vec4 clusterTileSizeAndSlicing;
+	mat4 shadowLightViewProjections[SHADOW_CASCADE_COUNT];
+	vec4 shadowCascadeSplits;
+	vec4 shadowAtlasParams;
+} ubo;
+
+//Matches B3DClusteredLighting::LightData
+struct LightData {
+	vec4 positionRadius;
+	vec4 colorIntensity;
+	vec4 spotDirection;
+	vec4 spotParams;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+	LightData lights[];
+} lightBuffer;
+
+//A light count per cluster, and for each cluster a run of clusterGridSize.w light indices
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer {
+	uint lightCounts[];
+} clusterBuffer;
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer {
+	uint lightIndices[];
+} lightIndexBuffer;
+
+//Every cascade in one depth atlas, compared against by the sampler
+layout(set = 0, binding = 4) uniform sampler2DShadow shadowAtlas;
+
+layout(constant_id = 0) const bool DIRECTIONAL_LIGHT = true;
+
+const float AMBIENT = 0.02;
+
+layout (location = 0) out vec4 outColor;
+
+//How much of the directional light reaches the fragment, from 0 in full shadow to 1
+float directionalShadow(vec3 positionWorld)
+{
+	if (ubo.shadowAtlasParams.w == 0.0 || fragViewDepth > ubo.shadowCascadeSplits[SHADOW_CASCADE_COUNT - 1]) return 1.0;
+
+	uint cascade = 0;
+	while (cascade < SHADOW_CASCADE_COUNT - 1 && fragViewDepth > ubo.shadowCascadeSplits[cascade])
+	{
+		cascade++;
+	}
+
+	vec4 lightPosition = ubo.shadowLightViewProjections[cascade] * vec4(positionWorld, 1.0);
+
+	uint columns = uint(ubo.shadowAtlasParams.x);
+	vec2 tile = vec2(cascade % columns, cascade / columns);
+	vec2 uv = (tile + lightPosition.xy * 0.5 + 0.5) * ubo.shadowAtlasParams.y;
 
+	//Taps stay half a texel inside the cascade's tile, so filtering at its edge never reads the neighbouring cascade
+	vec2 tileMin = tile * ubo.shadowAtlasParams.y + 0.5 * ubo.shadowAtlasParams.z;
+	vec2 tileMax = (tile + 1.0) * ubo.shadowAtlasParams.y - 0.5 * ubo.shadowAtlasParams.z;
+
+	//3x3 taps on top of the sampler's own bilinear comparison
+	float lit = 0.0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			vec2 tapUv = clamp(uv + vec2(x, y) * ubo.shadowAtlasParams.z, tileMin, tileMax);
+			lit += texture(shadowAtlas, vec3(tapUv, lightPosition.z));
+		}
+	}
+
+	return lit / 9.0;
+}
+
+vec3 clusteredLighting(vec3 positionWorld, vec3 normalWorld)
+{
+	uvec3 cluster;
+	cluster.xy = min(uvec2(gl_FragCoord.xy / ubo.clusterTileSizeAndSlicing.xy), ubo.clusterGridSize.xy - 1);
+	cluster.z = uint(clamp(log(fragViewDepth) * ubo.clusterTileSizeAndSlicing.z + ubo.clusterTileSizeAndSlicing.w, 0.0, float(ubo.clusterGridSize.z - 1)));
+
+	uint clusterIndex = (cluster.z * ubo.clusterGridSize.y + cluster.y) * ubo.clusterGridSize.x + cluster.x;
+	uint lightCount = min(clusterBuffer.lightCounts[clusterIndex], ubo.clusterGridSize.w);
+	uint firstLight = clusterIndex * ubo.clusterGridSize.w;
+
+	vec3 lighting = vec3(0.0);
+
+	for (uint i = 0; i < lightCount; i++)
+	{
+		LightData light = lightBuffer.lights[lightIndexBuffer.lightIndices[firstLight + i]];
+
+		vec3 toLight = light.positionRadius.xyz - positionWorld;
+		float distanceSquared = dot(toLight, toLight);
+		float radiusSquared = light.positionRadius.w * light.positionRadius.w;
+
+		if (distanceSquared >= radiusSquared) continue;
+
+		vec3 directionToLight = toLight * inversesqrt(max(distanceSquared, 0.0001));
+
+		//Inverse square falloff windowed to reach 0 at the radius
+		float ratio = distanceSquared / radiusSquared;
+		float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / (distanceSquared + 1.0);
+
+		if (light.spotDirection.xyz != vec3(0.0))
+		{
+			attenuation *= smoothstep(light.spotDirection.w, light.spotParams.x, dot(light.spotDirection.xyz, -directionToLight));
+		}
+
+		lighting += light.colorIntensity.rgb * light.colorIntensity.w * attenuation * max(dot(normalWorld, directionToLight), 0.0);
+	}
+
+	return lighting;
+}
 
 void main()
 {
-	outColor = vec4(fragColor, 1.0);
+	vec3 normalWorld = normalize(fragNormalWorld);
+
+	vec3 lighting = vec3(1.0);
+
+	if (DIRECTIONAL_LIGHT)
+	{
+		lighting = vec3(AMBIENT + max(dot(normalWorld, ubo.directionToLight), 0) * directionalShadow(fragPositionWorld));
+	}
+
+	lighting += clusteredLighting(fragPositionWorld, normalWorld);
+
+	vec3 color = lighting * fragColor;
+
+#ifdef BINDLESS
+	MaterialData material = bindlessBuffers[push.materialBuffer].materials[fragMaterialId];
+	color *= material.baseColor.rgb;
+
+	if (material.albedoTexture != INVALID_INDEX)
+	{
+		color *= texture(bindlessTextures[nonuniformEXT(material.albedoTexture)], fragUv).rgb;
+	}
+#endif
+
+	outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,31 +1,81 @@
 #version 450
 
 layout(location = 0) in vec3 position;
+
+//The depth pre-pass only binds the position stream
+#ifndef DEPTH_ONLY
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 3) out vec3 fragPositionWorld;
+layout(location = 4) out vec3 fragNormalWorld;
+layout(location = 5) out float fragViewDepth;
+#endif
+
+#ifdef BINDLESS
+layout(location = 1) out vec2 fragUv;
+layout(location = 2) flat out uint fragMaterialId;
+#endif
+
+//Matches B3DShadowMaps::CASCADE_COUNT
+const uint SHADOW_CASCADE_COUNT = 4;
 
+//Shared with simple_shader.frag, which does the lighting
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projectionViewMatrix;
+	mat4 viewMatrix;
 	vec3 directionToLight;
+	uvec4 clusterGridSize;
+	vec4 clusterTileSizeAndSlicing;
+	mat4 shadowLightViewProjections[SHADOW_CASCADE_COUNT];
+	vec4 shadowCascadeSplits;
+	vec4 shadowAtlasParams;
 } ubo;
 
-layout(push_constant) uniform Push {
+struct ObjectData {
 	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
+	mat3 normalMatrix;
+	vec3 color;
+	uint materialId;
+};
+
+//Written once per frame, draws select their object through firstInstance
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+} objectBuffer;
+
+#ifdef SHADOW
+//The cascade being drawn, its light matrix comes from the global UBO
+layout(push_constant) uniform ShadowPush {
+	uint cascade;
+} shadowPush;
+#endif
 
-const float AMBIENT = 0.02;
+//The main pass tests for equal depth against the pre-pass, so both variants must compute exactly the same position
+invariant gl_Position;
 
 void main() 
 {
-	gl_Position = ubo.projectionViewMatrix * push.modelMatrix * vec4(position, 1.0);
+	ObjectData object = objectBuffer.objects[gl_InstanceIndex];
 
-	vec3 normalWorldSpace = normalize(mat3(push.normalMatrix) * normal);
+	vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+#ifdef SHADOW
+	gl_Position = ubo.shadowLightViewProjections[shadowPush.cascade] * positionWorld;
+#else
+	gl_Position = ubo.projectionViewMatrix * positionWorld;
+#endif
 
-	float lightIntensity = AMBIENT + max(dot(normalWorldSpace, ubo.directionToLight), 0);
+#ifndef DEPTH_ONLY
+	fragColor = color * object.color;
+	fragPositionWorld = positionWorld.xyz;
+	fragNormalWorld = normalize(object.normalMatrix * normal);
+	fragViewDepth = (ubo.viewMatrix * positionWorld).z;
 
-	fragColor = lightIntensity * color;
+#ifdef BINDLESS
+	fragUv = uv;
+	fragMaterialId = object.materialId;
+#endif
+#endif
 }
\ No newline at end of file
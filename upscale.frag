@@ -0,0 +1,33 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform Push
+{
+	vec2 uvScale;
+	vec2 texelSize;
+	float sharpness;
+} push;
+
+//Only the top left corner of the scene target holds this frame, so every fetch is kept half a texel inside it
+vec3 fetch(vec2 uv)
+{
+	vec2 limit = push.uvScale - push.texelSize * 0.5;
+	return texture(sceneColor, clamp(uv, push.texelSize * 0.5, limit)).rgb;
+}
+
+void main()
+{
+	vec2 uv = fragUv * push.uvScale;
+	vec3 center = fetch(uv);
+
+	//Unsharp mask against the four neighbours, pulling back some of the detail the bilinear stretch blurs away
+	vec3 neighbours = fetch(uv + vec2(push.texelSize.x, 0.0)) + fetch(uv - vec2(push.texelSize.x, 0.0)) + fetch(uv + vec2(0.0, push.texelSize.y)) + fetch(uv - vec2(0.0, push.texelSize.y));
+	vec3 sharpened = center + (center - neighbours * 0.25) * push.sharpness;
+
+	outColor = vec4(max(sharpened, vec3(0.0)), 1.0);
+}